@@ -0,0 +1,145 @@
+#include <core/types.hpp>
+#include <graphics/frustum.hpp>
+#include <graphics/frustum_culler.hpp>
+#include <graphics/occlusion_buffer.hpp>
+#include <utils/cpu.hpp>
+#include <utils/threadpool.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace Stellar;
+
+static constexpr u32 BOX_COUNT = 100000;
+static constexpr u32 ITERATIONS = 100;
+
+static auto camera_view_projection() -> glm::mat4 {
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 500.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3{0.0f}, glm::vec3{0.0f, 0.0f, -1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});
+    return projection * view;
+}
+
+static auto unit_box() -> AABB {
+    return AABB { .min = glm::vec3{-0.5f}, .max = glm::vec3{0.5f} };
+}
+
+enum struct Classification : u32 {
+    Inside,
+    Outside,
+    // within rounding of a plane, the simd and scalar paths may disagree on these
+    Boundary,
+};
+
+static auto classify(const FrustumCuller& culler, const Frustum& frustum, u32 i) -> Classification {
+    bool boundary = false;
+    for(auto& plane : frustum.planes) {
+        f32 distance = plane.x * culler.center_x[i] + plane.y * culler.center_y[i] + plane.z * culler.center_z[i] + plane.w;
+        f32 radius = std::abs(plane.x) * culler.extent_x[i] + std::abs(plane.y) * culler.extent_y[i] + std::abs(plane.z) * culler.extent_z[i];
+        f32 signed_distance = distance + radius;
+        if(std::abs(signed_distance) < 1e-3f) { boundary = true; continue; }
+        if(signed_distance < 0.0f) { return Classification::Outside; }
+    }
+    return boundary ? Classification::Boundary : Classification::Inside;
+}
+
+// every id the culler reports has to be inside and every box clearly inside has to be reported, in the order they were added
+static auto check_frustum(FrustumCuller& culler, const Frustum& frustum, ThreadPool* thread_pool) -> bool {
+    const std::vector<u32>& visible = culler.cull(frustum, thread_pool);
+
+    usize next = 0;
+    for(u32 i = 0; i < culler.count; i++) {
+        Classification classification = classify(culler, frustum, i);
+        bool reported = next < visible.size() && visible[next] == culler.ids[i];
+        if(reported) { next++; }
+
+        if(classification == Classification::Inside && !reported) {
+            std::printf("box %u is inside the frustum but was culled\n", i);
+            return false;
+        }
+        if(classification == Classification::Outside && reported) {
+            std::printf("box %u is outside the frustum but was reported\n", i);
+            return false;
+        }
+    }
+
+    if(next != visible.size()) {
+        std::printf("the culler reported ids out of order\n");
+        return false;
+    }
+
+    return true;
+}
+
+// a wall in front of the camera hides a box straight behind it, but not one in front of it or one off to its side
+static auto check_occlusion(ThreadPool* thread_pool) -> bool {
+    glm::mat4 view_projection = camera_view_projection();
+
+    const std::array<glm::vec3, 4> wall_positions = {
+        glm::vec3{-2.0f, -2.0f, 0.0f},
+        glm::vec3{ 2.0f, -2.0f, 0.0f},
+        glm::vec3{ 2.0f,  2.0f, 0.0f},
+        glm::vec3{-2.0f,  2.0f, 0.0f},
+    };
+    const std::array<u32, 6> wall_indices = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionBuffer occlusion_buffer = {};
+    occlusion_buffer.begin(view_projection);
+    occlusion_buffer.add_occluder(wall_positions, wall_indices, glm::translate(glm::mat4{1.0f}, glm::vec3{0.0f, 0.0f, -10.0f}));
+    occlusion_buffer.rasterize(thread_pool);
+
+    enum : u32 { BEHIND = 0, IN_FRONT = 1, BESIDE = 2 };
+
+    FrustumCuller culler = {};
+    culler.add(unit_box(), glm::translate(glm::mat4{1.0f}, glm::vec3{0.0f, 0.0f, -20.0f}), BEHIND);
+    culler.add(unit_box(), glm::translate(glm::mat4{1.0f}, glm::vec3{0.0f, 0.0f, -5.0f}), IN_FRONT);
+    culler.add(unit_box(), glm::translate(glm::mat4{1.0f}, glm::vec3{8.0f, 0.0f, -20.0f}), BESIDE);
+
+    const std::vector<u32>& visible = culler.cull(Frustum::from_matrix(view_projection), thread_pool, &occlusion_buffer);
+    if(visible.size() != 2 || visible[0] != IN_FRONT || visible[1] != BESIDE) {
+        std::printf("occlusion culling kept %zu boxes, expected the ones in front of and beside the wall\n", visible.size());
+        return false;
+    }
+
+    return true;
+}
+
+template<typename F>
+static auto time_ms(F&& fn) -> f64 {
+    auto start = std::chrono::steady_clock::now();
+    for(u32 i = 0; i < ITERATIONS; i++) { fn(); }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<f64, std::milli>(end - start).count() / static_cast<f64>(ITERATIONS);
+}
+
+auto main() -> int {
+    ThreadPool thread_pool = {};
+
+    std::mt19937 random{1234};
+    std::uniform_real_distribution<f32> position{-200.0f, 200.0f};
+    std::uniform_real_distribution<f32> scale{0.1f, 4.0f};
+
+    FrustumCuller culler = {};
+    for(u32 i = 0; i < BOX_COUNT; i++) {
+        glm::mat4 transform = glm::translate(glm::mat4{1.0f}, glm::vec3{position(random), position(random), position(random)});
+        transform = glm::scale(transform, glm::vec3{scale(random), scale(random), scale(random)});
+        culler.add(unit_box(), transform, i);
+    }
+
+    Frustum frustum = Frustum::from_matrix(camera_view_projection());
+
+    bool passed = check_frustum(culler, frustum, nullptr);
+    passed = check_frustum(culler, frustum, &thread_pool) && passed;
+    passed = check_occlusion(nullptr) && passed;
+    passed = check_occlusion(&thread_pool) && passed;
+
+    f64 single_threaded = time_ms([&] { culler.cull(frustum); });
+    f64 multi_threaded = time_ms([&] { culler.cull(frustum, &thread_pool); });
+    std::printf("%u boxes, avx2 %s: %.3f ms single threaded, %.3f ms on the thread pool\n", BOX_COUNT, cpu_has_avx2() ? "on" : "off", single_threaded, multi_threaded);
+
+    std::puts(passed ? "passed" : "failed");
+    return passed ? 0 : 1;
+}
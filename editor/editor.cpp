@@ -8,6 +8,7 @@
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/trigonometric.hpp>
 #include <thread>
+#include <algorithm>
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -21,7 +22,7 @@
 namespace Stellar {
     static constexpr f32 sun_factor = 64.0f;
 
-    Editor::Editor(Context&& _context, std::shared_ptr<Stellar::Window>&& _window, daxa::Swapchain&& _swapchain, const std::string_view& project_path) : context{_context}, window{_window}, swapchain{_swapchain} {
+    Editor::Editor(Context&& _context, std::shared_ptr<Stellar::Window>&& _window, daxa::Swapchain&& _swapchain, const std::string_view& project_path) : context{std::move(_context)}, window{_window}, swapchain{_swapchain} {
         window->toggle_border(true);
         window->set_size(1200, 720);
         window->set_position(1920 + 1920 / 2 - window->width / 2, 1080 / 2 - window->height / 2);
@@ -34,7 +35,7 @@ namespace Stellar {
         swapchain.resize();
         swapchain.resize();
         
-        scene = std::make_shared<Scene>("Test", context.device, context.pipeline_manager);
+        scene = std::make_shared<Scene>("Test", context.device, *context.pipeline_cache, context.material_registry);
         scene->deserialize("test.scene");
 
         scene_hiearchy_panel = std::make_unique<SceneHiearchyPanel>(scene);
@@ -75,7 +76,7 @@ namespace Stellar {
         Logger::init();
         CORE_INFO("Test");
 
-        billboard_pipeline = context.pipeline_manager.add_raster_pipeline({
+        billboard_pipeline = context.pipeline_cache->add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"billboard.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"billboard.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .color_attachments = {{ .format = daxa::Format::R8G8B8A8_SRGB }},
@@ -89,9 +90,9 @@ namespace Stellar {
             },
             .push_constant_size = sizeof(BillboardPush),
             .debug_name = "billboard_pipeline",
-        }).value();
+        });
 
-        lines_pipeline = context.pipeline_manager.add_raster_pipeline({
+        lines_pipeline = context.pipeline_cache->add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"lines.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"lines.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .color_attachments = {{ .format = daxa::Format::R8G8B8A8_SRGB }},
@@ -107,26 +108,16 @@ namespace Stellar {
             },
             .push_constant_size = sizeof(LinesPush),
             .debug_name = "lines_pipeline",
-        }).value();
-
-        atmosphere_pipeline = context.pipeline_manager.add_raster_pipeline({
-            .vertex_shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
-            .fragment_shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
-            .color_attachments = {{ .format = daxa::Format::R8G8B8A8_SRGB }},
-            .depth_test = {
-                .depth_attachment_format = daxa::Format::D32_SFLOAT,
-                .enable_depth_test = true,
-                .enable_depth_write = true,
-            },
-            .raster = {
-                .face_culling = daxa::FaceCullFlagBits::NONE
-            },
-            .push_constant_size = sizeof(SkyPush),
-            .debug_name = "atmosphere_pipeline",
-        }).value();
+        });
 
-        deffered_rendering_system = std::make_unique<DefferedRenderingSystem>(context.device, context.pipeline_manager);
-        ssao_system = std::make_unique<SSAOSystem>(context.device, context.pipeline_manager);
+        deffered_rendering_system = std::make_unique<DefferedRenderingSystem>(context.device, *context.pipeline_cache);
+        ssao_system = std::make_unique<SSAOSystem>(context.device, *context.pipeline_cache);
+        culling_system = std::make_unique<CullingSystem>(context.device, *context.pipeline_cache);
+        light_cluster_system = std::make_unique<LightClusterSystem>(context.device, *context.pipeline_cache);
+        visibility_rendering_system = std::make_unique<VisibilityRenderingSystem>(context.device, *context.pipeline_cache);
+        dynamic_resolution_system = std::make_unique<DynamicResolutionSystem>(context.device);
+        temporal_upscaling_system = std::make_unique<TemporalUpscalingSystem>(context.device, *context.pipeline_cache);
+        atmosphere_system = std::make_unique<AtmosphereSystem>(context.device, *context.pipeline_cache);
 
         editor_camera.camera.resize(static_cast<i32>(size_x), static_cast<i32>(size_y));
 
@@ -144,7 +135,7 @@ namespace Stellar {
         point_light_texture = std::make_unique<Texture>(context.device, "point_light_icon.png", daxa::Format::R8G8B8A8_SRGB);
         spot_light_texture = std::make_unique<Texture>(context.device, "spot_light_icon.png", daxa::Format::R8G8B8A8_SRGB);
     
-        sampler = context.device.create_sampler({
+        sampler = context.material_registry->get_sampler({
             .magnification_filter = daxa::Filter::LINEAR,
             .minification_filter = daxa::Filter::LINEAR,
             .mipmap_filter = daxa::Filter::LINEAR,
@@ -161,7 +152,7 @@ namespace Stellar {
             .enable_unnormalized_coordinates = false,
         });
 
-        cube_model = std::make_unique<Model>(context.device, "models/cube.gltf");
+        build_task_list();
     }
 
     Editor::~Editor() {
@@ -169,7 +160,6 @@ namespace Stellar {
 
         context.device.wait_idle();
         context.device.collect_garbage();
-        context.device.destroy_sampler(sampler);
         context.device.destroy_buffer(editor_camera_buffer);
     }
 
@@ -191,6 +181,8 @@ namespace Stellar {
                 scene->physics_update(deltaTime);
             }
 
+            context.pipeline_cache->reload();
+
             render();
         }
     }
@@ -230,20 +222,59 @@ namespace Stellar {
         bool open = true;
         logger_panel->draw("Logger Panel", &open);
 
-        viewport_panel->draw(displayed_image.is_empty() ? deffered_rendering_system->render_image : displayed_image, window, scene_hiearchy_panel, editor_camera);
+        viewport_panel->draw(displayed_image.is_empty() ? dynamic_resolution_system->output_image : displayed_image, window, scene_hiearchy_panel, editor_camera);
         if(viewport_panel->should_resize) {
+            deffered_rendering_system->keep_gbuffer = false;
             deffered_rendering_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
             ssao_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);;
+            culling_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
+            visibility_rendering_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
+            dynamic_resolution_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
+            temporal_upscaling_system->resize(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
+            build_task_list();
 
             viewport_panel->should_resize = false;
-            displayed_image = deffered_rendering_system->render_image;
+            displayed_image = dynamic_resolution_system->output_image;
         }
 
+        // albedo and normal are transient unless one of them is shown, switching rebuilds the task list around that
+        auto keep_gbuffer = [&](bool keep) {
+            if(deffered_rendering_system->keep_gbuffer == keep) { return; }
+            deffered_rendering_system->keep_gbuffer = keep;
+            build_task_list();
+        };
+
         ImGui::Begin("G-Buffer Attachments");
-        if(ImGui::Checkbox("Render image", &show_render)) { displayed_image = deffered_rendering_system->render_image; }
-        if(ImGui::Checkbox("Albedo image", &show_albedo)) { displayed_image = deffered_rendering_system->albedo_image; }
-        if(ImGui::Checkbox("Normal image", &show_normal)) { displayed_image = deffered_rendering_system->normal_image; }
-        if(ImGui::Checkbox("SSAO image", &show_ssao)) { displayed_image = ssao_system->ssao_blur_image; }
+        if(ImGui::Checkbox("Render image", &show_render)) { keep_gbuffer(false); displayed_image = dynamic_resolution_system->output_image; }
+        if(ImGui::Checkbox("Albedo image", &show_albedo)) { keep_gbuffer(true); displayed_image = deffered_rendering_system->albedo_image; }
+        if(ImGui::Checkbox("Normal image", &show_normal)) { keep_gbuffer(true); displayed_image = deffered_rendering_system->normal_image; }
+        if(ImGui::Checkbox("SSAO image", &show_ssao)) { keep_gbuffer(false); displayed_image = ssao_system->ssao_blur_image; }
+
+        constexpr std::array<SSAOSystem::Quality, 4> ssao_qualities = { SSAOSystem::Quality::Low, SSAOSystem::Quality::Medium, SSAOSystem::Quality::High, SSAOSystem::Quality::Ultra };
+        i32 ssao_quality = static_cast<i32>(std::find(ssao_qualities.begin(), ssao_qualities.end(), ssao_system->quality) - ssao_qualities.begin());
+        if(ImGui::Combo("SSAO quality", &ssao_quality, "Low\0Medium\0High\0Ultra\0")) { ssao_system->quality = ssao_qualities[static_cast<usize>(ssao_quality)]; }
+        ImGui::Checkbox("SSAO temporal accumulation", &ssao_system->temporal_accumulation);
+
+        // the visibility buffer renderer leaves the albedo and normal attachments unwritten
+        i32 renderer_index = static_cast<i32>(renderer);
+        if(ImGui::Combo("Renderer", &renderer_index, "Deferred\0Visibility buffer\0")) {
+            renderer = static_cast<Renderer>(renderer_index);
+            displayed_image = dynamic_resolution_system->output_image;
+            deffered_rendering_system->keep_gbuffer = false;
+            build_task_list();
+        }
+
+        i32 upscaler = temporal_upscaling_system->enabled ? 1 : 0;
+        if(ImGui::Combo("Upscaler", &upscaler, "Bilinear\0Temporal\0")) {
+            temporal_upscaling_system->enabled = upscaler == 1;
+            build_task_list();
+        }
+
+        ImGui::Checkbox("Dynamic resolution", &dynamic_resolution_system->enabled);
+        ImGui::SliderFloat("Target GPU time (ms)", &dynamic_resolution_system->target_frame_time, 4.0f, 33.3f);
+        ImGui::SliderFloat("Min resolution scale", &dynamic_resolution_system->min_scale, 0.25f, dynamic_resolution_system->max_scale);
+        ImGui::SliderFloat("Max resolution scale", &dynamic_resolution_system->max_scale, dynamic_resolution_system->min_scale, 1.0f);
+        ImGui::Text("GPU time %.2f ms, rendering %ux%u", dynamic_resolution_system->gpu_frame_time, dynamic_resolution_system->render_size_x, dynamic_resolution_system->render_size_y);
         ImGui::End();
 
         ImGui::Begin("TEST");
@@ -258,20 +289,38 @@ namespace Stellar {
     }
 
     void Editor::render() {
-        scene->update();
-
         daxa::ImageId swapchain_image = swapchain.acquire_next_image();
         if(swapchain_image.is_empty()) { return; }
 
-        daxa::CommandList cmd_list = context.device.create_command_list({ .debug_name = "main loop cmd list" });
+        // the shadow passes it prepares are recorded by this frame's task list, so it only runs for frames that execute one
+        scene->update({
+            .camera_position = editor_camera.position,
+            .projection_scale = glm::abs(editor_camera.camera.get_projection()[1][1]),
+            .frame_index = frame_index,
+        });
 
         editor_camera.camera.set_pos(editor_camera.position);
         editor_camera.camera.set_rot(editor_camera.rotation.x, editor_camera.rotation.y);
         editor_camera.update(deltaTime);
 
-        glm::mat4 projection = editor_camera.camera.get_projection();
+        dynamic_resolution_system->update(viewport_panel->viewport_size_x, viewport_panel->viewport_size_y);
+        u32 render_size_x = dynamic_resolution_system->render_size_x;
+        u32 render_size_y = dynamic_resolution_system->render_size_y;
+        deffered_rendering_system->set_render_size(render_size_x, render_size_y);
+        visibility_rendering_system->set_render_size(render_size_x, render_size_y);
+        ssao_system->set_render_size(render_size_x, render_size_y);
+        culling_system->set_render_size(render_size_x, render_size_y);
+        culling_system->update(*task_list, scene->draw_commands.get());
+        temporal_upscaling_system->update(*task_list);
+
+        glm::mat4 unjittered_projection = editor_camera.camera.get_projection();
         glm::mat4 view = editor_camera.camera.get_view();
 
+        // everything rasterized this frame is shifted by the sub pixel jitter, motion vectors are measured without it
+        glm::vec2 jitter_offset = temporal_upscaling_system->get_jitter_offset(render_size_x, render_size_y);
+        glm::mat4 projection = glm::translate(glm::mat4(1.0f), glm::vec3(jitter_offset, 0.0f)) * unjittered_projection;
+        glm::mat4 unjittered_view_projection = unjittered_projection * view;
+
         glm::mat4 temp_inverse_projection_mat = glm::inverse(projection);
         glm::mat4 temp_inverse_view_mat = glm::inverse(view);
 
@@ -280,7 +329,9 @@ namespace Stellar {
             .inverse_projection_matrix = *reinterpret_cast<f32mat4x4*>(&temp_inverse_projection_mat),
             .view_matrix = *reinterpret_cast<f32mat4x4*>(&view),
             .inverse_view_matrix = *reinterpret_cast<f32mat4x4*>(&temp_inverse_view_mat),
-            .position = *reinterpret_cast<f32vec3*>(&editor_camera.position)
+            .position = *reinterpret_cast<f32vec3*>(&editor_camera.position),
+            .unjittered_view_projection = *reinterpret_cast<f32mat4x4*>(&unjittered_view_projection),
+            .previous_view_projection = *reinterpret_cast<f32mat4x4*>(&previous_unjittered_view_projection)
         };
 
         {
@@ -288,144 +339,578 @@ namespace Stellar {
             std::memcpy(buffer_ptr, &camera_info, sizeof(CameraInfo));
         }
 
-        deffered_rendering_system->render_gbuffer(cmd_list, DefferedRenderingSystem::DefferedRenderInfo {
-            .scene = scene,
-            .camera_buffer_address = context.device.get_device_address(editor_camera_buffer)
-        });
+        view_projection = projection * view;
+        previous_unjittered_view_projection = unjittered_view_projection;
+        light_direction = glm::rotateZ(glm::vec3{ 0.0f, -1.0f, 0.0f }, upTime / sun_factor);
+
+        task_list->clear_runtime_images(task_swapchain_image);
+        task_list->add_runtime_image(task_swapchain_image, swapchain_image);
+        task_list->execute();
+        frame_index++;
+    }
+
+    // the frame as a task graph: every task declares what it touches and the task list derives the barriers,
+    // layout transitions and transient memory from that. rebuilt whenever the viewport images are recreated
+    void Editor::build_task_list() {
+        if(task_list) { context.device.wait_idle(); }
 
-        ssao_system->render(cmd_list, SSAOSystem::RenderInfo {
-            .depth_image = deffered_rendering_system->depth_image,
-            .normal_image = deffered_rendering_system->normal_image,
-            .sampler =sampler,
-            .camera_buffer_address = context.device.get_device_address(editor_camera_buffer)
+        task_list = std::make_unique<daxa::TaskList>(daxa::TaskListInfo {
+            .device = context.device,
+            .swapchain = swapchain,
+            .alias_transients = true,
+            .debug_name = "editor task list",
         });
 
-        glm::vec3 dir = { 0.0f, -1.0f, 0.0f };
-        dir = glm::rotateZ(dir, upTime / sun_factor);
+        task_swapchain_image = task_list->create_task_image({ .swapchain_image = true, .debug_name = "task_swapchain_image" });
+
+        deffered_rendering_system->register_task_images(*task_list);
+        visibility_rendering_system->register_task_images(*task_list);
+        culling_system->register_task_images(*task_list);
+        culling_system->register_task_buffers(*task_list);
+        ssao_system->register_task_images(*task_list);
+        scene->register_task_images(*task_list);
+        light_cluster_system->register_task_buffers(*task_list);
+        atmosphere_system->register_task_images(*task_list);
+        dynamic_resolution_system->register_task_images(*task_list);
+        temporal_upscaling_system->register_task_images(*task_list);
+
+        auto& deffered = *deffered_rendering_system;
+        daxa::ImageMipArraySlice depth_slice = { .image_aspect = daxa::ImageAspectFlagBits::DEPTH };
+
+        auto gbuffer_info = [this]() {
+            return DefferedRenderingSystem::DefferedRenderInfo {
+                .scene = scene,
+                .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                .culling_system = culling_system.get()
+            };
+        };
+
+        auto& culling = *culling_system;
 
-        deffered_rendering_system->render_composition(cmd_list, DefferedRenderingSystem::CompositionRenderInfo{
-            .scene = scene,
-            .sampler = sampler,
-            .ssao_image = ssao_system->ssao_blur_image,
-            .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
-            .ambient = glm::dot(dir, {0.0f, -1.0f, 0.0f})
+        // first so the timed span holds everything the frame renders, shadows included. they don't get cheaper with
+        // the render size, but the main view's scale still has to leave room for them within the target
+        task_list->add_task({
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                dynamic_resolution_system->begin_frame(cmd_list);
+            },
+            .debug_name = "begin frame timing",
         });
 
-        cmd_list.begin_renderpass({
-            .color_attachments = {{
-                .image_view = deffered_rendering_system->render_image.default_view(),
-                .load_op = daxa::AttachmentLoadOp::LOAD,
-                .clear_value = std::array<daxa::f32, 4>{0.2f, 0.4f, 1.0f, 1.0f},
-            }},
-            .depth_attachment = {{
-                .image_view = deffered_rendering_system->depth_image.default_view(),
-                .load_op = daxa::AttachmentLoadOp::LOAD,
-                .clear_value = daxa::DepthValue{1.0f, 0},
-            }},
-            .render_area = {.x = 0, .y = 0, .width = viewport_panel->viewport_size_x, .height = viewport_panel->viewport_size_y},
+        task_list->add_task({
+            .used_buffers = {
+                { culling.task_culled_command_buffer, daxa::TaskBufferAccess::TRANSFER_WRITE },
+                { culling.task_late_culled_command_buffer, daxa::TaskBufferAccess::TRANSFER_WRITE },
+                { culling.task_visibility_buffer, daxa::TaskBufferAccess::TRANSFER_WRITE },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                culling_system->reset(cmd_list);
+            },
+            .debug_name = "reset culled commands",
         });
 
-        cmd_list.set_pipeline(*billboard_pipeline); 
-        
-        scene->iterate([&](Entity entity){
-            daxa::ImageId image_id;
-            daxa::SamplerId sampler_id;
-            bool is_light = false;
-            
-            if(entity.has_component<DirectionalLightComponent>()) {
-                image_id = directional_light_texture->image_id;
-                sampler_id = directional_light_texture->sampler_id;
-                is_light = true;
-            }
+        task_list->add_task({
+            .used_images = {
+                { scene->task_static_directional_shadow_atlas, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                { scene->task_static_spot_depth_atlas, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                { scene->task_static_spot_shadow_atlas, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                scene->render_shadow_caches(cmd_list);
+            },
+            .debug_name = "shadow caches",
+        });
 
-            if(entity.has_component<PointLightComponent>()) {
-                image_id = point_light_texture->image_id;
-                sampler_id = point_light_texture->sampler_id;
-                is_light = true;
-            }
+        task_list->add_task({
+            .used_images = {
+                { scene->task_static_directional_shadow_atlas, daxa::TaskImageAccess::TRANSFER_READ, depth_slice },
+                { scene->task_static_spot_depth_atlas, daxa::TaskImageAccess::TRANSFER_READ, depth_slice },
+                { scene->task_static_spot_shadow_atlas, daxa::TaskImageAccess::TRANSFER_READ, daxa::ImageMipArraySlice{} },
+                { scene->task_directional_shadow_atlas, daxa::TaskImageAccess::TRANSFER_WRITE, depth_slice },
+                { scene->task_spot_depth_atlas, daxa::TaskImageAccess::TRANSFER_WRITE, depth_slice },
+                { scene->task_spot_moment_atlas, daxa::TaskImageAccess::TRANSFER_WRITE, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                scene->copy_shadow_caches(cmd_list);
+            },
+            .debug_name = "shadow cache copy",
+        });
 
-            if(entity.has_component<SpotLightComponent>()) {
-                image_id = spot_light_texture->image_id;
-                sampler_id = spot_light_texture->sampler_id;
-                is_light = true;
-            }
+        task_list->add_task({
+            .used_images = {
+                { scene->task_directional_shadow_atlas, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                { scene->task_spot_depth_atlas, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                { scene->task_spot_moment_atlas, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                scene->render_dynamic_shadows(cmd_list);
+            },
+            .debug_name = "dynamic shadows",
+        });
 
-            if(!is_light) { return; }
+        task_list->add_task({
+            .used_images = {
+                { scene->task_spot_moment_atlas, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { scene->task_spot_shadow_atlas, daxa::TaskImageAccess::COMPUTE_SHADER_WRITE_ONLY, daxa::ImageMipArraySlice{ .level_count = 1 } },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                scene->blur_spot_shadows(cmd_list);
+            },
+            .debug_name = "vsm blur",
+        });
 
-            auto& tc = entity.get_component<TransformComponent>();
-            cmd_list.push_constant(BillboardPush {
-                .position = *reinterpret_cast<f32vec3*>(&tc.position),
-                .camera_info = context.device.get_device_address(editor_camera_buffer),
-                .texture = {
-                    .texture_id = image_id.default_view(),
-                    .sampler_id = sampler_id
-                }
+        // a task per mip, each reads the one the task before wrote
+        for(u32 mip = 1; mip < Scene::VSM_MIP_COUNT; mip++) {
+            task_list->add_task({
+                .used_images = {
+                    { scene->task_spot_shadow_atlas, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{ .base_mip_level = mip - 1, .level_count = 1 } },
+                    { scene->task_spot_shadow_atlas, daxa::TaskImageAccess::COMPUTE_SHADER_WRITE_ONLY, daxa::ImageMipArraySlice{ .base_mip_level = mip, .level_count = 1 } },
+                },
+                .task = [this, mip](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    scene->downsample_spot_shadows(cmd_list, mip);
+                },
+                .debug_name = "vsm downsample",
             });
+        }
 
-            cmd_list.draw({ .vertex_count = 6 });
+        task_list->add_task({
+            .used_buffers = {
+                { culling.task_culled_command_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE },
+                { culling.task_culled_instance_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_WRITE_ONLY },
+                { culling.task_visibility_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                culling_system->cull(cmd_list, CullingSystem::CullInfo {
+                    .view_projection = view_projection
+                });
+            },
+            .debug_name = "cull",
         });
 
-        cmd_list.set_pipeline(*lines_pipeline);
-        cmd_list.push_constant(LinesPush {
-            .vertex_buffer = context.device.get_device_address(scene->lines_buffer),
-            .camera_info = context.device.get_device_address(editor_camera_buffer),
+        task_list->add_task({
+            .used_buffers = {
+                { culling.task_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                { culling.task_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+            },
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+            },
+            .task = [this, gbuffer_info](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                deffered_rendering_system->render_depth_prepass(cmd_list, gbuffer_info(), false);
+            },
+            .debug_name = "depth prepass",
         });
-        cmd_list.draw({ .vertex_count = scene->lines_vertices });
-
-        glm::mat4 model_matrix = glm::translate(glm::mat4{1.0f}, glm::vec3{ 0.0f, 0.0f, 0.0f }) * glm::scale(glm::mat4{1.0f}, glm::vec3{ 1000.0f, 1000.0f, 1000.0f });
-
-        glm::vec3 sun_position = glm::vec3{ 0.0f, 6372e3f, 0.0f };
-        sun_position = glm::rotateZ(sun_position, upTime / sun_factor);
-        cmd_list.set_pipeline(*atmosphere_pipeline);
-        SkyPush sky_push;
-        sky_push.model_matrix = *reinterpret_cast<f32mat4x4*>(&model_matrix);
-        sky_push.sun_position = *reinterpret_cast<f32vec3*>(&sun_position);
-        sky_push.camera_info = context.device.get_device_address(editor_camera_buffer);
-        cube_model->draw(cmd_list, sky_push);
-        cmd_list.end_renderpass();
-
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .after_layout = daxa::ImageLayout::READ_ONLY_OPTIMAL,
-            .image_id = deffered_rendering_system->render_image
+
+        task_list->add_task({
+            .used_buffers = {
+                { culling.task_late_culled_command_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE },
+                { culling.task_late_culled_instance_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_WRITE_ONLY },
+                { culling.task_visibility_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_READ_WRITE },
+            },
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, depth_slice },
+                { culling_system->task_hiz_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_WRITE, daxa::ImageMipArraySlice{ .level_count = culling_system->hiz_mip_count } },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                if(!culling_system->occlusion_culling) { return; }
+                auto cmd_list = runtime.get_command_list();
+                culling_system->build_hiz(cmd_list, deffered_rendering_system->depth_image);
+                culling_system->cull_late(cmd_list);
+            },
+            .debug_name = "hiz and late cull",
         });
 
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
-            .image_id = swapchain_image
+        task_list->add_task({
+            .used_buffers = {
+                { culling.task_late_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                { culling.task_late_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+            },
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+            },
+            .task = [this, gbuffer_info](daxa::TaskRuntimeInterface const& runtime) {
+                if(!culling_system->occlusion_culling) { return; }
+                auto cmd_list = runtime.get_command_list();
+                deffered_rendering_system->render_depth_prepass(cmd_list, gbuffer_info(), true);
+            },
+            .debug_name = "late depth prepass",
         });
 
-        cmd_list.clear_image({
-            .dst_image_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
-            .clear_value = std::array<daxa::f32, 4>{0.00368f, 0.00368f, 0.00368f, 1.0},
-            .dst_image = swapchain_image
+        bool visibility_buffer = renderer == Renderer::VisibilityBuffer;
+        if(visibility_buffer) {
+            task_list->add_task({
+                .used_buffers = {
+                    { culling.task_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                    { culling.task_late_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                    { culling.task_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+                    { culling.task_late_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+                },
+                .used_images = {
+                    { visibility_rendering_system->task_visibility_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { deffered.task_velocity_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { deffered.task_depth_image, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                },
+                .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    visibility_rendering_system->render_visibility(cmd_list, VisibilityRenderingSystem::VisibilityRenderInfo {
+                        .scene = scene,
+                        .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                        .culling_system = culling_system.get(),
+                        .depth_image = deffered_rendering_system->depth_image,
+                        .velocity_image = deffered_rendering_system->velocity_image
+                    });
+                },
+                .debug_name = "visibility",
+            });
+        } else {
+            task_list->add_task({
+                .used_buffers = {
+                    { culling.task_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                    { culling.task_late_culled_command_buffer, daxa::TaskBufferAccess::INDIRECT_COMMAND_READ },
+                    { culling.task_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+                    { culling.task_late_culled_instance_buffer, daxa::TaskBufferAccess::VERTEX_SHADER_READ_ONLY },
+                },
+                .used_images = {
+                    { deffered.task_albedo_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { deffered.task_normal_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { deffered.task_velocity_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { deffered.task_depth_image, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+                },
+                .task = [this, gbuffer_info](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    auto info = gbuffer_info();
+                    info.albedo_image = runtime.get_images(deffered_rendering_system->task_albedo_image)[0];
+                    info.normal_image = runtime.get_images(deffered_rendering_system->task_normal_image)[0];
+                    deffered_rendering_system->render_gbuffer(cmd_list, info);
+                },
+                .debug_name = "gbuffer",
+            });
+        }
+
+        // the visibility buffer renderer never writes the g-buffer normals, ssao resolves them from the triangle ids instead
+        daxa::TaskImageId ssao_normal_source = visibility_buffer ? visibility_rendering_system->task_visibility_image : deffered.task_normal_image;
+
+        auto ssao_info = [this, visibility_buffer]() {
+            daxa::BufferId draw_data_buffer = scene->draw_commands->draw_data_buffer;
+            return SSAOSystem::RenderInfo {
+                .depth_image = deffered_rendering_system->depth_image,
+                .sampler = sampler,
+                .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                .view_projection = view_projection,
+                .visibility_image = visibility_buffer ? visibility_rendering_system->visibility_image : daxa::ImageId{},
+                .draw_data_buffer = (visibility_buffer && !draw_data_buffer.is_empty()) ? context.device.get_device_address(draw_data_buffer) : daxa::BufferDeviceAddress{},
+                .material_buffer = scene->material_registry->get_material_buffer_address()
+            };
+        };
+
+        // three tasks so the raw half resolution image is only alive, and only holds memory, between the first two
+        task_list->add_task({
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, depth_slice },
+                { ssao_normal_source, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_image, daxa::TaskImageAccess::COMPUTE_SHADER_WRITE_ONLY, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this, ssao_info, ssao_normal_source](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                auto info = ssao_info();
+                info.normal_image = runtime.get_images(ssao_normal_source)[0];
+                info.ssao_image = runtime.get_images(ssao_system->task_ssao_image)[0];
+                ssao_system->render_raw(cmd_list, info);
+            },
+            .debug_name = "ssao",
         });
 
-        imgui_renderer.record_commands(ImGui::GetDrawData(), cmd_list, swapchain_image, size_x, size_y);
+        task_list->add_task({
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, depth_slice },
+                { ssao_system->task_ssao_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_history_images[0], daxa::TaskImageAccess::COMPUTE_SHADER_READ_WRITE, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_history_images[1], daxa::TaskImageAccess::COMPUTE_SHADER_READ_WRITE, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this, ssao_info](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                auto info = ssao_info();
+                info.ssao_image = runtime.get_images(ssao_system->task_ssao_image)[0];
+                ssao_system->render_temporal(cmd_list, info);
+            },
+            .debug_name = "ssao temporal",
+        });
 
-        cmd_list.pipeline_barrier_image_transition({
-            .awaited_pipeline_access = daxa::AccessConsts::ALL_GRAPHICS_READ_WRITE,
-            .before_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
-            .after_layout = daxa::ImageLayout::PRESENT_SRC,
-            .image_id = swapchain_image
+        task_list->add_task({
+            .used_images = {
+                { deffered.task_depth_image, daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, depth_slice },
+                { ssao_system->task_ssao_history_images[0], daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_history_images[1], daxa::TaskImageAccess::COMPUTE_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_blur_image, daxa::TaskImageAccess::COMPUTE_SHADER_WRITE_ONLY, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this, ssao_info](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                ssao_system->render_upsample(cmd_list, ssao_info());
+            },
+            .debug_name = "ssao upsample",
         });
+        };
 
-        cmd_list.complete();
+        task_list->add_task({
+            .used_buffers = {
+                { light_cluster_system->task_cluster_buffer, daxa::TaskBufferAccess::COMPUTE_SHADER_WRITE_ONLY },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                light_cluster_system->build(cmd_list, LightClusterSystem::BuildInfo {
+                    .scene = scene,
+                    .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                    .z_near = editor_camera.camera.near_clip,
+                    .z_far = editor_camera.camera.far_clip
+                });
+            },
+            .debug_name = "light clusters",
+        });
 
-        context.device.submit_commands({
-            .command_lists = {std::move(cmd_list)},
-            .wait_binary_semaphores = {swapchain.get_acquire_semaphore()},
-            .signal_binary_semaphores = {swapchain.get_present_semaphore()},
-            .signal_timeline_semaphores = {{swapchain.get_gpu_timeline_semaphore(), swapchain.get_cpu_timeline_value()}},
+        if(visibility_buffer) {
+            task_list->add_task({
+                .used_buffers = {
+                    { light_cluster_system->task_cluster_buffer, daxa::TaskBufferAccess::FRAGMENT_SHADER_READ_ONLY },
+                },
+                .used_images = {
+                    { visibility_rendering_system->task_visibility_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { deffered.task_depth_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, depth_slice },
+                    { ssao_system->task_ssao_blur_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { scene->task_directional_shadow_atlas, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, depth_slice },
+                    { scene->task_spot_shadow_atlas, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{ .level_count = Scene::VSM_MIP_COUNT } },
+                    { deffered.task_render_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                },
+                .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    visibility_rendering_system->render_composition(cmd_list, VisibilityRenderingSystem::CompositionRenderInfo {
+                        .scene = scene,
+                        .sampler = sampler,
+                        .depth_image = deffered_rendering_system->depth_image,
+                        .ssao_image = ssao_system->ssao_blur_image,
+                        .render_image = deffered_rendering_system->render_image,
+                        .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                        .light_clusters = light_cluster_system->cluster_buffer,
+                        .z_near = editor_camera.camera.near_clip,
+                        .z_far = editor_camera.camera.far_clip,
+                        .ambient = glm::dot(light_direction, {0.0f, -1.0f, 0.0f})
+                    });
+                },
+                .debug_name = "visibility composition",
+            });
+        } else {
+            task_list->add_task({
+                .used_buffers = {
+                    { light_cluster_system->task_cluster_buffer, daxa::TaskBufferAccess::FRAGMENT_SHADER_READ_ONLY },
+                },
+                .used_images = {
+                    { deffered.task_albedo_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { deffered.task_normal_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { deffered.task_depth_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, depth_slice },
+                    { ssao_system->task_ssao_blur_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { scene->task_directional_shadow_atlas, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, depth_slice },
+                    { scene->task_spot_shadow_atlas, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{ .level_count = Scene::VSM_MIP_COUNT } },
+                    { deffered.task_render_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                },
+                .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    deffered_rendering_system->render_composition(cmd_list, DefferedRenderingSystem::CompositionRenderInfo{
+                        .scene = scene,
+                        .sampler = sampler,
+                        .ssao_image = ssao_system->ssao_blur_image,
+                        .albedo_image = runtime.get_images(deffered_rendering_system->task_albedo_image)[0],
+                        .normal_image = runtime.get_images(deffered_rendering_system->task_normal_image)[0],
+                        .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                        .light_clusters = light_cluster_system->cluster_buffer,
+                        .z_near = editor_camera.camera.near_clip,
+                        .z_far = editor_camera.camera.far_clip,
+                        .ambient = glm::dot(light_direction, {0.0f, -1.0f, 0.0f})
+                    });
+                },
+                .debug_name = "composition",
+            });
+        }
+
+        auto atmosphere_info = [this]() {
+            return AtmosphereSystem::RenderInfo {
+                .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                .sun_direction = -light_direction,
+                .camera_position = editor_camera.position
+            };
+        };
+
+        task_list->add_task({
+            .used_images = {
+                { atmosphere_system->task_sky_view_lut, daxa::TaskImageAccess::COMPUTE_SHADER_READ_WRITE, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this, atmosphere_info](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                atmosphere_system->update(cmd_list, atmosphere_info());
+            },
+            .debug_name = "atmosphere luts",
         });
 
-        context.device.present_frame({
-            .wait_binary_semaphores = {swapchain.get_present_semaphore()},
-            .swapchain = swapchain,
+        task_list->add_task({
+            .used_images = {
+                { atmosphere_system->task_sky_view_lut, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { deffered.task_render_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                { deffered.task_depth_image, daxa::TaskImageAccess::DEPTH_ATTACHMENT, depth_slice },
+            },
+            .task = [this, atmosphere_info](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+
+                cmd_list.begin_renderpass({
+                    .color_attachments = {{
+                        .image_view = deffered_rendering_system->render_image.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::LOAD,
+                        .clear_value = std::array<daxa::f32, 4>{0.2f, 0.4f, 1.0f, 1.0f},
+                    }},
+                    .depth_attachment = {{
+                        .image_view = deffered_rendering_system->depth_image.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::LOAD,
+                        .clear_value = daxa::DepthValue{1.0f, 0},
+                    }},
+                    .render_area = {.x = 0, .y = 0, .width = deffered_rendering_system->render_size_x, .height = deffered_rendering_system->render_size_y},
+                });
+
+                atmosphere_system->render(cmd_list, atmosphere_info());
+
+                cmd_list.set_pipeline(*billboard_pipeline);
+
+                daxa::SamplerId icon_sampler = context.material_registry->get_texture_sampler();
+                scene->iterate([&](Entity entity){
+                    daxa::ImageId image_id;
+                    bool is_light = false;
+
+                    if(entity.has_component<DirectionalLightComponent>()) {
+                        image_id = directional_light_texture->image_id;
+                        is_light = true;
+                    }
+
+                    if(entity.has_component<PointLightComponent>()) {
+                        image_id = point_light_texture->image_id;
+                        is_light = true;
+                    }
+
+                    if(entity.has_component<SpotLightComponent>()) {
+                        image_id = spot_light_texture->image_id;
+                        is_light = true;
+                    }
+
+                    if(!is_light) { return; }
+
+                    auto& tc = entity.get_component<TransformComponent>();
+                    cmd_list.push_constant(BillboardPush {
+                        .position = *reinterpret_cast<f32vec3*>(&tc.position),
+                        .camera_info = context.device.get_device_address(editor_camera_buffer),
+                        .texture = {
+                            .texture_id = image_id.default_view(),
+                            .sampler_id = icon_sampler
+                        }
+                    });
+
+                    cmd_list.draw({ .vertex_count = 6 });
+                });
+
+                cmd_list.set_pipeline(*lines_pipeline);
+                cmd_list.push_constant(LinesPush {
+                    .vertex_buffer = context.device.get_device_address(scene->lines_buffer),
+                    .camera_info = context.device.get_device_address(editor_camera_buffer),
+                });
+                cmd_list.draw({ .vertex_count = scene->lines_vertices });
+
+                cmd_list.end_renderpass();
+            },
+            .debug_name = "sky and overlays",
+        });
+
+        if(temporal_upscaling_system->enabled) {
+            task_list->add_task({
+                .used_images = {
+                    { deffered.task_render_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { deffered.task_depth_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, depth_slice },
+                    { deffered.task_velocity_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { temporal_upscaling_system->task_history_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                    { temporal_upscaling_system->task_accumulation_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                    { dynamic_resolution_system->task_output_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                },
+                .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    temporal_upscaling_system->render(cmd_list, TemporalUpscalingSystem::RenderInfo {
+                        .color_image = deffered_rendering_system->render_image,
+                        .depth_image = deffered_rendering_system->depth_image,
+                        .velocity_image = deffered_rendering_system->velocity_image,
+                        .output_image = dynamic_resolution_system->output_image,
+                        .sampler = sampler,
+                        .camera_buffer_address = context.device.get_device_address(editor_camera_buffer),
+                        .render_size_x = deffered_rendering_system->render_size_x,
+                        .render_size_y = deffered_rendering_system->render_size_y
+                    });
+                    dynamic_resolution_system->end_frame(cmd_list);
+                },
+                .debug_name = "temporal upscale",
+            });
+        } else {
+            task_list->add_task({
+                .used_images = {
+                    { deffered.task_render_image, daxa::TaskImageAccess::TRANSFER_READ, daxa::ImageMipArraySlice{} },
+                    { dynamic_resolution_system->task_output_image, daxa::TaskImageAccess::TRANSFER_WRITE, daxa::ImageMipArraySlice{} },
+                },
+                .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                    auto cmd_list = runtime.get_command_list();
+                    dynamic_resolution_system->upscale(cmd_list, deffered_rendering_system->render_image);
+                    dynamic_resolution_system->end_frame(cmd_list);
+                },
+                .debug_name = "upscale",
+            });
+        }
+
+        task_list->add_task({
+            .used_images = {
+                { task_swapchain_image, daxa::TaskImageAccess::TRANSFER_WRITE, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                cmd_list.clear_image({
+                    .dst_image_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+                    .clear_value = std::array<daxa::f32, 4>{0.00368f, 0.00368f, 0.00368f, 1.0},
+                    .dst_image = runtime.get_images(task_swapchain_image)[0]
+                });
+            },
+            .debug_name = "clear swapchain",
         });
+
+        // any of the attachments the task list keeps past the frame can be shown in the viewport, albedo and normal
+        // only while keep_gbuffer makes them persistent, as transients their memory is reused by then
+        daxa::TaskInfo imgui_task = {
+            .used_images = {
+                { task_swapchain_image, daxa::TaskImageAccess::COLOR_ATTACHMENT, daxa::ImageMipArraySlice{} },
+                { dynamic_resolution_system->task_output_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { deffered.task_render_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+                { ssao_system->task_ssao_blur_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} },
+            },
+            .task = [this](daxa::TaskRuntimeInterface const& runtime) {
+                auto cmd_list = runtime.get_command_list();
+                imgui_renderer.record_commands(ImGui::GetDrawData(), cmd_list, runtime.get_images(task_swapchain_image)[0], size_x, size_y);
+            },
+            .debug_name = "imgui",
+        };
+        if(deffered.keep_gbuffer) {
+            imgui_task.used_images.push_back({ deffered.task_albedo_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} });
+            imgui_task.used_images.push_back({ deffered.task_normal_image, daxa::TaskImageAccess::FRAGMENT_SHADER_READ_ONLY, daxa::ImageMipArraySlice{} });
+        }
+        task_list->add_task(imgui_task);
+
+        task_list->submit({});
+        task_list->present({});
+        task_list->complete();
     }
 
     void Editor::on_resize(u32, u32) {
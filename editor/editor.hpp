@@ -10,24 +10,38 @@
 
 #include <daxa/daxa.hpp>
 #include <daxa/pipeline.hpp>
-#include <daxa/utils/pipeline_manager.hpp>
 #include <daxa/utils/imgui.hpp>
+#include <daxa/utils/task_list.hpp>
 
 #include <core/window.hpp>
 #include <graphics/model.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <graphics/material_registry.hpp>
 
 #include <systems/ssao_system.hpp>
 #include <systems/deffered_rendering_system.hpp>
+#include <systems/culling_system.hpp>
+#include <systems/light_cluster_system.hpp>
+#include <systems/atmosphere_system.hpp>
+#include <systems/visibility_rendering_system.hpp>
+#include <systems/dynamic_resolution_system.hpp>
+#include <systems/temporal_upscaling_system.hpp>
 
 namespace Stellar {
     struct Context {
         daxa::Context context;
         daxa::Device device;
-        daxa::PipelineManager pipeline_manager;
+        std::unique_ptr<PipelineCache> pipeline_cache;
+        std::shared_ptr<MaterialRegistry> material_registry;
     };
 
 
     struct Editor {
+        enum struct Renderer : i32 {
+            Deferred = 0,
+            VisibilityBuffer = 1,
+        };
+
         Editor(Context&& _context, std::shared_ptr<Stellar::Window>&& _window, daxa::Swapchain&& _swapchain, const std::string_view& project_path);
         ~Editor();
 
@@ -35,6 +49,7 @@ namespace Stellar {
         void ui_update();
         void on_update();
         void render();
+        void build_task_list();
 
         void on_resize(u32 sx, u32 sy);
         void on_key(i32 key, i32 action);
@@ -58,9 +73,8 @@ namespace Stellar {
 
         daxa::SamplerId sampler;
 
-        std::shared_ptr<daxa::RasterPipeline> billboard_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> lines_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> atmosphere_pipeline;
+        RasterPipelineHandle billboard_pipeline;
+        RasterPipelineHandle lines_pipeline;
 
         std::unique_ptr<SceneHiearchyPanel> scene_hiearchy_panel;
         std::unique_ptr<AssetBrowserPanel> asset_browser_panel;
@@ -71,6 +85,12 @@ namespace Stellar {
 
         std::unique_ptr<SSAOSystem> ssao_system;
         std::unique_ptr<DefferedRenderingSystem> deffered_rendering_system;
+        std::unique_ptr<CullingSystem> culling_system;
+        std::unique_ptr<LightClusterSystem> light_cluster_system;
+        std::unique_ptr<AtmosphereSystem> atmosphere_system;
+        std::unique_ptr<VisibilityRenderingSystem> visibility_rendering_system;
+        std::unique_ptr<DynamicResolutionSystem> dynamic_resolution_system;
+        std::unique_ptr<TemporalUpscalingSystem> temporal_upscaling_system;
 
         std::unique_ptr<Texture> directional_light_texture;
         std::unique_ptr<Texture> point_light_texture;
@@ -85,6 +105,14 @@ namespace Stellar {
         daxa::BufferId editor_camera_buffer;
         std::shared_ptr<Scene> scene;
 
-        std::unique_ptr<Model> cube_model;
+        Renderer renderer = Renderer::Deferred;
+        std::unique_ptr<daxa::TaskList> task_list;
+        daxa::TaskImageId task_swapchain_image;
+        // per frame state the recorded tasks read when the list executes
+        glm::mat4 view_projection{1.0f};
+        glm::mat4 previous_unjittered_view_projection{1.0f};
+        glm::vec3 light_direction = { 0.0f, -1.0f, 0.0f };
+        // frames whose task list was executed
+        u64 frame_index = 0;
     };
 }
\ No newline at end of file
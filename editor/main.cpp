@@ -2,7 +2,6 @@
 #include <iostream>
 
 #include <daxa/daxa.hpp>
-#include <daxa/utils/pipeline_manager.hpp>
 #include <daxa/utils/imgui.hpp>
 
 #include <imgui.h>
@@ -14,6 +13,8 @@
 #include <GLFW/glfw3.h>
 
 #include <graphics/texture.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <graphics/material_registry.hpp>
 #include <core/window.hpp>
 
 
@@ -27,7 +28,7 @@ using namespace std::literals;
 auto loading_screen(Stellar::Context& context, daxa::Swapchain swapchain) -> bool {
     Stellar::Texture texture = Stellar::Texture(context.device, "pic.png", daxa::Format::R8G8B8A8_SRGB);
 
-    auto pipeline = context.pipeline_manager.add_raster_pipeline({
+    auto pipeline = context.pipeline_cache->add_raster_pipeline({
         .vertex_shader_info = {.source = daxa::ShaderFile{"loading_screen.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
         .fragment_shader_info = {.source = daxa::ShaderFile{"loading_screen.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
         .color_attachments = {{ .format = swapchain.get_format() }},
@@ -41,7 +42,7 @@ auto loading_screen(Stellar::Context& context, daxa::Swapchain swapchain) -> boo
         },
         .push_constant_size = sizeof(TexturePush),
         .debug_name = "raster_pipeline",
-    }).value();
+    });
 
     auto timer = std::chrono::system_clock::now();
 
@@ -74,7 +75,7 @@ auto loading_screen(Stellar::Context& context, daxa::Swapchain swapchain) -> boo
 
         cmd_list.push_constant(TexturePush {
             .texture = texture.image_id.default_view(),
-            .texture_sampler = texture.sampler_id
+            .texture_sampler = context.material_registry->get_texture_sampler()
         });
         cmd_list.draw({ .vertex_count = 3 });
         cmd_list.end_renderpass();
@@ -219,23 +220,22 @@ auto main() -> i32 {
         .debug_name = "my device",
     });
 
-    context.pipeline_manager = daxa::PipelineManager({
+    context.pipeline_cache = std::make_unique<Stellar::PipelineCache>(Stellar::PipelineCache::Info{
         .device = context.device,
-        .shader_compile_options = {
-            .root_paths = {
-                "/shaders",
-                "../shaders",
-                "../../shaders",
-                "../../../shaders",
-                "shaders",
-                DAXA_SHADER_INCLUDE_DIR,
-            },
-            .language = daxa::ShaderLanguage::GLSL,
-            .enable_debug_info = true,
+        .root_paths = {
+            "/shaders",
+            "../shaders",
+            "../../shaders",
+            "../../../shaders",
+            "shaders",
+            DAXA_SHADER_INCLUDE_DIR,
         },
-        .debug_name = "pipeline_manager",
+        .cache_path = "shader_cache",
+        .enable_debug_info = true,
     });
 
+    context.material_registry = std::make_shared<Stellar::MaterialRegistry>(context.device);
+
     std::shared_ptr<Stellar::Window> window = std::make_shared<Stellar::Window>(520, 220, "Projection selection");
 
     daxa::Swapchain swapchain = context.device.create_swapchain({
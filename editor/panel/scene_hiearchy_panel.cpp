@@ -41,7 +41,7 @@ namespace Stellar {
 
             if (open) {
                 if constexpr(std::is_same_v<T, ModelComponent>) {
-                    component.draw(scene->device);
+                    component.draw(scene->device, *scene->material_registry);
                 } else {
                     component.draw();
                 }
@@ -13,6 +13,7 @@
 #include <yaml-cpp/yaml.h>
 
 #include <graphics/model.hpp>
+#include <graphics/material_registry.hpp>
 
 namespace YAML {
     template<>
@@ -215,14 +216,14 @@ namespace Stellar {
         cc.is_dirty = true;
     }
 
-    void ModelComponent::draw(daxa::Device device) {
+    void ModelComponent::draw(daxa::Device device, MaterialRegistry& material_registry) {
         GUI::begin_properties();
 
         GUI::string_property("File Path:", file_path, nullptr, ImGuiInputTextFlags_ReadOnly);
 
         if(ImGui::Button("Load")) {
             if(std::filesystem::exists(file_path)) {
-                model = std::make_shared<Model>(device, file_path);
+                model = std::make_shared<Model>(device, file_path, material_registry);
             }
         }
 
@@ -239,10 +240,10 @@ namespace Stellar {
         out << YAML::EndMap;
     }
 
-    void ModelComponent::deserialize(YAML::Node &node, Entity &entity, daxa::Device& device) {
+    void ModelComponent::deserialize(YAML::Node &node, Entity &entity, daxa::Device& device, MaterialRegistry& material_registry) {
         auto& mc = entity.add_component<ModelComponent>();
         mc.file_path = node["Filepath"].as<std::string>();
-        mc.model = std::make_shared<Model>(device, mc.file_path);
+        mc.model = std::make_shared<Model>(device, mc.file_path, material_registry);
     }
 
     void DirectionalLightComponent::draw() {
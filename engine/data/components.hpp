@@ -7,6 +7,7 @@
 //#include <graphics/model.hpp>
 #include <daxa/daxa.hpp>
 #include <physics/types.hpp>
+#include <graphics/shadow_atlas.hpp>
 
 namespace YAML {
     struct Emitter;
@@ -24,6 +25,7 @@ namespace physx {
 namespace Stellar {
     struct Entity;
     struct Model;
+    struct MaterialRegistry;
 
     struct UUIDComponent {
         UUID uuid = UUID();
@@ -60,6 +62,8 @@ namespace Stellar {
         glm::mat4 model_matrix{1.0f};
         glm::mat4 normal_matrix{1.0f};
         bool is_dirty = true;
+        // set for the frame after a move so the uploaded previous matrix catches up and motion drops back to zero
+        bool moved = false;
 
         daxa::BufferId transform_buffer;
 
@@ -83,20 +87,24 @@ namespace Stellar {
         std::string file_path = "";
         std::shared_ptr<Model> model;
 
-        void draw(daxa::Device device);
+        void draw(daxa::Device device, MaterialRegistry& material_registry);
 
         static void serialize(YAML::Emitter& out, Entity& entity);
-        static void deserialize(YAML::Node& node, Entity& entity, daxa::Device& device);
+        static void deserialize(YAML::Node& node, Entity& entity, daxa::Device& device, MaterialRegistry& material_registry);
     };
 
     struct ShadowInfo {
         glm::mat4 view{1.0f};
         glm::mat4 projection{1.0f};
-        daxa::ImageId depth_image;
-        daxa::ImageId shadow_image;
-        daxa::ImageId temp_shadow_image;
-        bool has_to_resize = false;
-        glm::ivec2 image_size = {1024, 1024};
+        ShadowAtlasTile tile = {};
+        glm::mat4 cached_light_matrix{0.0f};
+        bool static_cache_dirty = true;
+        // time slicing, see Scene::schedule_shadow_updates
+        f32 screen_coverage = 0.0f;
+        f32 importance = 0.0f;
+        u32 frames_since_update = 0;
+        bool contents_valid = false;
+        bool update_scheduled = false;
         f32 clip_space = 128.0f;
     };
 
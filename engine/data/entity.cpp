@@ -105,18 +105,29 @@ namespace Stellar {
                 tc.is_dirty = true;
             }
 
-            if(tc.is_dirty) {
-                tc.model_matrix = glm::translate(glm::mat4(1.0f), tc.position) 
-                    * glm::toMat4(glm::quat({glm::radians(tc.rotation.x), glm::radians(tc.rotation.y), glm::radians(tc.rotation.z)})) 
-                    * glm::scale(glm::mat4(1.0f), tc.scale);
+            bool moved_last_frame = tc.moved;
+            tc.moved = tc.is_dirty;
 
-                tc.normal_matrix = glm::transpose(glm::inverse(tc.model_matrix));
+            if(tc.is_dirty || moved_last_frame) {
+                glm::mat4 previous_model_matrix = tc.model_matrix;
 
-                tc.is_dirty = false;
+                if(tc.is_dirty) {
+                    tc.model_matrix = glm::translate(glm::mat4(1.0f), tc.position) 
+                        * glm::toMat4(glm::quat({glm::radians(tc.rotation.x), glm::radians(tc.rotation.y), glm::radians(tc.rotation.z)})) 
+                        * glm::scale(glm::mat4(1.0f), tc.scale);
+
+                    tc.normal_matrix = glm::transpose(glm::inverse(tc.model_matrix));
+
+                    tc.is_dirty = false;
+                }
+
+                // a freshly created buffer has no last frame to move from
+                if(tc.transform_buffer.is_empty()) { previous_model_matrix = tc.model_matrix; }
 
                 TransformInfo tc_info = {
                     .model_matrix = *reinterpret_cast<daxa::f32mat4x4*>(&tc.model_matrix),
                     .normal_matrix = *reinterpret_cast<daxa::f32mat4x4*>(&tc.normal_matrix),
+                    .previous_model_matrix = *reinterpret_cast<daxa::f32mat4x4*>(&previous_model_matrix),
                 };
 
                 daxa::BufferId buffer = tc.transform_buffer;
@@ -20,6 +20,11 @@
 #include <glm/gtx/rotate_vector.hpp>
 
 #include <graphics/model.hpp>
+#include <graphics/material_registry.hpp>
+#include <graphics/draw_commands.hpp>
+#include <graphics/frustum.hpp>
+#include <graphics/shadow_atlas.hpp>
+#include <utils/threadpool.hpp>
 #include <physics/physics.hpp>
 #define NDEBUG true
 #include <PxPhysicsAPI.h>
@@ -85,9 +90,48 @@ YAML::Emitter &operator<<(YAML::Emitter &out, const glm::vec4 &v) {
 }*/
 
 namespace Stellar {
-    Scene::Scene(const std::string_view& _name, daxa::Device _device, daxa::PipelineManager& pipeline_manager) : name{_name}, device{_device} {
+    // only bodies the physics simulation moves are treated as dynamic shadow casters
+    static auto is_dynamic_caster(Entity entity) -> bool {
+        return entity.has_component<RigidBodyComponent>() && entity.get_component<RigidBodyComponent>().rigid_body_type == RigidBodyType::Dynamic;
+    }
+
+    static void copy_shadow_cache(daxa::CommandList& cmd_list, daxa::ImageId src, daxa::ImageId dst, daxa::ImageAspectFlags aspect, const ShadowAtlasTile& tile) {
+        cmd_list.copy_image_to_image({
+            .src_image = src,
+            .src_image_layout = daxa::ImageLayout::TRANSFER_SRC_OPTIMAL,
+            .dst_image = dst,
+            .dst_image_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+            .src_slice = {.image_aspect = aspect},
+            .src_offset = {static_cast<i32>(tile.x), static_cast<i32>(tile.y), 0},
+            .dst_slice = {.image_aspect = aspect},
+            .dst_offset = {static_cast<i32>(tile.x), static_cast<i32>(tile.y), 0},
+            .extent = {tile.size, tile.size, 1},
+        });
+    }
+
+    // distance at which a light's 1/d² falloff drops below what is worth shading, composition fades it to zero there
+    static auto light_influence_radius(const glm::vec3& color, f32 intensity) -> f32 {
+        constexpr f32 threshold = 0.01f;
+        f32 luminance = intensity * std::max(color.r, std::max(color.g, color.b));
+        return glm::sqrt(std::max(luminance, 0.0f) / threshold);
+    }
+
+    static void set_tile_viewport(daxa::CommandList& cmd_list, const ShadowAtlasTile& tile) {
+        cmd_list.set_viewport({
+            .x = static_cast<f32>(tile.x),
+            .y = static_cast<f32>(tile.y),
+            .width = static_cast<f32>(tile.size),
+            .height = static_cast<f32>(tile.size),
+            .min_depth = 0.0f,
+            .max_depth = 1.0f,
+        });
+    }
+
+    Scene::Scene(const std::string_view& _name, daxa::Device _device, PipelineCache& pipeline_cache, std::shared_ptr<MaterialRegistry> _material_registry) : name{_name}, device{_device}, material_registry{std::move(_material_registry)} {
         registry = std::make_unique<entt::registry>();
         physics = std::make_unique<Physics>();
+        draw_commands = std::make_unique<DrawCommandBuilder>(device);
+        thread_pool = std::make_unique<ThreadPool>();
 
         light_buffer = device.create_buffer({
             .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
@@ -95,7 +139,7 @@ namespace Stellar {
             .debug_name = "light buffer",
         });
 
-        normal_shadow_pipeline = pipeline_manager.add_raster_pipeline({
+        normal_shadow_pipeline = pipeline_cache.add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"normal_shadow.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"normal_shadow.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .color_attachments = {},
@@ -106,12 +150,13 @@ namespace Stellar {
             },
             .raster = {
                 .face_culling = daxa::FaceCullFlagBits::NONE,
+                .depth_clamp_enable = true,
             },
             .push_constant_size = sizeof(ShadowPush),
             .debug_name = "normal_shadow_pipeline",
-        }).value();
+        });
 
-        variance_shadow_pipeline = pipeline_manager.add_raster_pipeline({
+        variance_shadow_pipeline = pipeline_cache.add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"variance_shadow.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"variance_shadow.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .color_attachments = {
@@ -127,22 +172,22 @@ namespace Stellar {
             },
             .push_constant_size = sizeof(ShadowPush),
             .debug_name = "variance_shadow_pipeline",
-        }).value();
+        });
 
-        filter_gauss_pipeline = pipeline_manager.add_raster_pipeline({
-            .vertex_shader_info = {.source = daxa::ShaderFile{"filter_gauss.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
-            .fragment_shader_info = {.source = daxa::ShaderFile{"filter_gauss.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
-            .color_attachments = {
-                { .format = daxa::Format::R16G16_UNORM },
-            },
-            .raster = {
-                .face_culling = daxa::FaceCullFlagBits::NONE,
-            },
-            .push_constant_size = sizeof(GaussPush),
-            .debug_name = "filter_gauss_pipeline",
-        }).value();
+        vsm_blur_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"vsm_blur.glsl"}},
+            .push_constant_size = sizeof(VSMBlurPush),
+            .debug_name = "vsm_blur_pipeline",
+        });
 
-        pcf_sampler = this->device.create_sampler({
+        vsm_downsample_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"vsm_downsample.glsl"}},
+            .push_constant_size = sizeof(VSMDownsamplePush),
+            .debug_name = "vsm_downsample_pipeline",
+        });
+
+        // shared with every other scene through the registry
+        pcf_sampler = material_registry->get_sampler({
             .magnification_filter = daxa::Filter::LINEAR,
             .minification_filter = daxa::Filter::LINEAR,
             .mipmap_filter = daxa::Filter::LINEAR,
@@ -159,6 +204,58 @@ namespace Stellar {
             .border_color = daxa::BorderColor::FLOAT_OPAQUE_WHITE,
             .enable_unnormalized_coordinates = false,
         });
+
+        auto create_vsm_sampler = [&](u32 mip_count) -> daxa::SamplerId {
+            return material_registry->get_sampler({
+                .magnification_filter = daxa::Filter::LINEAR,
+                .minification_filter = daxa::Filter::LINEAR,
+                .mipmap_filter = daxa::Filter::LINEAR,
+                .address_mode_u = daxa::SamplerAddressMode::CLAMP_TO_EDGE,
+                .address_mode_v = daxa::SamplerAddressMode::CLAMP_TO_EDGE,
+                .address_mode_w = daxa::SamplerAddressMode::CLAMP_TO_EDGE,
+                .mip_lod_bias = 0.0f,
+                .enable_anisotropy = false,
+                .enable_compare = false,
+                .min_lod = 0.0f,
+                .max_lod = static_cast<f32>(mip_count - 1),
+                .enable_unnormalized_coordinates = false,
+            });
+        };
+
+        vsm_sampler = create_vsm_sampler(1);
+        vsm_mip_sampler = create_vsm_sampler(VSM_MIP_COUNT);
+
+        // every shadow map lives in a tile of one of these. they're never discarded so untouched tiles survive,
+        // their layouts and barriers come from the shadow tasks of the editor's task list
+        auto create_atlas = [&](daxa::Format format, daxa::ImageAspectFlags aspect, daxa::ImageUsageFlags usage, const std::string& debug_name, u32 mip_count = 1) -> daxa::ImageId {
+            return device.create_image({
+                .format = format,
+                .aspect = aspect,
+                .size = { ShadowAtlas::SIZE, ShadowAtlas::SIZE, 1 },
+                .mip_level_count = mip_count,
+                .usage = usage,
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .debug_name = debug_name,
+            });
+        };
+
+        directional_shadow_atlas = create_atlas(daxa::Format::D16_UNORM, daxa::ImageAspectFlagBits::DEPTH, daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST, "directional shadow atlas");
+        static_directional_shadow_atlas = create_atlas(daxa::Format::D16_UNORM, daxa::ImageAspectFlagBits::DEPTH, daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::TRANSFER_SRC, "static directional shadow atlas");
+        spot_depth_atlas = create_atlas(daxa::Format::D16_UNORM, daxa::ImageAspectFlagBits::DEPTH, daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::TRANSFER_DST, "spot depth atlas");
+        spot_moment_atlas = create_atlas(daxa::Format::R16G16_UNORM, daxa::ImageAspectFlagBits::COLOR, daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST, "spot moment atlas");
+        spot_shadow_atlas = create_atlas(daxa::Format::R16G16_UNORM, daxa::ImageAspectFlagBits::COLOR, daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::SHADER_READ_WRITE, "spot shadow atlas", VSM_MIP_COUNT);
+
+        for(u32 mip = 0; mip < VSM_MIP_COUNT; mip++) {
+            spot_shadow_mip_views.push_back(device.create_image_view({
+                .type = daxa::ImageViewType::REGULAR_2D,
+                .format = daxa::Format::R16G16_UNORM,
+                .image_id = spot_shadow_atlas,
+                .slice = {.base_mip_level = mip, .level_count = 1},
+                .debug_name = "spot shadow mip view",
+            }));
+        }
+        static_spot_depth_atlas = create_atlas(daxa::Format::D16_UNORM, daxa::ImageAspectFlagBits::DEPTH, daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::TRANSFER_SRC, "static spot depth atlas");
+        static_spot_shadow_atlas = create_atlas(daxa::Format::R16G16_UNORM, daxa::ImageAspectFlagBits::COLOR, daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::TRANSFER_SRC, "static spot shadow atlas");
     }
 
     Scene::~Scene() {
@@ -169,31 +266,17 @@ namespace Stellar {
                     device.destroy_buffer(tc.transform_buffer);
                 }
             }
-
-            if(entity.has_component<DirectionalLightComponent>()) {
-                auto& lc = entity.get_component<DirectionalLightComponent>();
-                if(!lc.shadow_info.shadow_image.is_empty()) {
-                    device.destroy_image(lc.shadow_info.shadow_image);
-                }
-            }
-
-            if(entity.has_component<SpotLightComponent>()) {
-                auto& lc = entity.get_component<SpotLightComponent>();
-                if(!lc.shadow_info.shadow_image.is_empty()) {
-                    device.destroy_image(lc.shadow_info.shadow_image);
-                }
-
-                if(!lc.shadow_info.depth_image.is_empty()) {
-                    device.destroy_image(lc.shadow_info.depth_image);
-                }
-
-                if(!lc.shadow_info.temp_shadow_image.is_empty()) {
-                    device.destroy_image(lc.shadow_info.temp_shadow_image);
-                }
-            }
         });
 
-        device.destroy_sampler(pcf_sampler);
+        device.destroy_image(directional_shadow_atlas);
+        device.destroy_image(static_directional_shadow_atlas);
+        device.destroy_image(spot_depth_atlas);
+        for(auto& view : spot_shadow_mip_views) { device.destroy_image_view(view); }
+        device.destroy_image(spot_shadow_atlas);
+        device.destroy_image(spot_moment_atlas);
+        device.destroy_image(static_spot_depth_atlas);
+        device.destroy_image(static_spot_shadow_atlas);
+
         device.destroy_buffer(lines_buffer);
         device.destroy_buffer(light_buffer);
     }
@@ -333,7 +416,7 @@ namespace Stellar {
 
             auto model_component = entity["ModelComponent"];
             if (model_component) {
-                ModelComponent::deserialize(model_component, deserialized_entity, device);
+                ModelComponent::deserialize(model_component, deserialized_entity, device, *material_registry);
             }
 
             auto directional_light_component = entity["DirectionalLightComponent"];
@@ -395,9 +478,134 @@ namespace Stellar {
         registry = std::make_unique<entt::registry>();
     }
 
-    void Scene::update() {
+    void Scene::allocate_shadow_tiles(const ViewInfo& view_info, bool& light_updated) {
+        std::vector<ShadowAtlasRequest> directional_requests = {};
+        std::vector<ShadowInfo*> directional_infos = {};
+        std::vector<ShadowAtlasRequest> spot_requests = {};
+        std::vector<ShadowInfo*> spot_infos = {};
+
+        iterate([&](Entity entity){
+            if(!entity.has_component<TransformComponent>()) { return; }
+            auto& tc = entity.get_component<TransformComponent>();
+
+            if(entity.has_component<DirectionalLightComponent>()) {
+                auto& light = entity.get_component<DirectionalLightComponent>();
+                directional_requests.push_back(ShadowAtlasRequest {
+                    .size = ShadowAtlas::MAX_TILE_SIZE,
+                    .importance = light.intensity,
+                    .tile = light.shadow_info.tile,
+                });
+                directional_infos.push_back(&light.shadow_info);
+
+                // covers the whole view so it is always kept fresh
+                light.shadow_info.screen_coverage = 1.0f;
+                light.shadow_info.importance = light.intensity;
+            }
+
+            if(entity.has_component<SpotLightComponent>()) {
+                auto& light = entity.get_component<SpotLightComponent>();
+
+                glm::vec3 dir = { 0.0f, -1.0f, 0.0f };
+                dir = glm::rotateX(dir, glm::radians(tc.rotation.x));
+                dir = glm::rotateY(dir, glm::radians(tc.rotation.y));
+                dir = glm::rotateZ(dir, glm::radians(tc.rotation.z));
+
+                // sphere around the cone, projected to a fraction of the screen height
+                f32 range = light.shadow_info.clip_space;
+                f32 tan_half_angle = glm::tan(glm::radians(light.outer_cut_off * 0.5f));
+                f32 radius = range * glm::sqrt(0.25f + tan_half_angle * tan_half_angle);
+                glm::vec3 center = tc.position + dir * (range * 0.5f);
+                f32 distance = glm::length(center - view_info.camera_position);
+
+                f32 coverage = 1.0f;
+                if(distance > radius) {
+                    coverage = std::min(radius / glm::sqrt(distance * distance - radius * radius) * view_info.projection_scale, 1.0f);
+                }
+
+                spot_requests.push_back(ShadowAtlasRequest {
+                    .size = ShadowAtlas::tile_size_for_coverage(coverage, light.shadow_info.tile.size),
+                    .importance = coverage * light.intensity,
+                    .tile = light.shadow_info.tile,
+                });
+                spot_infos.push_back(&light.shadow_info);
+
+                light.shadow_info.screen_coverage = coverage;
+                light.shadow_info.importance = coverage * light.intensity;
+            }
+        });
+
+        ShadowAtlas::allocate(directional_requests);
+        ShadowAtlas::allocate(spot_requests);
+
+        auto assign_tiles = [&](const std::vector<ShadowAtlasRequest>& requests, const std::vector<ShadowInfo*>& infos) {
+            for(usize i = 0; i < requests.size(); i++) {
+                if(infos[i]->tile == requests[i].tile) { continue; }
+
+                infos[i]->tile = requests[i].tile;
+                infos[i]->static_cache_dirty = true;
+                infos[i]->contents_valid = false;
+                light_updated = true;
+            }
+        };
+
+        assign_tiles(directional_requests, directional_infos);
+        assign_tiles(spot_requests, spot_infos);
+    }
+
+    void Scene::schedule_shadow_updates(bool static_casters_changed) {
+        std::vector<ShadowInfo*> infos = {};
+        iterate([&](Entity entity){
+            if(entity.has_component<DirectionalLightComponent>()) { infos.push_back(&entity.get_component<DirectionalLightComponent>().shadow_info); }
+            if(entity.has_component<SpotLightComponent>()) { infos.push_back(&entity.get_component<SpotLightComponent>().shadow_info); }
+        });
+
+        auto cost = [](const ShadowInfo* info) -> u32 {
+            u32 texels = info->tile.size * info->tile.size;
+            return info->static_cache_dirty ? texels * 2 : texels;
+        };
+
+        u32 spent = 0;
+        std::vector<ShadowInfo*> candidates = {};
+        for(ShadowInfo* info : infos) {
+            info->update_scheduled = false;
+            if(info->tile.size == 0) { continue; }
+
+            // the cache is only redrawn once the light is scheduled, so the change is remembered on it
+            if(static_casters_changed) { info->static_cache_dirty = true; }
+
+            // a tile without valid contents or rendered from an old light matrix would be wrong rather than stale
+            bool forced = !info->contents_valid || info->cached_light_matrix != info->projection * info->view || info->screen_coverage >= 1.0f;
+            if(forced) {
+                info->update_scheduled = true;
+                spent += cost(info);
+            } else {
+                candidates.push_back(info);
+            }
+        }
+
+        // staleness grows the priority so small or dim lights still get refreshed at a reduced rate
+        std::sort(candidates.begin(), candidates.end(), [](const ShadowInfo* a, const ShadowInfo* b) {
+            return a->importance * static_cast<f32>(a->frames_since_update + 1) > b->importance * static_cast<f32>(b->frames_since_update + 1);
+        });
+
+        for(ShadowInfo* info : candidates) {
+            u32 info_cost = cost(info);
+            // the first one always goes through so a tile bigger than the budget cannot starve
+            if(spent != 0 && spent + info_cost > shadow_update_texel_budget) { continue; }
+
+            info->update_scheduled = true;
+            spent += info_cost;
+        }
+
+        for(ShadowInfo* info : infos) {
+            info->frames_since_update = info->update_scheduled ? 0 : info->frames_since_update + 1;
+        }
+    }
+
+    void Scene::update(const ViewInfo& view_info) {
         bool light_updated = false;
         bool update_aabb = false;
+        bool static_casters_changed = false;
 
         iterate([&](Entity entity){
             if(entity.has_component<TransformComponent>()) {
@@ -405,6 +613,7 @@ namespace Stellar {
                     if(entity.has_component<ModelComponent>()) {
                         if(entity.get_component<ModelComponent>().model) {
                             update_aabb = true;
+                            if(!is_dynamic_caster(entity)) { static_casters_changed = true; }
                         }
                     }
 
@@ -436,6 +645,13 @@ namespace Stellar {
             }
         });
 
+        allocate_shadow_tiles(view_info, light_updated);
+
+        // spot lights pick their sampler by whether the moment mips get written
+        if(light_buffer_vsm_mips != vsm_moment_mips) {
+            light_buffer_vsm_mips = vsm_moment_mips;
+            light_updated = true;
+        }
 
         if(light_updated) {
             LightBuffer temp_light_buffer = {};
@@ -465,20 +681,14 @@ namespace Stellar {
                         glm::vec3 look_pos = pos + dir;
                         light.shadow_info.view = glm::lookAt(pos, look_pos, glm::vec3(0.0, -1.0, 0.0));
 
-                        if(light.shadow_info.shadow_image.is_empty()) {
-                            light.shadow_info.shadow_image = device.create_image({
-                                .format = daxa::Format::D16_UNORM,
-                                .aspect = daxa::ImageAspectFlagBits::DEPTH,
-                                .size = {static_cast<u32>(light.shadow_info.image_size.x), static_cast<u32>(light.shadow_info.image_size.y), 1},
-                                .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-                            });
-                        }
 
                         temp_light.direction = *reinterpret_cast<const f32vec3 *>(&dir);
                         temp_light.color = *reinterpret_cast<const f32vec3 *>(&light.color);
                         temp_light.intensity = light.intensity;
 
-                        temp_light.shadow_image = TextureId { .texture_id = light.shadow_info.shadow_image.default_view(), .sampler_id = pcf_sampler };
+                        temp_light.shadow_image = TextureId { .texture_id = directional_shadow_atlas.default_view(), .sampler_id = pcf_sampler };
+                        glm::vec4 shadow_rect = ShadowAtlas::tile_rect(light.shadow_info.tile);
+                        temp_light.shadow_rect = *reinterpret_cast<const f32vec4*>(&shadow_rect);
 
                         glm::mat4 light_matrix = light.shadow_info.projection * light.shadow_info.view;
 
@@ -494,6 +704,7 @@ namespace Stellar {
                         temp_light.position = *reinterpret_cast<const f32vec3 *>(&tc.position);
                         temp_light.color = *reinterpret_cast<const f32vec3 *>(&light.color);
                         temp_light.intensity = light.intensity;
+                        temp_light.radius = light_influence_radius(light.color, light.intensity);
 
                         temp_light_buffer.num_point_lights++;
                     }
@@ -518,28 +729,6 @@ namespace Stellar {
                         glm::vec3 look_pos = pos + dir;
                         light.shadow_info.view = glm::lookAt(pos, look_pos, glm::vec3(0.0, 1.0, 0.0));
 
-                        if(light.shadow_info.shadow_image.is_empty()) {
-                            light.shadow_info.depth_image = device.create_image({
-                                .format = daxa::Format::D16_UNORM,
-                                .aspect = daxa::ImageAspectFlagBits::DEPTH,
-                                .size = {static_cast<u32>(light.shadow_info.image_size.x), static_cast<u32>(light.shadow_info.image_size.y), 1},
-                                .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-                            });
-
-                            light.shadow_info.shadow_image = device.create_image({
-                                .format = daxa::Format::R16G16_UNORM,
-                                .aspect = daxa::ImageAspectFlagBits::COLOR,
-                                .size = {static_cast<u32>(light.shadow_info.image_size.x), static_cast<u32>(light.shadow_info.image_size.y), 1},
-                                .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-                            });
-
-                            light.shadow_info.temp_shadow_image = device.create_image({
-                                .format = daxa::Format::R16G16_UNORM,
-                                .aspect = daxa::ImageAspectFlagBits::COLOR,
-                                .size = {static_cast<u32>(light.shadow_info.image_size.x), static_cast<u32>(light.shadow_info.image_size.y), 1},
-                                .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-                            });
-                        }
 
                         temp_light.position = *reinterpret_cast<const f32vec3 *>(&tc.position);
                         temp_light.direction = *reinterpret_cast<const f32vec3 *>(&dir);
@@ -547,8 +736,11 @@ namespace Stellar {
                         temp_light.intensity = light.intensity;
                         temp_light.cut_off = glm::cos(glm::radians(light.cut_off));
                         temp_light.outer_cut_off = glm::cos(glm::radians(light.outer_cut_off));
+                        temp_light.radius = light_influence_radius(light.color, light.intensity);
 
-                        temp_light.shadow_image = TextureId { .texture_id = light.shadow_info.shadow_image.default_view(), .sampler_id = pcf_sampler };
+                        temp_light.shadow_image = TextureId { .texture_id = spot_shadow_atlas.default_view(), .sampler_id = light_buffer_vsm_mips ? vsm_mip_sampler : vsm_sampler };
+                        glm::vec4 shadow_rect = ShadowAtlas::tile_rect(light.shadow_info.tile);
+                        temp_light.shadow_rect = *reinterpret_cast<const f32vec4*>(&shadow_rect);
 
                         glm::mat4 light_matrix = light.shadow_info.projection * light.shadow_info.view;
 
@@ -594,159 +786,64 @@ namespace Stellar {
             .debug_name = "",
         });
 
+        draw_commands->clear();
+        iterate([&](Entity entity){
+            if(entity.has_component<ModelComponent>() && entity.has_component<TransformComponent>()) {
+                auto& model = entity.get_component<ModelComponent>().model;
+                if(!model) { return; }
+                auto& tc = entity.get_component<TransformComponent>();
 
-        iterate([&](Entity light_entity){
-            if(light_entity.has_component<DirectionalLightComponent>()) {
-                auto& light = light_entity.get_component<DirectionalLightComponent>();
-
-                u32 size_x = static_cast<u32>(light.shadow_info.image_size.x);
-                u32 size_y = static_cast<u32>(light.shadow_info.image_size.y);
-                
-                cmd_list.pipeline_barrier_image_transition({
-                    .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-                    .before_layout = daxa::ImageLayout::UNDEFINED,
-                    .after_layout = daxa::ImageLayout::GENERAL,
-                    .image_slice = {.image_aspect = daxa::ImageAspectFlagBits::DEPTH },
-                    .image_id = light.shadow_info.shadow_image,
-                });
-
-                cmd_list.begin_renderpass({
-                    .depth_attachment = {{
-                        .image_view = light.shadow_info.shadow_image.default_view(),
-                        .load_op = daxa::AttachmentLoadOp::CLEAR,
-                        .clear_value = daxa::DepthValue{1.0f, 0},
-                    }},
-                    .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
-                });
-                cmd_list.set_pipeline(*normal_shadow_pipeline);
-
-                ShadowPush push;
-                glm::mat4 vp = light.shadow_info.projection * light.shadow_info.view;
-                push.light_matrix = *reinterpret_cast<const f32mat4x4*>(&vp);
-
-                iterate([&](Entity entity){
-                    if(entity.has_component<ModelComponent>()) {
-                        auto& model = entity.get_component<ModelComponent>().model;
-                        if(!model) { return; }
-                        auto& tc = entity.get_component<TransformComponent>();
-
-                        push.transform_buffer = device.get_device_address(tc.transform_buffer);
-
-                        model->draw(cmd_list, push);
-                    }
-                });
-
-                cmd_list.end_renderpass();
-
+                draw_commands->add(model.get(), device.get_device_address(tc.transform_buffer), tc.model_matrix, static_cast<u32>(entity), is_dynamic_caster(entity));
             }
+        });
+        draw_commands->build(cmd_list, view_info.frame_index, view_info.camera_position, thread_pool.get());
 
-            if(light_entity.has_component<SpotLightComponent>()) {
-                auto& light = light_entity.get_component<SpotLightComponent>();
-
-                u32 size_x = static_cast<u32>(light.shadow_info.image_size.x);
-                u32 size_y = static_cast<u32>(light.shadow_info.image_size.y);
-                
-                cmd_list.pipeline_barrier_image_transition({
-                    .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-                    .before_layout = daxa::ImageLayout::UNDEFINED,
-                    .after_layout = daxa::ImageLayout::GENERAL,
-                    .image_slice = {.image_aspect = daxa::ImageAspectFlagBits::DEPTH },
-                    .image_id = light.shadow_info.depth_image,
-                });
-
-                cmd_list.pipeline_barrier_image_transition({
-                    .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-                    .before_layout = daxa::ImageLayout::UNDEFINED,
-                    .after_layout = daxa::ImageLayout::GENERAL,
-                    .image_slice = {.image_aspect = daxa::ImageAspectFlagBits::COLOR },
-                    .image_id = light.shadow_info.shadow_image,
-                });
-
-                cmd_list.pipeline_barrier_image_transition({
-                    .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-                    .before_layout = daxa::ImageLayout::UNDEFINED,
-                    .after_layout = daxa::ImageLayout::GENERAL,
-                    .image_slice = {.image_aspect = daxa::ImageAspectFlagBits::COLOR },
-                    .image_id = light.shadow_info.temp_shadow_image,
-                });
-
-                cmd_list.begin_renderpass({
-                    .color_attachments = {
-                        {
-                            .image_view = light.shadow_info.shadow_image.default_view(),
-                            .load_op = daxa::AttachmentLoadOp::CLEAR,
-                            .clear_value = std::array<f32, 4>{1.0f, 1.0f, 1.0f, 1.0f},
-                        },
-                    },
-                    .depth_attachment = {{
-                        .image_view = light.shadow_info.depth_image.default_view(),
-                        .load_op = daxa::AttachmentLoadOp::CLEAR,
-                        .clear_value = daxa::DepthValue{1.0f, 0},
-                    }},
-                    .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
-                });
-                cmd_list.set_pipeline(*variance_shadow_pipeline);
-
-                ShadowPush push;
-                glm::mat4 vp = light.shadow_info.projection * light.shadow_info.view;
-                push.light_matrix = *reinterpret_cast<const f32mat4x4*>(&vp);
-
-                iterate([&](Entity entity){
-                    if(entity.has_component<ModelComponent>()) {
-                        auto& model = entity.get_component<ModelComponent>().model;
-                        if(!model) { return; }
-                        auto& tc = entity.get_component<TransformComponent>();
-
-                        push.transform_buffer = device.get_device_address(tc.transform_buffer);
-
-                        model->draw(cmd_list, push);
-                    }
-                });
+        // static casters are rendered once into a cache per light and only redrawn when the light or one of
+        // them changes, each frame copies the cache into the live map and draws the dynamic casters on top
+        if(static_shadow_caster_hash != draw_commands->static_caster_hash) {
+            static_shadow_caster_hash = draw_commands->static_caster_hash;
+            static_casters_changed = true;
+        }
 
-                cmd_list.end_renderpass();
+        schedule_shadow_updates(static_casters_changed);
 
-                cmd_list.begin_renderpass({
-                    .color_attachments = {
-                        {
-                            .image_view = light.shadow_info.temp_shadow_image.default_view(),
-                            .load_op = daxa::AttachmentLoadOp::CLEAR,
-                            .clear_value = std::array<f32, 4>{1.0f, 1.0f, 1.0f, 1.0f},
-                        },
-                    },
-                    .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
-                });
-                cmd_list.set_pipeline(*filter_gauss_pipeline);
+        // each scheduled light is culled once here, the shadow tasks of the frame's task list record its passes
+        shadow_passes.clear();
+        auto add_shadow_pass = [&](ShadowInfo& info, bool spot) {
+            if(info.tile.size == 0 || !info.update_scheduled) { return; }
 
-                
-                cmd_list.push_constant(GaussPush {
-                    .src_texture = light.shadow_info.shadow_image.default_view(),
-                    .blur_scale = { 1.0f / static_cast<f32>(size_x), 0.0f }
-                });
-                cmd_list.draw({ .vertex_count = 3});
+            glm::mat4 vp = info.projection * info.view;
+            Frustum frustum = Frustum::from_matrix(vp);
+            // casters between the light and the volume still throw shadows into it, so the near plane
+            // is dropped to extrude the volume towards the light and the pipeline clamps their depth
+            if(!spot) { frustum.planes[4] = glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}; }
+            const std::vector<u32>& visible = draw_commands->cull(frustum, vp, thread_pool.get());
 
-                cmd_list.end_renderpass();
+            if(info.cached_light_matrix != vp) {
+                info.static_cache_dirty = true;
+            }
 
-                cmd_list.begin_renderpass({
-                    .color_attachments = {
-                        {
-                            .image_view = light.shadow_info.shadow_image.default_view(),
-                            .load_op = daxa::AttachmentLoadOp::CLEAR,
-                            .clear_value = std::array<f32, 4>{1.0f, 1.0f, 1.0f, 1.0f},
-                        },
-                    },
-                    .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
-                });
-                cmd_list.set_pipeline(*filter_gauss_pipeline);
+            // the cache and the dynamic pass see the same instances, they only keep different halves of them
+            ShadowPass pass = {
+                .tile = info.tile,
+                .light_matrix = vp,
+                .spot = spot,
+                .redraw_cache = info.static_cache_dirty,
+            };
+            if(pass.redraw_cache) {
+                pass.static_draws = draw_commands->build_culled(visible, DrawFilter::Static);
+                info.cached_light_matrix = vp;
+                info.static_cache_dirty = false;
+            }
+            pass.dynamic_draws = draw_commands->build_culled(visible, DrawFilter::Dynamic);
 
-                
-                cmd_list.push_constant(GaussPush {
-                    .src_texture = light.shadow_info.temp_shadow_image.default_view(),
-                    .blur_scale = { 0.0f, 1.0f / static_cast<f32>(size_y) }
-                });
-                cmd_list.draw({ .vertex_count = 3});
+            info.contents_valid = true;
+            shadow_passes.push_back(pass);
+        };
 
-                cmd_list.end_renderpass();
-            }
+        iterate([&](Entity light_entity){
+            if(light_entity.has_component<DirectionalLightComponent>()) { add_shadow_pass(light_entity.get_component<DirectionalLightComponent>().shadow_info, false); }
+            if(light_entity.has_component<SpotLightComponent>()) { add_shadow_pass(light_entity.get_component<SpotLightComponent>().shadow_info, true); }
         });
 
         cmd_list.complete();
@@ -767,8 +864,9 @@ namespace Stellar {
                         std::cout << "min: " << primitive.aabb.min.x << " " << primitive.aabb.min.y << " " << primitive.aabb.min.z << std::endl;
                         std::cout << "max: " << primitive.aabb.max.x << " " << primitive.aabb.max.y << " " << primitive.aabb.max.z << std::endl;*/
 
-                        glm::vec4 min = tc.model_matrix * glm::vec4(primitive.aabb.min, 1.0);
-                        glm::vec4 max = tc.model_matrix * glm::vec4(primitive.aabb.max, 1.0);
+                        AABB world_aabb = transform_aabb(primitive.aabb, tc.model_matrix);
+                        glm::vec3 min = world_aabb.min;
+                        glm::vec3 max = world_aabb.max;
 
                         /*std::cout << "------new--AABB------------" << std::endl;
                         std::cout << "min: " << min.x << " " << min.y << " " << min.z << std::endl;
@@ -859,6 +957,163 @@ namespace Stellar {
         }
     }
 
+    void Scene::register_task_images(daxa::TaskList& task_list) {
+        auto add_atlas = [&](daxa::ImageId image, const std::string& debug_name) -> daxa::TaskImageId {
+            daxa::TaskImageId task_image = task_list.create_task_image({ .debug_name = debug_name });
+            task_list.add_runtime_image(task_image, image);
+            return task_image;
+        };
+
+        task_directional_shadow_atlas = add_atlas(directional_shadow_atlas, "task_directional_shadow_atlas");
+        task_static_directional_shadow_atlas = add_atlas(static_directional_shadow_atlas, "task_static_directional_shadow_atlas");
+        task_spot_depth_atlas = add_atlas(spot_depth_atlas, "task_spot_depth_atlas");
+        task_spot_moment_atlas = add_atlas(spot_moment_atlas, "task_spot_moment_atlas");
+        task_spot_shadow_atlas = add_atlas(spot_shadow_atlas, "task_spot_shadow_atlas");
+        task_static_spot_depth_atlas = add_atlas(static_spot_depth_atlas, "task_static_spot_depth_atlas");
+        task_static_spot_shadow_atlas = add_atlas(static_spot_shadow_atlas, "task_static_spot_shadow_atlas");
+
+        // a new task list starts every image from undefined, so no tile or cache survives it
+        iterate([&](Entity entity){
+            auto invalidate = [](ShadowInfo& info) {
+                info.contents_valid = false;
+                info.static_cache_dirty = true;
+            };
+            if(entity.has_component<DirectionalLightComponent>()) { invalidate(entity.get_component<DirectionalLightComponent>().shadow_info); }
+            if(entity.has_component<SpotLightComponent>()) { invalidate(entity.get_component<SpotLightComponent>().shadow_info); }
+        });
+    }
+
+    void Scene::render_shadow_caches(daxa::CommandList& cmd_list) {
+        for(auto& pass : shadow_passes) {
+            if(!pass.redraw_cache) { continue; }
+
+            ShadowPush push;
+            push.light_matrix = *reinterpret_cast<const f32mat4x4*>(&pass.light_matrix);
+            daxa::Rect2D render_area = {.x = static_cast<i32>(pass.tile.x), .y = static_cast<i32>(pass.tile.y), .width = pass.tile.size, .height = pass.tile.size};
+
+            if(pass.spot) {
+                cmd_list.begin_renderpass({
+                    .color_attachments = {
+                        {
+                            .image_view = static_spot_shadow_atlas.default_view(),
+                            .load_op = daxa::AttachmentLoadOp::CLEAR,
+                            .clear_value = std::array<f32, 4>{1.0f, 1.0f, 1.0f, 1.0f},
+                        },
+                    },
+                    .depth_attachment = {{
+                        .image_view = static_spot_depth_atlas.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::CLEAR,
+                        .clear_value = daxa::DepthValue{1.0f, 0},
+                    }},
+                    .render_area = render_area,
+                });
+                cmd_list.set_pipeline(*variance_shadow_pipeline);
+            } else {
+                cmd_list.begin_renderpass({
+                    .depth_attachment = {{
+                        .image_view = static_directional_shadow_atlas.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::CLEAR,
+                        .clear_value = daxa::DepthValue{1.0f, 0},
+                    }},
+                    .render_area = render_area,
+                });
+                cmd_list.set_pipeline(*normal_shadow_pipeline);
+            }
+            set_tile_viewport(cmd_list, pass.tile);
+
+            draw_commands->draw(cmd_list, push, pass.static_draws);
+
+            cmd_list.end_renderpass();
+        }
+    }
+
+    void Scene::copy_shadow_caches(daxa::CommandList& cmd_list) {
+        for(auto& pass : shadow_passes) {
+            if(pass.spot) {
+                copy_shadow_cache(cmd_list, static_spot_depth_atlas, spot_depth_atlas, daxa::ImageAspectFlagBits::DEPTH, pass.tile);
+                copy_shadow_cache(cmd_list, static_spot_shadow_atlas, spot_moment_atlas, daxa::ImageAspectFlagBits::COLOR, pass.tile);
+            } else {
+                copy_shadow_cache(cmd_list, static_directional_shadow_atlas, directional_shadow_atlas, daxa::ImageAspectFlagBits::DEPTH, pass.tile);
+            }
+        }
+    }
+
+    void Scene::render_dynamic_shadows(daxa::CommandList& cmd_list) {
+        for(auto& pass : shadow_passes) {
+            ShadowPush push;
+            push.light_matrix = *reinterpret_cast<const f32mat4x4*>(&pass.light_matrix);
+            daxa::Rect2D render_area = {.x = static_cast<i32>(pass.tile.x), .y = static_cast<i32>(pass.tile.y), .width = pass.tile.size, .height = pass.tile.size};
+
+            if(pass.spot) {
+                cmd_list.begin_renderpass({
+                    .color_attachments = {
+                        {
+                            .image_view = spot_moment_atlas.default_view(),
+                            .load_op = daxa::AttachmentLoadOp::LOAD,
+                            .clear_value = std::array<f32, 4>{1.0f, 1.0f, 1.0f, 1.0f},
+                        },
+                    },
+                    .depth_attachment = {{
+                        .image_view = spot_depth_atlas.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::LOAD,
+                        .clear_value = daxa::DepthValue{1.0f, 0},
+                    }},
+                    .render_area = render_area,
+                });
+                cmd_list.set_pipeline(*variance_shadow_pipeline);
+            } else {
+                cmd_list.begin_renderpass({
+                    .depth_attachment = {{
+                        .image_view = directional_shadow_atlas.default_view(),
+                        .load_op = daxa::AttachmentLoadOp::LOAD,
+                        .clear_value = daxa::DepthValue{1.0f, 0},
+                    }},
+                    .render_area = render_area,
+                });
+                cmd_list.set_pipeline(*normal_shadow_pipeline);
+            }
+            set_tile_viewport(cmd_list, pass.tile);
+
+            draw_commands->draw(cmd_list, push, pass.dynamic_draws);
+
+            cmd_list.end_renderpass();
+        }
+    }
+
+    void Scene::blur_spot_shadows(daxa::CommandList& cmd_list) {
+        cmd_list.set_pipeline(*vsm_blur_pipeline);
+        for(auto& pass : shadow_passes) {
+            if(!pass.spot) { continue; }
+
+            cmd_list.push_constant(VSMBlurPush {
+                .src = spot_moment_atlas.default_view(),
+                .dst = spot_shadow_mip_views[0],
+                .tile_offset = { pass.tile.x, pass.tile.y },
+                .tile_size = pass.tile.size,
+            });
+            cmd_list.dispatch((pass.tile.size + VSM_BLUR_TILE_SIZE - 1) / VSM_BLUR_TILE_SIZE, (pass.tile.size + VSM_BLUR_TILE_SIZE - 1) / VSM_BLUR_TILE_SIZE);
+        }
+    }
+
+    void Scene::downsample_spot_shadows(daxa::CommandList& cmd_list, u32 mip) {
+        if(!vsm_moment_mips) { return; }
+
+        cmd_list.set_pipeline(*vsm_downsample_pipeline);
+        for(auto& pass : shadow_passes) {
+            if(!pass.spot) { continue; }
+
+            // tiles sit at multiples of their power of two size, so they stay aligned in every mip
+            u32 mip_size = pass.tile.size >> mip;
+            cmd_list.push_constant(VSMDownsamplePush {
+                .src = spot_shadow_mip_views[mip - 1],
+                .dst = spot_shadow_mip_views[mip],
+                .tile_offset = { pass.tile.x >> mip, pass.tile.y >> mip },
+                .tile_size = mip_size,
+            });
+            cmd_list.dispatch((mip_size + 7) / 8, (mip_size + 7) / 8);
+        }
+    }
+
     void Scene::physics_update(f32 delta_time) {
         physics->step(delta_time);
     }
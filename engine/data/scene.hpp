@@ -9,14 +9,28 @@
 
 #include <functional>
 
-#include <daxa/utils/pipeline_manager.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <graphics/shadow_atlas.hpp>
+#include <graphics/draw_commands.hpp>
+
+#include <daxa/utils/task_list.hpp>
 
 namespace Stellar {
     struct Entity;
     struct Physics;
+    struct MaterialRegistry;
+    class ThreadPool;
 
     struct Scene {
-        explicit Scene(const std::string_view& _name, daxa::Device _device, daxa::PipelineManager& pipeline_manager);
+        // camera the shadow atlas sizes its tiles for
+        struct ViewInfo {
+            glm::vec3 camera_position = { 0.0f, 0.0f, 0.0f };
+            f32 projection_scale = 1.0f;
+            // counts the frames the gpu renders, the ring of cpu culled draws advances with it
+            u64 frame_index = 0;
+        };
+
+        explicit Scene(const std::string_view& _name, daxa::Device _device, PipelineCache& pipeline_cache, std::shared_ptr<MaterialRegistry> _material_registry);
         ~Scene();
 
         auto create_entity(const std::string_view& _name) -> Entity;
@@ -31,23 +45,77 @@ namespace Stellar {
 
         void reset();
 
-        void update();
+        void update(const ViewInfo& view_info = {});
+        void allocate_shadow_tiles(const ViewInfo& view_info, bool& light_updated);
+        void schedule_shadow_updates(bool static_casters_changed);
+
+        void register_task_images(daxa::TaskList& task_list);
+        // the passes update prepared, recorded by the editor's task list in this order. it derives the barriers
+        // and layouts between them from the atlas uses each task declares
+        void render_shadow_caches(daxa::CommandList& cmd_list);
+        void copy_shadow_caches(daxa::CommandList& cmd_list);
+        void render_dynamic_shadows(daxa::CommandList& cmd_list);
+        void blur_spot_shadows(daxa::CommandList& cmd_list);
+        void downsample_spot_shadows(daxa::CommandList& cmd_list, u32 mip);
 
         void physics_update(f32 delta_time);
 
         std::string name;
         std::unique_ptr<entt::registry> registry;
         daxa::Device device;
+        std::shared_ptr<MaterialRegistry> material_registry;
         std::unique_ptr<Physics> physics;
+        std::unique_ptr<DrawCommandBuilder> draw_commands;
+        std::unique_ptr<ThreadPool> thread_pool;
 
         daxa::BufferId light_buffer;
         daxa::BufferId lines_buffer;
         u32 lines_vertices;
-
-        std::shared_ptr<daxa::RasterPipeline> normal_shadow_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> variance_shadow_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> filter_gauss_pipeline;
+        // the builder's hash of the static casters the shadow caches were drawn with
+        u64 static_shadow_caster_hash = 0;
+        // a light scheduled this frame, culled once in update. the cache is only redrawn when it went stale
+        struct ShadowPass {
+            ShadowAtlasTile tile = {};
+            glm::mat4 light_matrix{1.0f};
+            bool spot = false;
+            bool redraw_cache = false;
+            CulledDraws static_draws = {};
+            CulledDraws dynamic_draws = {};
+        };
+        std::vector<ShadowPass> shadow_passes = {};
+
+        // texels of shadow map redrawn per frame, lights whose tile is invalid, that moved or that the camera is inside go over it
+        u32 shadow_update_texel_budget = ShadowAtlas::SIZE * ShadowAtlas::SIZE;
+
+        RasterPipelineHandle normal_shadow_pipeline;
+        RasterPipelineHandle variance_shadow_pipeline;
+        ComputePipelineHandle vsm_blur_pipeline;
+        ComputePipelineHandle vsm_downsample_pipeline;
 
         daxa::SamplerId pcf_sampler;
+        daxa::SamplerId vsm_sampler;
+        daxa::SamplerId vsm_mip_sampler;
+
+        // blurred spot moments get a mip chain so minified lookups in composition stay filtered
+        static constexpr u32 VSM_MIP_COUNT = 4;
+        bool vsm_moment_mips = true;
+        bool light_buffer_vsm_mips = true;
+
+        daxa::ImageId directional_shadow_atlas;
+        daxa::ImageId static_directional_shadow_atlas;
+        daxa::ImageId spot_depth_atlas;
+        daxa::ImageId spot_moment_atlas;
+        daxa::ImageId spot_shadow_atlas;
+        std::vector<daxa::ImageViewId> spot_shadow_mip_views;
+        daxa::ImageId static_spot_depth_atlas;
+        daxa::ImageId static_spot_shadow_atlas;
+
+        daxa::TaskImageId task_directional_shadow_atlas;
+        daxa::TaskImageId task_static_directional_shadow_atlas;
+        daxa::TaskImageId task_spot_depth_atlas;
+        daxa::TaskImageId task_spot_moment_atlas;
+        daxa::TaskImageId task_spot_shadow_atlas;
+        daxa::TaskImageId task_static_spot_depth_atlas;
+        daxa::TaskImageId task_static_spot_shadow_atlas;
     };
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include <graphics/blue_noise.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace Stellar {
+    struct VoidAndCluster {
+        explicit VoidAndCluster(u32 _size) : size{_size}, pattern(_size * _size, 0), energy(_size * _size, 0.0f), kernel(_size * _size, 0.0f) {
+            constexpr f32 sigma = 1.5f;
+            for(u32 y = 0; y < size; y++) {
+                for(u32 x = 0; x < size; x++) {
+                    // toroidal distance so the result tiles
+                    f32 dx = static_cast<f32>(std::min(x, size - x));
+                    f32 dy = static_cast<f32>(std::min(y, size - y));
+                    kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+                }
+            }
+        }
+
+        void set(u32 index, bool value) {
+            pattern[index] = value ? 1 : 0;
+            f32 sign = value ? 1.0f : -1.0f;
+            u32 px = index % size;
+            u32 py = index / size;
+            for(u32 y = 0; y < size; y++) {
+                u32 ky = (y + size - py) % size;
+                for(u32 x = 0; x < size; x++) {
+                    u32 kx = (x + size - px) % size;
+                    energy[y * size + x] += sign * kernel[ky * size + kx];
+                }
+            }
+        }
+
+        // densest set point, or emptiest unset point
+        auto find(bool tightest_cluster) const -> u32 {
+            u32 best = 0;
+            f32 best_energy = tightest_cluster ? -1.0f : std::numeric_limits<f32>::max();
+            for(u32 i = 0; i < pattern.size(); i++) {
+                if((pattern[i] != 0) != tightest_cluster) { continue; }
+                if(tightest_cluster ? energy[i] > best_energy : energy[i] < best_energy) {
+                    best = i;
+                    best_energy = energy[i];
+                }
+            }
+            return best;
+        }
+
+        u32 size;
+        std::vector<u8> pattern;
+        std::vector<f32> energy;
+        std::vector<f32> kernel;
+    };
+
+    auto generate_blue_noise(u32 size) -> std::vector<u8> {
+        u32 count = size * size;
+        VoidAndCluster initial{size};
+
+        std::mt19937 rng{0x5eed};
+        std::uniform_int_distribution<u32> distribution{0, count - 1};
+        u32 ones = std::max(count / 10, 1u);
+        for(u32 placed = 0; placed < ones;) {
+            u32 index = distribution(rng);
+            if(initial.pattern[index] != 0) { continue; }
+            initial.set(index, true);
+            placed++;
+        }
+
+        // spread the random points out until moving the tightest one lands it back where it was
+        while(true) {
+            u32 cluster = initial.find(true);
+            initial.set(cluster, false);
+            u32 void_index = initial.find(false);
+            initial.set(void_index, true);
+            if(void_index == cluster) { break; }
+        }
+
+        std::vector<u32> rank(count, 0);
+
+        // ranks below the initial points, removing the tightest clusters first
+        VoidAndCluster removal = initial;
+        for(u32 remaining = ones; remaining > 0; remaining--) {
+            u32 cluster = removal.find(true);
+            removal.set(cluster, false);
+            rank[cluster] = remaining - 1;
+        }
+
+        // ranks above them, filling the largest voids first
+        VoidAndCluster insertion = initial;
+        for(u32 filled = ones; filled < count; filled++) {
+            u32 void_index = insertion.find(false);
+            insertion.set(void_index, true);
+            rank[void_index] = filled;
+        }
+
+        std::vector<u8> result(count, 0);
+        for(u32 i = 0; i < count; i++) {
+            result[i] = static_cast<u8>((rank[i] * 256) / count);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <core/types.hpp>
+
+namespace Stellar {
+    // tileable blue noise threshold map from the void and cluster method, size x size values in [0, 255]
+    // with every rank used equally often, deterministic so it can be generated at startup instead of shipped
+    auto generate_blue_noise(u32 size) -> std::vector<u8>;
+}
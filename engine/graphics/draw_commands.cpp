@@ -0,0 +1,484 @@
+#include <graphics/draw_commands.hpp>
+#include <graphics/model.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+namespace Stellar {
+    DrawCommandBuilder::DrawCommandBuilder(daxa::Device _device) : device{_device} {}
+
+    DrawCommandBuilder::~DrawCommandBuilder() {
+        if(!command_buffer.is_empty()) { device.destroy_buffer(command_buffer); }
+        if(!empty_command_buffer.is_empty()) { device.destroy_buffer(empty_command_buffer); }
+        if(!draw_data_buffer.is_empty()) { device.destroy_buffer(draw_data_buffer); }
+        if(!instance_buffer.is_empty()) { device.destroy_buffer(instance_buffer); }
+        for(auto& buffer : culled_buffers) {
+            if(!buffer.is_empty()) { device.destroy_buffer(buffer); }
+        }
+        for(auto& buffers : retired_culled_buffers) {
+            for(auto& buffer : buffers) { device.destroy_buffer(buffer); }
+        }
+    }
+
+    void DrawCommandBuilder::clear() {
+        entries.clear();
+    }
+
+    void DrawCommandBuilder::add(Model* model, daxa::BufferDeviceAddress transform_buffer, const glm::mat4& model_matrix, u32 id, bool is_dynamic) {
+        entries.push_back(Entry {
+            .model = model,
+            .transform_buffer = transform_buffer,
+            .model_matrix = model_matrix,
+            .id = id,
+            .is_dynamic = is_dynamic
+        });
+    }
+
+    void DrawCommandBuilder::sort_entries(const glm::vec3& camera_position, ThreadPool* thread_pool) {
+        entry_distances.clear();
+        model_distances.clear();
+        for(auto& entry : entries) {
+            f32 distance = glm::length(glm::vec3{entry.model_matrix[3]} - camera_position);
+            entry_distances.push_back(distance);
+
+            auto [it, inserted] = model_distances.try_emplace(entry.model, distance);
+            if(!inserted) { it->second = std::min(it->second, distance); }
+        }
+
+        model_order.clear();
+        for(auto& [model, distance] : model_distances) { model_order.emplace_back(distance, model); }
+        std::sort(model_order.begin(), model_order.end());
+
+        model_ranks.clear();
+        for(u32 i = 0; i < model_order.size(); i++) { model_ranks[model_order[i].second] = i; }
+
+        // everything the builder draws is opaque. this only orders the entities, which become the instances of their
+        // model's commands; an entity's primitives can need different pipelines, those are ordered with the batches
+        render_queue.clear();
+        for(u32 i = 0; i < entries.size(); i++) {
+            render_queue.push(SortKey::make(RenderPass::Opaque, 0, model_ranks[entries[i].model], SortKey::depth_bucket(entry_distances[i]), 0), i);
+        }
+        render_queue.sort(thread_pool);
+
+        sorted_entries.clear();
+        for(auto& packet : render_queue.packets) { sorted_entries.push_back(entries[packet.index]); }
+        entries.swap(sorted_entries);
+    }
+
+    // fnv-1a over an entity's id and the model it draws
+    static auto hash_caster(const DrawCommandBuilder::Entry& entry) -> u64 {
+        u64 hash = 0xcbf29ce484222325ull;
+        auto hash_bytes = [&](const void* data, usize size) {
+            const u8* bytes = static_cast<const u8*>(data);
+            for(usize i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * 0x100000001b3ull; }
+        };
+        hash_bytes(&entry.id, sizeof(entry.id));
+        hash_bytes(&entry.model, sizeof(entry.model));
+        return hash;
+    }
+
+    void DrawCommandBuilder::build(daxa::CommandList& cmd_list, u64 frame_index, const glm::vec3& camera_position, ThreadPool* thread_pool) {
+        sort_entries(camera_position, thread_pool);
+
+        // a sum so it doesn't depend on the order the entries were sorted in, which follows the camera
+        static_caster_hash = 0;
+        for(auto& entry : entries) {
+            if(!entry.is_dynamic) { static_caster_hash += hash_caster(entry); }
+        }
+
+        // the ring follows the frames rather than the builds, the draws of frame - CULLED_RING_FRAMES have been
+        // consumed by now. another build in the same frame keeps appending so it can't overwrite the draws before it
+        if(frame_index != culled_frame_index) {
+            culled_frame_index = frame_index;
+            culled_frame = static_cast<u32>(frame_index % CULLED_RING_FRAMES);
+            culled_offset = 0;
+            for(auto& buffer : retired_culled_buffers[culled_frame]) { device.destroy_buffer(buffer); }
+            retired_culled_buffers[culled_frame].clear();
+        }
+
+        commands.clear();
+        draw_data.clear();
+        instances.clear();
+        batches.clear();
+        bounds.clear();
+        dynamic_instances.clear();
+        static_instance_count = 0;
+        occluder_candidates.clear();
+        draw_keys.clear();
+
+        model_ranges.clear();
+        for(usize first = 0; first < entries.size();) {
+            usize last = first;
+            while(last < entries.size() && entries[last].model == entries[first].model) { last++; }
+            model_ranges.emplace_back(static_cast<u32>(first), static_cast<u32>(last));
+            first = last;
+        }
+
+        // a batch per model and material permutation its primitives use, keyed by the permutation as the pipeline so
+        // the g-buffer pass switches pipelines at most once per permutation and goes front to back within each
+        batch_queue.clear();
+        for(u32 range = 0; range < model_ranges.size(); range++) {
+            Model* model = entries[model_ranges[range].first].model;
+
+            u32 permutations = 0;
+            for(auto& primitive : model->primitives) { permutations |= 1u << primitive.material_features; }
+
+            for(u32 permutation = 0; permutation < MATERIAL_PERMUTATION_COUNT; permutation++) {
+                if((permutations & (1u << permutation)) == 0) { continue; }
+                batch_queue.push(SortKey::make(RenderPass::Opaque, permutation, model_ranks[model], SortKey::depth_bucket(model_distances[model]), 0), range * MATERIAL_PERMUTATION_COUNT + permutation);
+            }
+        }
+        batch_queue.sort(thread_pool);
+
+        // every entity of a model is an instance of each of its primitives, so a model costs one command per
+        // primitive no matter how many entities use it
+        for(auto& packet : batch_queue.packets) {
+            auto [first, last] = model_ranges[packet.index / MATERIAL_PERMUTATION_COUNT];
+            u32 permutation = packet.index % MATERIAL_PERMUTATION_COUNT;
+            Model* model = entries[first].model;
+
+            batches.push_back(DrawBatch {
+                .model = model,
+                .permutation = permutation,
+                .first_command = static_cast<u32>(commands.size()),
+                .command_count = 0
+            });
+
+            for(u32 primitive_index = 0; primitive_index < model->primitives.size(); primitive_index++) {
+                const Primitive& primitive = model->primitives[primitive_index];
+                if(primitive.material_features != permutation) { continue; }
+
+                u32 command_index = static_cast<u32>(commands.size());
+                commands.push_back(DrawIndexedIndirectCommand {
+                    .index_count = primitive.index_count,
+                    .instance_count = last - first,
+                    .first_index = primitive.first_index,
+                    .vertex_offset = static_cast<i32>(primitive.first_vertex),
+                    .first_instance = static_cast<u32>(instances.size()),
+                });
+
+                for(u32 i = first; i < last; i++) {
+                    const Entry& entry = entries[i];
+                    u32 draw_index = static_cast<u32>(draw_data.size());
+
+                    bounds.add(primitive.aabb, entry.model_matrix, draw_index);
+                    dynamic_instances.push_back(static_cast<u8>(entry.is_dynamic));
+                    if(!entry.is_dynamic) { static_instance_count++; }
+
+                    if(!entry.is_dynamic && primitive.index_count <= MAX_OCCLUDER_TRIANGLES * 3) {
+                        AABB world_aabb = transform_aabb(primitive.aabb, entry.model_matrix);
+                        occluder_candidates.push_back(Occluder {
+                            .model = model,
+                            .primitive = primitive_index,
+                            .model_matrix = entry.model_matrix,
+                            .draw_index = draw_index,
+                            .size = glm::length(world_aabb.max - world_aabb.min),
+                        });
+                    }
+
+                    draw_data.push_back(DrawData {
+                        .transform_buffer = entry.transform_buffer,
+                        .material_index = primitive.material_index,
+                        .command_index = command_index,
+                        .aabb_min = *reinterpret_cast<const f32vec3*>(&primitive.aabb.min),
+                        .aabb_max = *reinterpret_cast<const f32vec3*>(&primitive.aabb.max),
+                        .vertex_buffer = device.get_device_address(model->face_buffer),
+                        .index_buffer = device.get_device_address(model->index_buffer),
+                        .first_index = primitive.first_index,
+                        .vertex_offset = static_cast<i32>(primitive.first_vertex),
+                        // assigned once every draw of the frame is known
+                        .visibility_slot = 0,
+                    });
+
+                    draw_keys.push_back((static_cast<u64>(entry.id) << 32) | primitive_index);
+                    instances.push_back(DrawInstance { .draw_index = draw_index });
+                }
+
+                batches.back().command_count++;
+            }
+        }
+
+        assign_visibility_slots();
+
+        usize candidate_count = std::min<usize>(occluder_candidates.size(), OCCLUDER_CANDIDATE_COUNT);
+        std::partial_sort(occluder_candidates.begin(), occluder_candidates.begin() + static_cast<isize>(candidate_count), occluder_candidates.end(), [](const Occluder& a, const Occluder& b) {
+            return a.size > b.size;
+        });
+        occluder_candidates.resize(candidate_count);
+
+        if(commands.empty()) { return; }
+
+        u32 command_count = static_cast<u32>(commands.size());
+        if(command_count > command_capacity) {
+            command_capacity = std::max(command_count, command_capacity * 2);
+
+            if(!command_buffer.is_empty()) { cmd_list.destroy_buffer_deferred(command_buffer); }
+            command_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * command_capacity),
+                .debug_name = "draw command buffer",
+            });
+
+            if(!empty_command_buffer.is_empty()) { cmd_list.destroy_buffer_deferred(empty_command_buffer); }
+            empty_command_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * command_capacity),
+                .debug_name = "empty draw command buffer",
+            });
+        }
+
+        u32 instance_count = static_cast<u32>(instances.size());
+        if(instance_count > instance_capacity) {
+            instance_capacity = std::max(instance_count, instance_capacity * 2);
+
+            if(!draw_data_buffer.is_empty()) { cmd_list.destroy_buffer_deferred(draw_data_buffer); }
+            draw_data_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawData) * instance_capacity),
+                .debug_name = "draw data buffer",
+            });
+
+            if(!instance_buffer.is_empty()) { cmd_list.destroy_buffer_deferred(instance_buffer); }
+            instance_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawInstance) * instance_capacity),
+                .debug_name = "draw instance buffer",
+            });
+        }
+
+        u32 commands_size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * commands.size());
+        u32 draw_data_size = static_cast<u32>(sizeof(DrawData) * draw_data.size());
+        u32 instances_size = static_cast<u32>(sizeof(DrawInstance) * instances.size());
+
+        daxa::BufferId staging_buffer = device.create_buffer({
+            .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+            .size = commands_size * 2 + draw_data_size + instances_size,
+            .debug_name = "draw command staging buffer",
+        });
+        cmd_list.destroy_buffer_deferred(staging_buffer);
+
+        auto* buffer_ptr = device.get_host_address_as<u8>(staging_buffer);
+        std::memcpy(buffer_ptr, commands.data(), commands_size);
+        auto* empty_commands = reinterpret_cast<DrawIndexedIndirectCommand*>(buffer_ptr + commands_size);
+        std::memcpy(empty_commands, commands.data(), commands_size);
+        for(u32 i = 0; i < command_count; i++) { empty_commands[i].instance_count = 0; }
+        std::memcpy(buffer_ptr + commands_size * 2, draw_data.data(), draw_data_size);
+        std::memcpy(buffer_ptr + commands_size * 2 + draw_data_size, instances.data(), instances_size);
+
+        cmd_list.pipeline_barrier({
+            .awaited_pipeline_access = daxa::AccessConsts::HOST_WRITE,
+            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_READ,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = staging_buffer,
+            .dst_buffer = command_buffer,
+            .size = commands_size,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = staging_buffer,
+            .src_offset = commands_size,
+            .dst_buffer = empty_command_buffer,
+            .size = commands_size,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = staging_buffer,
+            .src_offset = commands_size * 2,
+            .dst_buffer = draw_data_buffer,
+            .size = draw_data_size,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = staging_buffer,
+            .src_offset = commands_size * 2 + draw_data_size,
+            .dst_buffer = instance_buffer,
+            .size = instances_size,
+        });
+
+        cmd_list.pipeline_barrier({
+            .awaited_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
+            .waiting_pipeline_access = daxa::AccessConsts::READ,
+        });
+    }
+
+    // the sort reorders the draws every frame, the culling system's occlusion history is indexed by these slots
+    // instead so it follows the objects. a reused slot starts with its old owner's history, which at worst draws
+    // it once in the early phase or leaves it to the late one
+    void DrawCommandBuilder::assign_visibility_slots() {
+        next_visibility_slots.clear();
+        unslotted_draws.clear();
+
+        for(u32 i = 0; i < draw_data.size(); i++) {
+            auto it = visibility_slots.find(draw_keys[i]);
+            if(it == visibility_slots.end()) {
+                unslotted_draws.push_back(i);
+                continue;
+            }
+
+            draw_data[i].visibility_slot = it->second;
+            next_visibility_slots.emplace(draw_keys[i], it->second);
+        }
+
+        for(auto& [key, slot] : visibility_slots) {
+            if(!next_visibility_slots.contains(key)) { free_visibility_slots.push_back(slot); }
+        }
+
+        for(u32 i : unslotted_draws) {
+            u32 slot = visibility_slot_count;
+            if(free_visibility_slots.empty()) {
+                visibility_slot_count++;
+            } else {
+                slot = free_visibility_slots.back();
+                free_visibility_slots.pop_back();
+            }
+
+            draw_data[i].visibility_slot = slot;
+            next_visibility_slots.emplace(draw_keys[i], slot);
+        }
+
+        visibility_slots.swap(next_visibility_slots);
+    }
+
+    auto DrawCommandBuilder::cull(const Frustum& frustum, const glm::mat4& view_projection, ThreadPool* thread_pool) -> const std::vector<u32>& {
+        occlusion_buffer.begin(view_projection);
+
+        u32 occluder_count = 0;
+        for(auto& occluder : occluder_candidates) {
+            if(occluder_count == MAX_VIEW_OCCLUDERS) { break; }
+
+            u32 i = occluder.draw_index;
+            glm::vec3 center = { bounds.center_x[i], bounds.center_y[i], bounds.center_z[i] };
+            glm::vec3 extent = { bounds.extent_x[i], bounds.extent_y[i], bounds.extent_z[i] };
+            if(!frustum.intersects(AABB { .min = center - extent, .max = center + extent })) { continue; }
+
+            const Primitive& primitive = occluder.model->primitives[occluder.primitive];
+            occlusion_buffer.add_occluder(
+                std::span{occluder.model->cpu_positions}.subspan(primitive.first_vertex, primitive.vertex_count),
+                std::span{occluder.model->cpu_indices}.subspan(primitive.first_index, primitive.index_count),
+                occluder.model_matrix
+            );
+            occluder_count++;
+        }
+
+        if(occluder_count == 0) { return bounds.cull(frustum, thread_pool); }
+
+        occlusion_buffer.rasterize(thread_pool);
+        return bounds.cull(frustum, thread_pool, &occlusion_buffer);
+    }
+
+    auto DrawCommandBuilder::build_culled(const std::vector<u32>& visible, DrawFilter filter) -> CulledDraws {
+        if(commands.empty()) { return {}; }
+
+        auto align = [](u32 size) { return (size + CULLED_ALIGNMENT - 1) & ~(CULLED_ALIGNMENT - 1); };
+        u32 commands_size = align(static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * commands.size()));
+        u32 instances_size = align(static_cast<u32>(sizeof(DrawInstance) * instances.size()));
+
+        daxa::BufferId& buffer = culled_buffers[culled_frame];
+        u32& capacity = culled_capacities[culled_frame];
+        if(culled_offset + commands_size + instances_size > capacity) {
+            // passes earlier this frame still point into the old buffer and may be recorded later in the frame,
+            // so it lives until the ring comes back around to this frame like the buffer replacing it
+            capacity = std::max(commands_size + instances_size, capacity * 2);
+            culled_offset = 0;
+
+            if(!buffer.is_empty()) { retired_culled_buffers[culled_frame].push_back(buffer); }
+            buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+                .size = capacity,
+                .debug_name = "cpu culled draw buffer",
+            });
+        }
+
+        CulledDraws culled = {
+            .command_buffer = buffer,
+            .instance_buffer = buffer,
+            .command_offset = culled_offset,
+            .instance_offset = culled_offset + commands_size,
+        };
+        culled_offset += commands_size + instances_size;
+
+        u8* buffer_ptr = device.get_host_address_as<u8>(buffer);
+        auto* command_ptr = reinterpret_cast<DrawIndexedIndirectCommand*>(buffer_ptr + culled.command_offset);
+        auto* instance_ptr = reinterpret_cast<DrawInstance*>(buffer_ptr + culled.instance_offset);
+
+        std::memcpy(command_ptr, commands.data(), sizeof(DrawIndexedIndirectCommand) * commands.size());
+        for(usize i = 0; i < commands.size(); i++) { command_ptr[i].instance_count = 0; }
+
+        for(u32 index : visible) {
+            if(filter == DrawFilter::Static && dynamic_instances[index] != 0) { continue; }
+            if(filter == DrawFilter::Dynamic && dynamic_instances[index] == 0) { continue; }
+
+            DrawIndexedIndirectCommand& command = command_ptr[draw_data[index].command_index];
+            instance_ptr[command.first_instance + command.instance_count++] = DrawInstance { .draw_index = index };
+        }
+
+        return culled;
+    }
+
+    // passes that don't care about materials give no pipelines and draw every batch with the one they bound
+    template<typename T>
+    static void draw_batches(DrawCommandBuilder& builder, daxa::CommandList& cmd_list, T& draw_push, const CulledDraws* culled, const MaterialPipelines* pipelines = nullptr) {
+        if(builder.commands.empty()) { return; }
+
+        draw_push.draw_data_buffer = builder.device.get_device_address(builder.draw_data_buffer);
+        if(culled != nullptr) {
+            draw_push.instance_buffer = builder.device.get_device_address(culled->instance_buffer) + culled->instance_offset;
+        } else {
+            draw_push.instance_buffer = builder.device.get_device_address(builder.instance_buffer);
+        }
+        daxa::BufferId command_buffer = culled != nullptr ? culled->command_buffer : builder.command_buffer;
+        usize command_offset = culled != nullptr ? culled->command_offset : 0;
+
+        Model* bound_model = nullptr;
+        u32 bound_permutation = MATERIAL_PERMUTATION_COUNT;
+        for(auto& batch : builder.batches) {
+            if(pipelines != nullptr && batch.permutation != bound_permutation) {
+                cmd_list.set_pipeline(*(*pipelines)[batch.permutation]);
+                bound_permutation = batch.permutation;
+                bound_model = nullptr;
+            }
+
+            if(batch.model != bound_model) {
+                draw_push.vertex_buffer = builder.device.get_device_address(batch.model->face_buffer);
+                cmd_list.push_constant(draw_push);
+                cmd_list.set_index_buffer(batch.model->index_buffer, 0, 4);
+                bound_model = batch.model;
+            }
+
+            cmd_list.draw_indirect({
+                .draw_command_buffer = command_buffer,
+                .draw_command_buffer_read_offset = command_offset + batch.first_command * sizeof(DrawIndexedIndirectCommand),
+                .draw_count = batch.command_count,
+                .draw_command_stride = sizeof(DrawIndexedIndirectCommand),
+                .is_indexed = true,
+            });
+        }
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push) {
+        draw_batches(*this, cmd_list, draw_push, nullptr);
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push, const CulledDraws& culled) {
+        draw_batches(*this, cmd_list, draw_push, &culled);
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, DrawPush& draw_push, const MaterialPipelines& pipelines) {
+        draw_batches(*this, cmd_list, draw_push, nullptr, &pipelines);
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, DrawPush& draw_push, const CulledDraws& culled, const MaterialPipelines& pipelines) {
+        draw_batches(*this, cmd_list, draw_push, &culled, &pipelines);
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, ShadowPush& draw_push) {
+        draw_batches(*this, cmd_list, draw_push, nullptr);
+    }
+
+    void DrawCommandBuilder::draw(daxa::CommandList& cmd_list, ShadowPush& draw_push, const CulledDraws& culled) {
+        draw_batches(*this, cmd_list, draw_push, &culled);
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+
+#include <graphics/frustum_culler.hpp>
+#include <graphics/occlusion_buffer.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <graphics/render_queue.hpp>
+
+#include "../../shaders/shared.inl"
+
+#include <array>
+#include <limits>
+#include <unordered_map>
+
+namespace Stellar {
+    struct Model;
+
+    // one indirect multi-draw, every command in it shares the model's index and vertex buffer and the material permutation.
+    // there's a command per primitive of the model, instanced over every entity that uses it
+    struct DrawBatch {
+        Model* model = nullptr;
+        u32 permutation = 0;
+        u32 first_command = 0;
+        u32 command_count = 0;
+    };
+
+    // the builder's commands with only the visible instances, compacted to the front of each command's instance range.
+    // a command nothing of survived stays in place with an instance count of zero. the cpu culled draws share one
+    // ring buffer, the offsets are where in it they start
+    struct CulledDraws {
+        daxa::BufferId command_buffer;
+        daxa::BufferId instance_buffer;
+        u32 command_offset = 0;
+        u32 instance_offset = 0;
+    };
+
+    // g-buffer pipelines indexed by MATERIAL_FEATURE mask
+    using MaterialPipelines = std::array<RasterPipelineHandle, MATERIAL_PERMUTATION_COUNT>;
+
+    enum struct DrawFilter : u32 {
+        All = 0,
+        Static = 1,
+        Dynamic = 2,
+    };
+
+    struct DrawCommandBuilder {
+        // static instances ranked by size once per build, each view rasterizes the biggest of them it can see
+        static constexpr u32 OCCLUDER_CANDIDATE_COUNT = 32;
+        static constexpr u32 MAX_VIEW_OCCLUDERS = 8;
+        // rasterizing a dense mesh costs more than the draws it could save
+        static constexpr u32 MAX_OCCLUDER_TRIANGLES = 4096;
+        // culled draws are written straight into host visible memory, one buffer per frame the gpu may still be reading
+        static constexpr u32 CULLED_RING_FRAMES = 4;
+        static constexpr u32 CULLED_ALIGNMENT = 16;
+
+        DrawCommandBuilder(daxa::Device _device);
+        ~DrawCommandBuilder();
+
+        void clear();
+        // the id has to stay the same for an entity from frame to frame, its primitives keep their visibility slots by it
+        void add(Model* model, daxa::BufferDeviceAddress transform_buffer, const glm::mat4& model_matrix, u32 id, bool is_dynamic = false);
+        // orders the entries and then the batches through the render queue, so batches are grouped by material
+        // permutation and batches and instances go roughly front to back from the camera within each.
+        // the frame index picks the culled draw ring buffer, a second build in the same frame appends to it
+        void build(daxa::CommandList& cmd_list, u64 frame_index, const glm::vec3& camera_position = {}, ThreadPool* thread_pool = nullptr);
+
+        // culls the built instances against the frustum on the cpu, then against the largest static occluders in view
+        // rasterized for the view projection. returns draw data indices, valid until the next cull
+        auto cull(const Frustum& frustum, const glm::mat4& view_projection, ThreadPool* thread_pool = nullptr) -> const std::vector<u32>&;
+        // writes the visible instances that pass the filter in the same layout the gpu culling uses, one cull can
+        // feed several passes of the same view
+        auto build_culled(const std::vector<u32>& visible, DrawFilter filter = DrawFilter::All) -> CulledDraws;
+
+        void draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push);
+        void draw(daxa::CommandList& cmd_list, DrawPush& draw_push, const MaterialPipelines& pipelines);
+        void draw(daxa::CommandList& cmd_list, ShadowPush& draw_push);
+
+        void draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push, const CulledDraws& culled);
+        void draw(daxa::CommandList& cmd_list, DrawPush& draw_push, const CulledDraws& culled, const MaterialPipelines& pipelines);
+        void draw(daxa::CommandList& cmd_list, ShadowPush& draw_push, const CulledDraws& culled);
+
+        struct Occluder {
+            Model* model = nullptr;
+            u32 primitive = 0;
+            glm::mat4 model_matrix = glm::mat4{1.0f};
+            u32 draw_index = 0;
+            f32 size = 0.0f;
+        };
+
+        struct Entry {
+            Model* model = nullptr;
+            daxa::BufferDeviceAddress transform_buffer = {};
+            glm::mat4 model_matrix = glm::mat4{1.0f};
+            u32 id = 0;
+            bool is_dynamic = false;
+        };
+
+        daxa::Device device;
+        daxa::BufferId command_buffer = {};
+        // the same commands with no instances, culling starts from a copy of it and counts the survivors in
+        daxa::BufferId empty_command_buffer = {};
+        daxa::BufferId draw_data_buffer = {};
+        daxa::BufferId instance_buffer = {};
+        u32 command_capacity = 0;
+        u32 instance_capacity = 0;
+
+        std::vector<Entry> entries = {};
+        RenderQueue render_queue = {};
+        std::vector<Entry> sorted_entries = {};
+        std::vector<f32> entry_distances = {};
+        // models ranked by their entity closest to the camera, the mesh field of the sort key
+        std::unordered_map<Model*, f32> model_distances = {};
+        std::vector<std::pair<f32, Model*>> model_order = {};
+        std::unordered_map<Model*, u32> model_ranks = {};
+        // entries of each model once sorted
+        std::vector<std::pair<u32, u32>> model_ranges = {};
+        // one packet per model and material permutation, indexed by model range * MATERIAL_PERMUTATION_COUNT + permutation
+        RenderQueue batch_queue = {};
+
+        std::vector<DrawIndexedIndirectCommand> commands = {};
+        // one per entity and primitive, grouped by command so instance i of the unculled draws is draw data i
+        std::vector<DrawData> draw_data = {};
+        std::vector<DrawInstance> instances = {};
+        std::vector<DrawBatch> batches = {};
+
+        // visibility slots by entity id and primitive index, a slot is given back once its pair isn't drawn anymore.
+        // there's never more slots than instances in the frame, the culling system's visibility buffer is sized by them
+        std::vector<u64> draw_keys = {};
+        std::unordered_map<u64, u32> visibility_slots = {};
+        std::unordered_map<u64, u32> next_visibility_slots = {};
+        std::vector<u32> free_visibility_slots = {};
+        std::vector<u32> unslotted_draws = {};
+        u32 visibility_slot_count = 0;
+
+        // world space bounds of every instance, ids are draw data indices
+        FrustumCuller bounds = {};
+        std::vector<u8> dynamic_instances = {};
+        u32 static_instance_count = 0;
+        // changes whenever a static entity is added, removed or draws another model, the shadow caches key on it
+        u64 static_caster_hash = 0;
+        std::array<daxa::BufferId, CULLED_RING_FRAMES> culled_buffers = {};
+        std::array<u32, CULLED_RING_FRAMES> culled_capacities = {};
+        u32 culled_frame = 0;
+        u32 culled_offset = 0;
+        u64 culled_frame_index = std::numeric_limits<u64>::max();
+        // outgrown ring buffers, freed once their frame comes around again
+        std::array<std::vector<daxa::BufferId>, CULLED_RING_FRAMES> retired_culled_buffers = {};
+        std::vector<Occluder> occluder_candidates = {};
+        OcclusionBuffer occlusion_buffer = {};
+
+        void sort_entries(const glm::vec3& camera_position, ThreadPool* thread_pool);
+        void assign_visibility_slots();
+    };
+}
@@ -0,0 +1,51 @@
+#include <graphics/frustum.hpp>
+
+namespace Stellar {
+    auto Frustum::from_matrix(const glm::mat4& view_projection) -> Frustum {
+        auto row = [&](i32 i) -> glm::vec4 {
+            return { view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i] };
+        };
+
+        Frustum frustum;
+        frustum.planes[0] = row(3) + row(0);
+        frustum.planes[1] = row(3) - row(0);
+        frustum.planes[2] = row(3) + row(1);
+        frustum.planes[3] = row(3) - row(1);
+        frustum.planes[4] = row(2); // depth is [0, 1]
+        frustum.planes[5] = row(3) - row(2);
+
+        for(auto& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3{plane});
+        }
+
+        return frustum;
+    }
+
+    auto Frustum::intersects(const AABB& aabb) const -> bool {
+        glm::vec3 center = (aabb.max + aabb.min) * 0.5f;
+        glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+        for(auto& plane : planes) {
+            glm::vec3 normal = glm::vec3{plane};
+            if(glm::dot(normal, center) + plane.w < -glm::dot(glm::abs(normal), extent)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    auto transform_aabb(const AABB& aabb, const glm::mat4& matrix) -> AABB {
+        glm::vec3 center = (aabb.max + aabb.min) * 0.5f;
+        glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+        glm::vec3 world_center = glm::vec3{matrix * glm::vec4{center, 1.0f}};
+        glm::mat3 abs_matrix = glm::mat3{glm::abs(glm::vec3{matrix[0]}), glm::abs(glm::vec3{matrix[1]}), glm::abs(glm::vec3{matrix[2]})};
+        glm::vec3 world_extent = abs_matrix * extent;
+
+        return AABB {
+            .min = world_center - world_extent,
+            .max = world_center + world_extent
+        };
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <core/types.hpp>
+#include <physics/aabb.hpp>
+
+namespace Stellar {
+    struct Frustum {
+        // left, right, bottom, top, near, far; xyz is the inward facing normal
+        std::array<glm::vec4, 6> planes = {};
+
+        static auto from_matrix(const glm::mat4& view_projection) -> Frustum;
+
+        auto intersects(const AABB& aabb) const -> bool;
+    };
+
+    auto transform_aabb(const AABB& aabb, const glm::mat4& matrix) -> AABB;
+}
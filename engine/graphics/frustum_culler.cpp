@@ -0,0 +1,138 @@
+#include <graphics/frustum_culler.hpp>
+#include <graphics/occlusion_buffer.hpp>
+#include <utils/threadpool.hpp>
+#include <utils/cpu.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+namespace Stellar {
+    void FrustumCuller::clear() {
+        count = 0;
+        center_x.clear();
+        center_y.clear();
+        center_z.clear();
+        extent_x.clear();
+        extent_y.clear();
+        extent_z.clear();
+        ids.clear();
+    }
+
+    void FrustumCuller::add(const AABB& aabb, const glm::mat4& transform, u32 id) {
+        // grow a whole batch at a time, the padding lanes are never reported
+        if(count % BATCH_SIZE == 0) {
+            usize size = count + BATCH_SIZE;
+            center_x.resize(size);
+            center_y.resize(size);
+            center_z.resize(size);
+            extent_x.resize(size);
+            extent_y.resize(size);
+            extent_z.resize(size);
+            ids.resize(size);
+        }
+
+        AABB world_aabb = transform_aabb(aabb, transform);
+        glm::vec3 center = (world_aabb.max + world_aabb.min) * 0.5f;
+        glm::vec3 extent = (world_aabb.max - world_aabb.min) * 0.5f;
+
+        center_x[count] = center.x;
+        center_y[count] = center.y;
+        center_z[count] = center.z;
+        extent_x[count] = extent.x;
+        extent_y[count] = extent.y;
+        extent_z[count] = extent.z;
+        ids[count] = id;
+        count++;
+    }
+
+#if defined(STELLAR_AVX2)
+    STELLAR_TARGET_AVX2 static void cull_range_avx2(const FrustumCuller& culler, const Frustum& frustum, usize begin, usize end, u8* visibility) {
+        const __m256 zero = _mm256_setzero_ps();
+        for(usize i = begin; i < end; i += FrustumCuller::BATCH_SIZE) {
+            __m256 center_x = _mm256_loadu_ps(&culler.center_x[i]);
+            __m256 center_y = _mm256_loadu_ps(&culler.center_y[i]);
+            __m256 center_z = _mm256_loadu_ps(&culler.center_z[i]);
+            __m256 extent_x = _mm256_loadu_ps(&culler.extent_x[i]);
+            __m256 extent_y = _mm256_loadu_ps(&culler.extent_y[i]);
+            __m256 extent_z = _mm256_loadu_ps(&culler.extent_z[i]);
+
+            __m256 outside = zero;
+            for(auto& plane : frustum.planes) {
+                __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), center_x), _mm256_mul_ps(_mm256_set1_ps(plane.y), center_y)),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), center_z), _mm256_set1_ps(plane.w))
+                );
+                __m256 radius = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), extent_x), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), extent_y)),
+                    _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), extent_z)
+                );
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+            }
+
+            i32 mask = _mm256_movemask_ps(outside);
+            for(usize lane = 0; lane < FrustumCuller::BATCH_SIZE; lane++) {
+                visibility[i + lane] = static_cast<u8>(((mask >> lane) & 1) == 0);
+            }
+        }
+    }
+#endif
+
+    static void cull_range_scalar(const FrustumCuller& culler, const Frustum& frustum, usize begin, usize end, u8* visibility) {
+        for(usize i = begin; i < end; i++) {
+            bool inside = true;
+            for(auto& plane : frustum.planes) {
+                f32 distance = plane.x * culler.center_x[i] + plane.y * culler.center_y[i] + plane.z * culler.center_z[i] + plane.w;
+                f32 radius = std::abs(plane.x) * culler.extent_x[i] + std::abs(plane.y) * culler.extent_y[i] + std::abs(plane.z) * culler.extent_z[i];
+                inside = inside && distance + radius >= 0.0f;
+            }
+            visibility[i] = static_cast<u8>(inside);
+        }
+    }
+
+    static void cull_range(const FrustumCuller& culler, const Frustum& frustum, usize begin, usize end, u8* visibility) {
+#if defined(STELLAR_AVX2)
+        if(cpu_has_avx2()) {
+            cull_range_avx2(culler, frustum, begin, end, visibility);
+            return;
+        }
+#endif
+        cull_range_scalar(culler, frustum, begin, end, visibility);
+    }
+
+    auto FrustumCuller::cull(const Frustum& frustum, ThreadPool* thread_pool, const OcclusionBuffer* occlusion_buffer) -> const std::vector<u32>& {
+        visible.clear();
+        if(count == 0) { return visible; }
+
+        usize padded_count = center_x.size();
+        visibility.resize(padded_count);
+
+        if(thread_pool != nullptr && padded_count > TASK_SIZE) {
+            std::vector<std::future<void>> tasks = {};
+            for(usize begin = 0; begin < padded_count; begin += TASK_SIZE) {
+                usize end = std::min(begin + TASK_SIZE, padded_count);
+                tasks.push_back(thread_pool->submit([this, &frustum, begin, end] {
+                    cull_range(*this, frustum, begin, end, visibility.data());
+                }));
+            }
+
+            for(auto& task : tasks) { task.wait(); }
+        } else {
+            cull_range(*this, frustum, 0, padded_count, visibility.data());
+        }
+
+        for(u32 i = 0; i < count; i++) {
+            if(visibility[i] == 0) { continue; }
+
+            if(occlusion_buffer != nullptr) {
+                glm::vec3 center = { center_x[i], center_y[i], center_z[i] };
+                glm::vec3 extent = { extent_x[i], extent_y[i], extent_z[i] };
+                if(!occlusion_buffer->is_visible(AABB { .min = center - extent, .max = center + extent })) { continue; }
+            }
+
+            visible.push_back(ids[i]);
+        }
+
+        return visible;
+    }
+}
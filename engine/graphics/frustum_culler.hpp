@@ -0,0 +1,35 @@
+#pragma once
+
+#include <core/types.hpp>
+#include <graphics/frustum.hpp>
+
+namespace Stellar {
+    class ThreadPool;
+    struct OcclusionBuffer;
+
+    // world space bounds kept as a structure of arrays, padded to the batch size, so the planes
+    // can be tested against 8 boxes at a time; works without a device so it can run headless
+    struct FrustumCuller {
+        static constexpr u32 BATCH_SIZE = 8;
+        static constexpr u32 TASK_SIZE = 1024;
+
+        void clear();
+        void add(const AABB& aabb, const glm::mat4& transform, u32 id);
+
+        // returns the ids of every visible box in the order they were added, boxes that pass the
+        // frustum are also tested against the occlusion buffer when one is given
+        auto cull(const Frustum& frustum, ThreadPool* thread_pool = nullptr, const OcclusionBuffer* occlusion_buffer = nullptr) -> const std::vector<u32>&;
+
+        u32 count = 0;
+        std::vector<f32> center_x = {};
+        std::vector<f32> center_y = {};
+        std::vector<f32> center_z = {};
+        std::vector<f32> extent_x = {};
+        std::vector<f32> extent_y = {};
+        std::vector<f32> extent_z = {};
+        std::vector<u32> ids = {};
+
+        std::vector<u8> visibility = {};
+        std::vector<u32> visible = {};
+    };
+}
@@ -0,0 +1,171 @@
+#include <graphics/material_registry.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Stellar {
+    static auto same_sampler(const daxa::SamplerInfo& a, const daxa::SamplerInfo& b) -> bool {
+        return a.magnification_filter == b.magnification_filter &&
+            a.minification_filter == b.minification_filter &&
+            a.mipmap_filter == b.mipmap_filter &&
+            a.address_mode_u == b.address_mode_u &&
+            a.address_mode_v == b.address_mode_v &&
+            a.address_mode_w == b.address_mode_w &&
+            a.mip_lod_bias == b.mip_lod_bias &&
+            a.enable_anisotropy == b.enable_anisotropy &&
+            a.max_anisotropy == b.max_anisotropy &&
+            a.enable_compare == b.enable_compare &&
+            a.compare_op == b.compare_op &&
+            a.min_lod == b.min_lod &&
+            a.max_lod == b.max_lod &&
+            a.border_color == b.border_color &&
+            a.enable_unnormalized_coordinates == b.enable_unnormalized_coordinates;
+    }
+
+    static auto hash_material(const MaterialInfo& material) -> u64 {
+        u64 hash = 0xcbf29ce484222325ull;
+        const u8* bytes = reinterpret_cast<const u8*>(&material);
+        for(usize i = 0; i < sizeof(MaterialInfo); i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    MaterialRegistry::MaterialRegistry(daxa::Device _device) : device{_device} {}
+
+    MaterialRegistry::~MaterialRegistry() {
+        textures.clear();
+        for(auto& [info, sampler] : samplers) { device.destroy_sampler(sampler); }
+        if(!material_buffer.is_empty()) { device.destroy_buffer(material_buffer); }
+    }
+
+    auto MaterialRegistry::get_sampler(const daxa::SamplerInfo& info) -> daxa::SamplerId {
+        for(auto& [existing_info, sampler] : samplers) {
+            if(same_sampler(existing_info, info)) { return sampler; }
+        }
+
+        daxa::SamplerId sampler = device.create_sampler(info);
+        samplers.emplace_back(info, sampler);
+        return sampler;
+    }
+
+    auto MaterialRegistry::get_texture_sampler() -> daxa::SamplerId {
+        // max_lod past any mip count so one sampler covers every texture size
+        return get_sampler({
+            .magnification_filter = daxa::Filter::LINEAR,
+            .minification_filter = daxa::Filter::LINEAR,
+            .mipmap_filter = daxa::Filter::LINEAR,
+            .address_mode_u = daxa::SamplerAddressMode::REPEAT,
+            .address_mode_v = daxa::SamplerAddressMode::REPEAT,
+            .address_mode_w = daxa::SamplerAddressMode::REPEAT,
+            .mip_lod_bias = 0.0f,
+            .enable_anisotropy = true,
+            .max_anisotropy = 16.0f,
+            .enable_compare = false,
+            .compare_op = daxa::CompareOp::ALWAYS,
+            .min_lod = 0.0f,
+            .max_lod = 1000.0f,
+            .enable_unnormalized_coordinates = false,
+            .debug_name = "texture sampler",
+        });
+    }
+
+    auto MaterialRegistry::find_texture(const std::string& path) const -> std::optional<u32> {
+        if(auto it = texture_indices.find(path); it != texture_indices.end()) { return it->second; }
+        return std::nullopt;
+    }
+
+    auto MaterialRegistry::add_texture(std::unique_ptr<Texture> texture) -> u32 {
+        if(auto index = find_texture(texture->path)) { return *index; }
+
+        u32 index = static_cast<u32>(textures.size());
+        texture_indices[texture->path] = index;
+        textures.push_back(std::move(texture));
+        return index;
+    }
+
+    auto MaterialRegistry::get_texture(u32 index) const -> const Texture& {
+        return *textures[index];
+    }
+
+    auto MaterialRegistry::add_material(const MaterialInfo& material) -> u32 {
+        u64 hash = hash_material(material);
+        auto [begin, end] = material_indices.equal_range(hash);
+        for(auto it = begin; it != end; ++it) {
+            if(std::memcmp(&materials[it->second], &material, sizeof(MaterialInfo)) == 0) { return it->second; }
+        }
+
+        u32 index = static_cast<u32>(materials.size());
+        materials.push_back(material);
+        material_indices.emplace(hash, index);
+        return index;
+    }
+
+    void MaterialRegistry::upload() {
+        u32 count = static_cast<u32>(materials.size());
+        if(count == uploaded_material_count) { return; }
+
+        auto cmd_list = device.create_command_list({
+            .debug_name = "material upload cmd list",
+        });
+
+        // entries are only ever appended, so a grown table gets the old ones copied over on the gpu
+        u32 first = uploaded_material_count;
+        if(count > material_capacity) {
+            material_capacity = std::max(count, material_capacity * 2);
+            daxa::BufferId old_buffer = material_buffer;
+
+            material_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(MaterialInfo) * material_capacity),
+                .debug_name = "material buffer",
+            });
+
+            if(!old_buffer.is_empty()) {
+                cmd_list.copy_buffer_to_buffer({
+                    .src_buffer = old_buffer,
+                    .dst_buffer = material_buffer,
+                    .size = static_cast<u32>(sizeof(MaterialInfo) * uploaded_material_count),
+                });
+                cmd_list.destroy_buffer_deferred(old_buffer);
+            }
+        }
+
+        u32 upload_size = static_cast<u32>(sizeof(MaterialInfo) * (count - first));
+        daxa::BufferId staging_buffer = device.create_buffer({
+            .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+            .size = upload_size,
+            .debug_name = "material staging buffer",
+        });
+        cmd_list.destroy_buffer_deferred(staging_buffer);
+
+        std::memcpy(device.get_host_address_as<MaterialInfo>(staging_buffer), materials.data() + first, upload_size);
+
+        cmd_list.pipeline_barrier({
+            .awaited_pipeline_access = daxa::AccessConsts::HOST_WRITE,
+            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_READ,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = staging_buffer,
+            .dst_buffer = material_buffer,
+            .dst_offset = sizeof(MaterialInfo) * first,
+            .size = upload_size,
+        });
+
+        cmd_list.pipeline_barrier({
+            .awaited_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
+            .waiting_pipeline_access = daxa::AccessConsts::READ,
+        });
+        cmd_list.complete();
+        device.submit_commands({
+            .command_lists = {std::move(cmd_list)},
+        });
+
+        uploaded_material_count = count;
+    }
+
+    auto MaterialRegistry::get_material_buffer_address() const -> daxa::BufferDeviceAddress {
+        return material_buffer.is_empty() ? daxa::BufferDeviceAddress{} : device.get_device_address(material_buffer);
+    }
+}
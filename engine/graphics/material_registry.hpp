@@ -0,0 +1,51 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+
+#include <graphics/texture.hpp>
+#include "../../shaders/shared.inl"
+
+#include <optional>
+#include <unordered_map>
+
+namespace Stellar {
+    // every material and texture the renderer knows about in one place. a texture file is loaded once no matter how
+    // many models use it, identical materials get one entry, and draws refer to materials by their index into the
+    // global table, so models don't need a material buffer of their own and batches aren't split over one
+    struct MaterialRegistry {
+        explicit MaterialRegistry(daxa::Device _device);
+        ~MaterialRegistry();
+
+        // samplers with the same settings are created once, the whole engine only needs a handful
+        auto get_sampler(const daxa::SamplerInfo& info) -> daxa::SamplerId;
+        // trilinear, repeating and anisotropic, what every material texture and icon is sampled with
+        auto get_texture_sampler() -> daxa::SamplerId;
+
+        auto find_texture(const std::string& path) const -> std::optional<u32>;
+        auto add_texture(std::unique_ptr<Texture> texture) -> u32;
+        auto get_texture(u32 index) const -> const Texture&;
+
+        // index of the material in the global table, an identical one that's already there is reused
+        auto add_material(const MaterialInfo& material) -> u32;
+        // copies the materials added since the last call to the gpu
+        void upload();
+
+        auto get_material_buffer_address() const -> daxa::BufferDeviceAddress;
+
+        daxa::Device device;
+
+        std::vector<std::pair<daxa::SamplerInfo, daxa::SamplerId>> samplers = {};
+
+        std::vector<std::unique_ptr<Texture>> textures = {};
+        std::unordered_map<std::string, u32> texture_indices = {};
+
+        std::vector<MaterialInfo> materials = {};
+        // keyed by a hash of the material's bytes, collisions are told apart by comparing them
+        std::unordered_multimap<u64, u32> material_indices = {};
+        daxa::BufferId material_buffer = {};
+        u32 material_capacity = 0;
+        u32 uploaded_material_count = 0;
+    };
+}
@@ -2,6 +2,7 @@
 #include <assimp/texture.h>
 #include <functional>
 #include <graphics/model.hpp>
+#include <graphics/material_registry.hpp>
 
 #include <filesystem>
 #include <stdexcept>
@@ -15,7 +16,7 @@
 #include <utils/threadpool.hpp>
 
 namespace Stellar {
-    Model::Model(daxa::Device _device, const std::string_view& file_path) : device{_device} {
+    Model::Model(daxa::Device _device, const std::string_view& file_path, MaterialRegistry& material_registry) : device{_device} {
         if(!std::filesystem::exists(file_path)) {
             throw std::runtime_error("couldn't find a model");
         }
@@ -31,19 +32,13 @@ namespace Stellar {
             throw std::runtime_error("Error importing file" + std::string{file_path} + importer.GetErrorString());
 		}
 
-        auto search_textures = [&](const std::string& path, daxa::Format format) -> u32 {
-            for(u32 i = 0; i < textures.size(); i++) {
-                if(textures[i]->path == path) {
-                    return i;
-                }
+        auto search_textures = [&](const std::string& path, daxa::Format) -> u32 {
+            if(auto index = material_registry.find_texture(path)) {
+                return *index;
             }
 
             throw std::runtime_error("ooops");
             return 0;
-            // Uncomment this when debugging some fuckery
-            /*std::unique_ptr<Texture> texture = std::make_unique<Texture>(device, path, format);
-            textures.push_back(std::move(texture));
-            return textures.size() - 1;*/
         };
 
         std::string format = std::string{file_path.substr(file_path.find_last_of(".") + 1)};
@@ -55,6 +50,8 @@ namespace Stellar {
 
         std::vector<TextureHelper> texture_helpers = {};
         auto vec_set = [&](const std::string& path, daxa::Format _format){
+            // files another model already loaded are shared
+            if(material_registry.find_texture(path)) { return; }
             for(auto& tex : texture_helpers) {
                 if(tex.path == path) { return; }
             }
@@ -170,7 +167,6 @@ namespace Stellar {
         }
 
 
-        textures.resize(texture_helpers.size());
         struct TextureHolder {
             std::unique_ptr<Texture> texture;
             daxa::CommandList cmd_list;
@@ -199,14 +195,21 @@ namespace Stellar {
                 .command_lists = {std::move(tex.cmd_list)},
             });
 
-            textures[tex.index] = std::move(tex.texture);
+            material_registry.add_texture(std::move(tex.texture));
         }
 
         device.wait_idle();
-        
+
+        daxa::SamplerId texture_sampler = material_registry.get_texture_sampler();
+
+        // global index of every material in this file
+        std::vector<u32> material_indices = {};
+        std::vector<u32> material_features = {};
         for(usize i = 0; i < scene->mNumMaterials; i++) {
             const aiMaterial* material = scene->mMaterials[i];
-            MaterialInfo my_material;
+            // zeroed so identical materials compare equal byte for byte in the registry
+            MaterialInfo my_material = {};
+            my_material.sampler = texture_sampler;
             my_material.has_albedo_texture = 0;
             my_material.has_metallic_texture = 0;
             my_material.has_roughness_texture = 0;
@@ -217,10 +220,7 @@ namespace Stellar {
 				std::string texture = std::filesystem::path{file_path}.parent_path().string() + "/" + diffuseTex.C_Str();
                 u32 index = search_textures(texture, daxa::Format::R8G8B8A8_SRGB);
                 
-                my_material.albedo_texture = {
-                    .texture_id = textures[index]->image_id.default_view(),
-                    .sampler_id = textures[index]->sampler_id
-                };
+                my_material.albedo_texture = material_registry.get_texture(index).image_id.default_view();
                 my_material.has_albedo_texture = 1;
 			}
 
@@ -253,10 +253,7 @@ namespace Stellar {
                 //std::cout << "aiTextureType_NORMALS: " << texture << std::endl;
                 u32 index = search_textures(texture, daxa::Format::R8G8B8A8_UNORM);
                 
-                my_material.normal_map_texture = {
-                    .texture_id = textures[index]->image_id.default_view(),
-                    .sampler_id = textures[index]->sampler_id
-                };
+                my_material.normal_map_texture = material_registry.get_texture(index).image_id.default_view();
                 my_material.has_normal_map_texture = 1;
 			}
 
@@ -312,10 +309,7 @@ namespace Stellar {
                 //std::cout << "aiTextureType_METALNESS: " << texture << std::endl;
                 u32 index = search_textures(texture, daxa::Format::R8G8B8A8_UNORM);
                 
-                my_material.metallic_texture = {
-                    .texture_id = textures[index]->image_id.default_view(),
-                    .sampler_id = textures[index]->sampler_id
-                };
+                my_material.metallic_texture = material_registry.get_texture(index).image_id.default_view();
                 my_material.has_metallic_texture = 1;
 			}
 
@@ -324,10 +318,7 @@ namespace Stellar {
                 //std::cout << "aiTextureType_DIFFUSE_ROUGHNESS: " << texture << std::endl;
                 u32 index = search_textures(texture, daxa::Format::R8G8B8A8_UNORM);
                 
-                my_material.roughness_texture = {
-                    .texture_id = textures[index]->image_id.default_view(),
-                    .sampler_id = textures[index]->sampler_id
-                };
+                my_material.roughness_texture = material_registry.get_texture(index).image_id.default_view();
                 my_material.has_roughness_texture = 1;
 
                 if (aiString metalnessTex{}; aiGetMaterialTexture(material, aiTextureType_METALNESS, 0, &metalnessTex) == AI_SUCCESS) {
@@ -364,7 +355,11 @@ namespace Stellar {
             //std::cout << "--------------------" << std::endl;
 
 
-            materials.push_back(my_material);
+            material_indices.push_back(material_registry.add_material(my_material));
+            material_features.push_back(
+                (my_material.has_albedo_texture != 0 ? MATERIAL_FEATURE_ALBEDO_TEXTURE : 0u) |
+                (my_material.has_normal_map_texture != 0 ? MATERIAL_FEATURE_NORMAL_MAP : 0u)
+            );
         }
 
         struct Vertex {
@@ -447,7 +442,8 @@ namespace Stellar {
                 .first_vertex = vertexOffset,
                 .index_count = indexCount,
                 .vertex_count = vertexCount,
-                .material_index = index,
+                .material_index = material_indices[index],
+                .material_features = material_features[index],
                 .aabb = aabb
             };
 
@@ -555,153 +551,16 @@ namespace Stellar {
             });
         }
 
-        material_info_buffer = device.create_buffer(daxa::BufferInfo{
-            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
-            .size = static_cast<u32>(sizeof(MaterialInfo) * materials.size()),
-            .debug_name = "",
-        });
-
-        daxa::BufferId staging_material_info_buffer = device.create_buffer(daxa::BufferInfo{
-            .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
-            .size = static_cast<u32>(sizeof(MaterialInfo) * materials.size()),
-            .debug_name = "",
-        });
-
-        auto cmd_list = device.create_command_list({
-            .debug_name = "",
-        });
-
-        cmd_list.destroy_buffer_deferred(staging_material_info_buffer);
-
-        auto* buffer_ptr = device.get_host_address_as<u32>(staging_material_info_buffer);
-        std::memcpy(buffer_ptr, materials.data(), sizeof(MaterialInfo) * materials.size());
+        // positions and indices stay on the cpu so primitives can be rasterized as occluders
+        cpu_positions.reserve(vertices.size());
+        for(auto& vertex : vertices) { cpu_positions.push_back(vertex.positions); }
+        cpu_indices = std::move(indices);
 
-        cmd_list.pipeline_barrier({
-            .awaited_pipeline_access = daxa::AccessConsts::HOST_WRITE,
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_READ,
-        });
-
-        cmd_list.copy_buffer_to_buffer({
-            .src_buffer = staging_material_info_buffer,
-            .dst_buffer = material_info_buffer,
-            .size = static_cast<u32>(sizeof(MaterialInfo) * materials.size()),
-        });
-
-        cmd_list.pipeline_barrier({
-            .awaited_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .waiting_pipeline_access = daxa::AccessConsts::VERTEX_SHADER_READ,
-        });
-        cmd_list.complete();
-        device.submit_commands({
-            .command_lists = {std::move(cmd_list)},
-        });
+        material_registry.upload();
     }
 
     Model::~Model() {
         device.destroy_buffer(face_buffer);
         device.destroy_buffer(index_buffer);
-        device.destroy_buffer(material_info_buffer);
-    }
-
-    void Model::draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push) {
-        draw_push.vertex_buffer = device.get_device_address(face_buffer);
-        for (auto & primitive : primitives) {
-            cmd_list.push_constant(draw_push);
-
-            if (primitive.index_count > 0) {
-                cmd_list.set_index_buffer(index_buffer, 0, 4);
-                cmd_list.draw_indexed({
-                    .index_count = primitive.index_count,
-                    .instance_count = 1,
-                    .first_index = primitive.first_index,
-                    .vertex_offset = static_cast<i32>(primitive.first_vertex),
-                    .first_instance = 0,
-                });
-            } else {
-                cmd_list.draw({
-                    .vertex_count = primitive.vertex_count,
-                    .instance_count = 1,
-                    .first_vertex = primitive.first_vertex,
-                    .first_instance = 0
-                });
-            }
-        }
-    }
-
-    void Model::draw(daxa::CommandList& cmd_list, DrawPush& draw_push) {
-        draw_push.material_buffer = device.get_device_address(material_info_buffer);
-        draw_push.vertex_buffer = device.get_device_address(face_buffer);
-        for (auto & primitive : primitives) {
-            draw_push.material_index = primitive.material_index;
-            cmd_list.push_constant(draw_push);
-
-            if (primitive.index_count > 0) {
-                cmd_list.set_index_buffer(index_buffer, 0, 4);
-                cmd_list.draw_indexed({
-                    .index_count = primitive.index_count,
-                    .instance_count = 1,
-                    .first_index = primitive.first_index,
-                    .vertex_offset = static_cast<i32>(primitive.first_vertex),
-                    .first_instance = 0,
-                });
-            } else {
-                cmd_list.draw({
-                    .vertex_count = primitive.vertex_count,
-                    .instance_count = 1,
-                    .first_vertex = primitive.first_vertex,
-                    .first_instance = 0
-                });
-            }
-        }
-    }
-
-    void Model::draw(daxa::CommandList& cmd_list, ShadowPush& draw_push) {
-        draw_push.vertex_buffer = device.get_device_address(face_buffer);
-        for (auto & primitive : primitives) {
-            cmd_list.push_constant(draw_push);
-
-            if (primitive.index_count > 0) {
-                cmd_list.set_index_buffer(index_buffer, 0, 4);
-                cmd_list.draw_indexed({
-                    .index_count = primitive.index_count,
-                    .instance_count = 1,
-                    .first_index = primitive.first_index,
-                    .vertex_offset = static_cast<i32>(primitive.first_vertex),
-                    .first_instance = 0,
-                });
-            } else {
-                cmd_list.draw({
-                    .vertex_count = primitive.vertex_count,
-                    .instance_count = 1,
-                    .first_vertex = primitive.first_vertex,
-                    .first_instance = 0
-                });
-            }
-        }
-    }
-
-    void Model::draw(daxa::CommandList& cmd_list, SkyPush& draw_push) {
-        draw_push.vertex_buffer = device.get_device_address(face_buffer);
-        for (auto & primitive : primitives) {
-            cmd_list.push_constant(draw_push);
-
-            if (primitive.index_count > 0) {
-                cmd_list.set_index_buffer(index_buffer, 0, 4);
-                cmd_list.draw_indexed({
-                    .index_count = primitive.index_count,
-                    .instance_count = 1,
-                    .first_index = primitive.first_index,
-                    .vertex_offset = static_cast<i32>(primitive.first_vertex),
-                    .first_instance = 0,
-                });
-            } else {
-                cmd_list.draw({
-                    .vertex_count = primitive.vertex_count,
-                    .instance_count = 1,
-                    .first_vertex = primitive.first_vertex,
-                    .first_instance = 0
-                });
-            }
-        }
     }
-}
\ No newline at end of file
+}
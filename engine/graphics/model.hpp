@@ -8,31 +8,31 @@
 #include <physics/aabb.hpp>
 
 namespace Stellar {
+    struct MaterialRegistry;
+
     struct Primitive {
         u32 first_index;
         u32 first_vertex;
         u32 index_count;
         u32 vertex_count;
+        // into the material registry's global table
         u32 material_index;
+        // MATERIAL_FEATURE bits of the material, which g-buffer permutation draws it
+        u32 material_features;
         AABB aabb;
     };
 
     struct Model {
-        Model(daxa::Device _device, const std::string_view& file_path);
+        Model(daxa::Device _device, const std::string_view& file_path, MaterialRegistry& material_registry);
         ~Model();
 
-        void draw(daxa::CommandList& cmd_list, DepthPrepassPush& draw_push);
-        void draw(daxa::CommandList& cmd_list, DrawPush& draw_push);
-        void draw(daxa::CommandList& cmd_list, ShadowPush& draw_push);
-        void draw(daxa::CommandList& cmd_list, SkyPush& draw_push);
-
         daxa::Device device;
         daxa::BufferId face_buffer = {};
         daxa::BufferId index_buffer = {};
-        daxa::BufferId material_info_buffer = {};
-        
-        std::vector<std::unique_ptr<Texture>> textures = {};
-        std::vector<MaterialInfo> materials = {};
+
         std::vector<Primitive> primitives = {};
+
+        std::vector<glm::vec3> cpu_positions = {};
+        std::vector<u32> cpu_indices = {};
     };
 }
\ No newline at end of file
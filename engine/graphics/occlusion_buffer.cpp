@@ -0,0 +1,223 @@
+#include <graphics/occlusion_buffer.hpp>
+#include <utils/threadpool.hpp>
+#include <utils/cpu.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+namespace Stellar {
+    static constexpr f32 MIN_W = 1e-4f;
+
+    OcclusionBuffer::OcclusionBuffer() {
+        depth.resize(WIDTH * HEIGHT, 1.0f);
+        tile_max_depth.resize(TILES_X * TILES_Y, 1.0f);
+    }
+
+    void OcclusionBuffer::begin(const glm::mat4& _view_projection) {
+        view_projection = _view_projection;
+        triangles.clear();
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        std::fill(tile_max_depth.begin(), tile_max_depth.end(), 1.0f);
+    }
+
+    static auto to_screen(const glm::vec4& clip) -> glm::vec3 {
+        glm::vec3 ndc = glm::vec3{clip} / clip.w;
+        return {
+            (ndc.x * 0.5f + 0.5f) * static_cast<f32>(OcclusionBuffer::WIDTH),
+            (ndc.y * 0.5f + 0.5f) * static_cast<f32>(OcclusionBuffer::HEIGHT),
+            ndc.z
+        };
+    }
+
+    void OcclusionBuffer::add_occluder(std::span<const glm::vec3> positions, std::span<const u32> indices, const glm::mat4& transform) {
+        glm::mat4 matrix = view_projection * transform;
+
+        for(usize i = 0; i + 2 < indices.size(); i += 3) {
+            glm::vec4 c0 = matrix * glm::vec4{positions[indices[i + 0]], 1.0f};
+            glm::vec4 c1 = matrix * glm::vec4{positions[indices[i + 1]], 1.0f};
+            glm::vec4 c2 = matrix * glm::vec4{positions[indices[i + 2]], 1.0f};
+
+            // dropping an occluder is always safe, so triangles touching the near plane are skipped instead of clipped
+            if(c0.w < MIN_W || c1.w < MIN_W || c2.w < MIN_W) { continue; }
+
+            Triangle triangle = { to_screen(c0), to_screen(c1), to_screen(c2) };
+            if(triangle.v0.z < 0.0f || triangle.v1.z < 0.0f || triangle.v2.z < 0.0f) { continue; }
+
+            f32 area = (triangle.v1.x - triangle.v0.x) * (triangle.v2.y - triangle.v0.y) - (triangle.v1.y - triangle.v0.y) * (triangle.v2.x - triangle.v0.x);
+            if(std::abs(area) < 1e-6f) { continue; }
+            if(area < 0.0f) { std::swap(triangle.v1, triangle.v2); }
+
+            triangles.push_back(triangle);
+        }
+    }
+
+    // edge function e(x, y) = a * x + b * y + c, positive on the inside of a counter clockwise triangle
+    struct Edge {
+        f32 a, b, c;
+
+        Edge(const glm::vec3& p0, const glm::vec3& p1) : a{p0.y - p1.y}, b{p1.x - p0.x}, c{-(a * p0.x + b * p0.y)} {}
+    };
+
+    // the three edges and the depth plane of a triangle, everything a row needs to be filled
+    struct TriangleSetup {
+        Edge e0, e1, e2;
+        f32 z_a, z_b, z_c;
+    };
+
+#if defined(STELLAR_AVX2)
+    STELLAR_TARGET_AVX2 static inline auto evaluate_avx2(f32 a, f32 b, f32 c, __m256 px, f32 py) -> __m256 {
+        return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a), px), _mm256_set1_ps(b * py + c));
+    }
+
+    STELLAR_TARGET_AVX2 static void rasterize_row_avx2(const TriangleSetup& setup, f32* row, i32 x_begin, i32 x_end, f32 py) {
+        const __m256 lane_offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for(i32 x = x_begin; x < x_end; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<f32>(x)), lane_offsets);
+
+            __m256 inside = _mm256_and_ps(
+                _mm256_and_ps(
+                    _mm256_cmp_ps(evaluate_avx2(setup.e0.a, setup.e0.b, setup.e0.c, px, py), zero, _CMP_GE_OQ),
+                    _mm256_cmp_ps(evaluate_avx2(setup.e1.a, setup.e1.b, setup.e1.c, px, py), zero, _CMP_GE_OQ)
+                ),
+                _mm256_cmp_ps(evaluate_avx2(setup.e2.a, setup.e2.b, setup.e2.c, px, py), zero, _CMP_GE_OQ)
+            );
+            if(_mm256_movemask_ps(inside) == 0) { continue; }
+
+            __m256 z = evaluate_avx2(setup.z_a, setup.z_b, setup.z_c, px, py);
+            __m256 current = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+        }
+    }
+#endif
+
+    static void rasterize_row_scalar(const TriangleSetup& setup, f32* row, i32 x_begin, i32 x_end, f32 py) {
+        const Edge& e0 = setup.e0;
+        const Edge& e1 = setup.e1;
+        const Edge& e2 = setup.e2;
+        for(i32 x = x_begin; x < x_end; x++) {
+            f32 px = static_cast<f32>(x) + 0.5f;
+            if(e0.a * px + e0.b * py + e0.c < 0.0f || e1.a * px + e1.b * py + e1.c < 0.0f || e2.a * px + e2.b * py + e2.c < 0.0f) { continue; }
+            row[x] = std::min(row[x], setup.z_a * px + setup.z_b * py + setup.z_c);
+        }
+    }
+
+    static void rasterize_band(OcclusionBuffer& buffer, u32 band_begin, u32 band_end) {
+#if defined(STELLAR_AVX2)
+        auto rasterize_row = cpu_has_avx2() ? rasterize_row_avx2 : rasterize_row_scalar;
+#else
+        auto rasterize_row = rasterize_row_scalar;
+#endif
+
+        for(auto& triangle : buffer.triangles) {
+            f32 min_x = std::min({triangle.v0.x, triangle.v1.x, triangle.v2.x});
+            f32 max_x = std::max({triangle.v0.x, triangle.v1.x, triangle.v2.x});
+            f32 min_y = std::min({triangle.v0.y, triangle.v1.y, triangle.v2.y});
+            f32 max_y = std::max({triangle.v0.y, triangle.v1.y, triangle.v2.y});
+
+            // rows are filled 8 pixels at a time, the width is a multiple of 8 so the last group stays in the row
+            i32 x_begin = std::max(static_cast<i32>(std::floor(min_x)), 0) & ~static_cast<i32>(7);
+            i32 x_end = std::min(static_cast<i32>(std::ceil(max_x)), static_cast<i32>(OcclusionBuffer::WIDTH));
+            i32 y_begin = std::max(static_cast<i32>(std::floor(min_y)), static_cast<i32>(band_begin));
+            i32 y_end = std::min(static_cast<i32>(std::ceil(max_y)), static_cast<i32>(band_end));
+            if(x_begin >= x_end || y_begin >= y_end) { continue; }
+
+            Edge e0 = { triangle.v1, triangle.v2 };
+            Edge e1 = { triangle.v2, triangle.v0 };
+            Edge e2 = { triangle.v0, triangle.v1 };
+
+            // depth as a plane over the screen, from the barycentric weights
+            f32 area = e2.a * triangle.v2.x + e2.b * triangle.v2.y + e2.c;
+            TriangleSetup setup = {
+                .e0 = e0,
+                .e1 = e1,
+                .e2 = e2,
+                .z_a = (e0.a * triangle.v0.z + e1.a * triangle.v1.z + e2.a * triangle.v2.z) / area,
+                .z_b = (e0.b * triangle.v0.z + e1.b * triangle.v1.z + e2.b * triangle.v2.z) / area,
+                .z_c = (e0.c * triangle.v0.z + e1.c * triangle.v1.z + e2.c * triangle.v2.z) / area,
+            };
+
+            for(i32 y = y_begin; y < y_end; y++) {
+                rasterize_row(setup, &buffer.depth[static_cast<usize>(y) * OcclusionBuffer::WIDTH], x_begin, x_end, static_cast<f32>(y) + 0.5f);
+            }
+        }
+
+        for(u32 tile_y = band_begin / OcclusionBuffer::TILE_SIZE; tile_y < band_end / OcclusionBuffer::TILE_SIZE; tile_y++) {
+            for(u32 tile_x = 0; tile_x < OcclusionBuffer::TILES_X; tile_x++) {
+                f32 max_depth = 0.0f;
+                for(u32 y = 0; y < OcclusionBuffer::TILE_SIZE; y++) {
+                    const f32* row = &buffer.depth[(tile_y * OcclusionBuffer::TILE_SIZE + y) * OcclusionBuffer::WIDTH + tile_x * OcclusionBuffer::TILE_SIZE];
+                    max_depth = std::max(max_depth, *std::max_element(row, row + OcclusionBuffer::TILE_SIZE));
+                }
+                buffer.tile_max_depth[tile_y * OcclusionBuffer::TILES_X + tile_x] = max_depth;
+            }
+        }
+    }
+
+    void OcclusionBuffer::rasterize(ThreadPool* thread_pool) {
+        if(thread_pool == nullptr) {
+            rasterize_band(*this, 0, HEIGHT);
+            return;
+        }
+
+        std::vector<std::future<void>> tasks = {};
+        for(u32 band = 0; band < HEIGHT; band += BAND_HEIGHT) {
+            tasks.push_back(thread_pool->submit([this, band] {
+                rasterize_band(*this, band, band + BAND_HEIGHT);
+            }));
+        }
+
+        for(auto& task : tasks) { task.wait(); }
+    }
+
+    auto OcclusionBuffer::is_visible(const AABB& world_aabb) const -> bool {
+        glm::vec2 screen_min = glm::vec2{std::numeric_limits<f32>::max()};
+        glm::vec2 screen_max = glm::vec2{std::numeric_limits<f32>::lowest()};
+        f32 min_z = 1.0f;
+
+        for(u32 i = 0; i < 8; i++) {
+            glm::vec3 corner = {
+                (i & 1) ? world_aabb.max.x : world_aabb.min.x,
+                (i & 2) ? world_aabb.max.y : world_aabb.min.y,
+                (i & 4) ? world_aabb.max.z : world_aabb.min.z
+            };
+
+            glm::vec4 clip = view_projection * glm::vec4{corner, 1.0f};
+            if(clip.w < MIN_W) { return true; }
+
+            glm::vec3 screen = to_screen(clip);
+            screen_min = glm::min(screen_min, glm::vec2{screen});
+            screen_max = glm::max(screen_max, glm::vec2{screen});
+            min_z = std::min(min_z, screen.z);
+        }
+
+        i32 x_begin = std::max(static_cast<i32>(std::floor(screen_min.x)), 0);
+        i32 x_end = std::min(static_cast<i32>(std::ceil(screen_max.x)), static_cast<i32>(WIDTH));
+        i32 y_begin = std::max(static_cast<i32>(std::floor(screen_min.y)), 0);
+        i32 y_end = std::min(static_cast<i32>(std::ceil(screen_max.y)), static_cast<i32>(HEIGHT));
+
+        // off screen boxes are left to the frustum test
+        if(x_begin >= x_end || y_begin >= y_end) { return true; }
+
+        for(i32 tile_y = y_begin / static_cast<i32>(TILE_SIZE); tile_y <= (y_end - 1) / static_cast<i32>(TILE_SIZE); tile_y++) {
+            for(i32 tile_x = x_begin / static_cast<i32>(TILE_SIZE); tile_x <= (x_end - 1) / static_cast<i32>(TILE_SIZE); tile_x++) {
+                if(min_z > tile_max_depth[static_cast<usize>(tile_y * static_cast<i32>(TILES_X) + tile_x)]) { continue; }
+
+                i32 tile_y_begin = std::max(tile_y * static_cast<i32>(TILE_SIZE), y_begin);
+                i32 tile_y_end = std::min((tile_y + 1) * static_cast<i32>(TILE_SIZE), y_end);
+                i32 tile_x_begin = std::max(tile_x * static_cast<i32>(TILE_SIZE), x_begin);
+                i32 tile_x_end = std::min((tile_x + 1) * static_cast<i32>(TILE_SIZE), x_end);
+
+                for(i32 y = tile_y_begin; y < tile_y_end; y++) {
+                    for(i32 x = tile_x_begin; x < tile_x_end; x++) {
+                        if(min_z <= depth[static_cast<usize>(y * static_cast<i32>(WIDTH) + x)]) { return true; }
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+}
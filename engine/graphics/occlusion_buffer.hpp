@@ -0,0 +1,42 @@
+#pragma once
+
+#include <core/types.hpp>
+#include <physics/aabb.hpp>
+
+#include <span>
+
+namespace Stellar {
+    class ThreadPool;
+
+    // low resolution software depth buffer for cpu occlusion culling, independent of the device so it runs headless; a handful of large occluders
+    // are rasterized into it in horizontal bands (one task per band) and bounding boxes are then
+    // tested against the per tile max depth before falling back to the individual pixels
+    struct OcclusionBuffer {
+        static constexpr u32 WIDTH = 256;
+        static constexpr u32 HEIGHT = 128;
+        static constexpr u32 TILE_SIZE = 8;
+        static constexpr u32 BAND_HEIGHT = 16;
+        static constexpr u32 TILES_X = WIDTH / TILE_SIZE;
+        static constexpr u32 TILES_Y = HEIGHT / TILE_SIZE;
+
+        OcclusionBuffer();
+
+        void begin(const glm::mat4& _view_projection);
+        void add_occluder(std::span<const glm::vec3> positions, std::span<const u32> indices, const glm::mat4& transform);
+        void rasterize(ThreadPool* thread_pool = nullptr);
+
+        auto is_visible(const AABB& world_aabb) const -> bool;
+
+        // screen space x, y in pixels, z in [0, 1] and the triangles are wound counter clockwise
+        struct Triangle {
+            glm::vec3 v0;
+            glm::vec3 v1;
+            glm::vec3 v2;
+        };
+
+        glm::mat4 view_projection = glm::mat4{1.0f};
+        std::vector<Triangle> triangles = {};
+        std::vector<f32> depth = {};
+        std::vector<f32> tile_max_depth = {};
+    };
+}
@@ -0,0 +1,443 @@
+#include <graphics/pipeline_cache.hpp>
+
+#include <core/logger.hpp>
+#include <utils/threadpool.hpp>
+
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <unordered_set>
+#include <variant>
+
+namespace Stellar {
+    static constexpr u64 FNV_OFFSET = 0xcbf29ce484222325ull;
+    static constexpr u64 FNV_PRIME = 0x100000001b3ull;
+
+    static void hash_bytes(u64& hash, const void* data, usize size) {
+        const u8* bytes = static_cast<const u8*>(data);
+        for(usize i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        }
+    }
+
+    static void hash_string(u64& hash, std::string_view string) {
+        hash_bytes(hash, string.data(), string.size());
+        // terminator so "ab" + "c" and "a" + "bc" differ
+        hash_bytes(hash, "", 1);
+    }
+
+    template<typename T>
+    static void hash_value(u64& hash, const T& value) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        hash_bytes(hash, &value, sizeof(T));
+    }
+
+    // every fixed function field the pipeline is created with, two descriptions that hash the same must be interchangeable
+    static void hash_raster_state(u64& hash, const daxa::RasterPipelineCompileInfo& compile_info) {
+        hash_value(hash, static_cast<u32>(compile_info.color_attachments.size()));
+        for(const auto& attachment : compile_info.color_attachments) {
+            const auto& blend = attachment.blend;
+            hash_value(hash, attachment.format);
+            hash_value(hash, blend.blend_enable);
+            hash_value(hash, blend.src_color_blend_factor);
+            hash_value(hash, blend.dst_color_blend_factor);
+            hash_value(hash, blend.color_blend_op);
+            hash_value(hash, blend.src_alpha_blend_factor);
+            hash_value(hash, blend.dst_alpha_blend_factor);
+            hash_value(hash, blend.alpha_blend_op);
+            hash_value(hash, blend.color_write_mask.data);
+        }
+
+        const auto& depth_test = compile_info.depth_test;
+        hash_value(hash, depth_test.depth_attachment_format);
+        hash_value(hash, depth_test.enable_depth_test);
+        hash_value(hash, depth_test.enable_depth_write);
+        hash_value(hash, depth_test.depth_test_compare_op);
+        hash_value(hash, depth_test.min_depth_bounds);
+        hash_value(hash, depth_test.max_depth_bounds);
+
+        const auto& raster = compile_info.raster;
+        hash_value(hash, raster.primitive_topology);
+        hash_value(hash, raster.primitive_restart_enable);
+        hash_value(hash, raster.polygon_mode);
+        hash_value(hash, raster.face_culling.data);
+        hash_value(hash, raster.front_face_winding);
+        hash_value(hash, raster.depth_clamp_enable);
+        hash_value(hash, raster.rasterizer_discard_enable);
+        hash_value(hash, raster.depth_bias_enable);
+        hash_value(hash, raster.depth_bias_constant_factor);
+        hash_value(hash, raster.depth_bias_clamp);
+        hash_value(hash, raster.depth_bias_slope_factor);
+        hash_value(hash, raster.line_width);
+
+        hash_value(hash, compile_info.push_constant_size);
+    }
+
+    static auto read_file(const std::filesystem::path& path) -> std::string {
+        std::ifstream file{path, std::ios::binary};
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    // name of an include directive on this line, and whether it was the quoted form
+    static auto parse_include(std::string_view line) -> std::optional<std::pair<std::string_view, bool>> {
+        usize start = line.find_first_not_of(" \t");
+        if(start == std::string_view::npos || line.substr(start, 8) != "#include") { return std::nullopt; }
+        usize open = line.find_first_of("\"<", start + 8);
+        if(open == std::string_view::npos) { return std::nullopt; }
+        usize close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if(close == std::string_view::npos) { return std::nullopt; }
+        return std::make_pair(line.substr(open + 1, close - open - 1), line[open] == '"');
+    }
+
+    // hashes a file and everything it includes, each file once, and keeps what was read by canonical path. doesn't
+    // evaluate the preprocessor so an include behind an #if still counts, that only costs a recompile nobody needed
+    static void hash_source(u64& hash, const PipelineCache& cache, const std::string& source, const std::filesystem::path& directory, std::unordered_map<std::string, std::string>& files) {
+        hash_string(hash, source);
+
+        std::string_view remaining = source;
+        while(!remaining.empty()) {
+            usize end = remaining.find('\n');
+            std::string_view line = remaining.substr(0, end);
+            remaining = end == std::string_view::npos ? std::string_view{} : remaining.substr(end + 1);
+
+            auto include = parse_include(line);
+            if(!include) { continue; }
+
+            std::filesystem::path path = cache.find_file(include->first, include->second ? directory : std::filesystem::path{});
+            if(path.empty()) {
+                // the compiler is going to complain about it, the key only has to be stable
+                hash_string(hash, include->first);
+                continue;
+            }
+
+            std::string canonical = std::filesystem::weakly_canonical(path).string();
+            if(files.contains(canonical)) { continue; }
+            // references into the map survive it growing
+            const std::string& contents = files[canonical] = read_file(path);
+            hash_source(hash, cache, contents, path.parent_path(), files);
+        }
+    }
+
+    // hands glslang the files as they were when the key was hashed, not as they are on disk by now
+    struct Includer : glslang::TShader::Includer {
+        explicit Includer(const PipelineCache& _cache, const std::unordered_map<std::string, std::string>& _files) : cache{_cache}, files{_files} {}
+
+        auto includeSystem(const char* header_name, const char*, size_t) -> IncludeResult* override {
+            return include(cache.find_file(header_name));
+        }
+
+        auto includeLocal(const char* header_name, const char* includer_name, size_t) -> IncludeResult* override {
+            return include(cache.find_file(header_name, std::filesystem::path{includer_name}.parent_path()));
+        }
+
+        void releaseInclude(IncludeResult* result) override {
+            delete result;
+        }
+
+        auto include(const std::filesystem::path& path) -> IncludeResult* {
+            if(path.empty()) { return nullptr; }
+            // the hashing found every file the compiler can, unless one appeared in between. that's a reload away
+            auto it = files.find(std::filesystem::weakly_canonical(path).string());
+            if(it == files.end()) { return nullptr; }
+            return new IncludeResult(path.string(), it->second.data(), it->second.size(), nullptr);
+        }
+
+        const PipelineCache& cache;
+        const std::unordered_map<std::string, std::string>& files;
+    };
+
+    void log_pipeline_error(const std::string& name, const std::exception& exception) {
+        CORE_ERROR("rebuilding {} failed, keeping the old pipeline\n{}", name, exception.what());
+    }
+
+    static u32 glslang_users = 0;
+
+    PipelineCache::PipelineCache(const Info& _info) : info{_info} {
+        if(glslang_users++ == 0) { glslang::InitializeProcess(); }
+        std::filesystem::create_directories(info.cache_path);
+        thread_pool = std::make_unique<ThreadPool>();
+    }
+
+    PipelineCache::~PipelineCache() {
+        // joins the workers, anything still compiling finishes before the pipelines and glslang go away
+        thread_pool.reset();
+        raster_pipelines.clear();
+        compute_pipelines.clear();
+        if(--glslang_users == 0) { glslang::FinalizeProcess(); }
+    }
+
+    auto PipelineCache::find_file(const std::filesystem::path& name, const std::filesystem::path& includer_directory) const -> std::filesystem::path {
+        if(!includer_directory.empty() && std::filesystem::exists(includer_directory / name)) {
+            return includer_directory / name;
+        }
+
+        for(const auto& root : info.root_paths) {
+            if(std::filesystem::exists(root / name)) {
+                return root / name;
+            }
+        }
+
+        return {};
+    }
+
+    void PipelineCache::hash_description(u64& hash, const daxa::ShaderCompileInfo& shader_info, ShaderStage stage) {
+        hash_value(hash, stage);
+        if(const auto* code = std::get_if<daxa::ShaderCode>(&shader_info.source)) {
+            hash_string(hash, code->string);
+        } else {
+            hash_string(hash, std::get<daxa::ShaderFile>(shader_info.source).path.string());
+        }
+        for(const auto& define : shader_info.compile_options.defines) {
+            hash_string(hash, define.name);
+            hash_string(hash, define.value);
+        }
+    }
+
+    auto PipelineCache::add_raster_pipeline(const daxa::RasterPipelineCompileInfo& compile_info) -> RasterPipelineHandle {
+        // keyed by what was asked for rather than the source, so the entry stays put when hot reload swaps the pipeline.
+        // debug name is left out on purpose, two systems asking for the same pipeline under different names still share it
+        u64 key = FNV_OFFSET;
+        hash_description(key, compile_info.vertex_shader_info, ShaderStage::Vertex);
+        hash_description(key, compile_info.fragment_shader_info, ShaderStage::Fragment);
+        hash_raster_state(key, compile_info);
+
+        if(auto it = raster_pipelines.find(key); it != raster_pipelines.end()) {
+            return it->second;
+        }
+
+        RasterPipelineHandle handle = { .state = std::make_shared<RasterPipelineHandle::State>() };
+        handle.state->name = compile_info.debug_name;
+        handle.state->rebuild = [this, compile_info, state = handle.state.get()] {
+            // source hashing stays on this thread, it's what records the files hot reload watches
+            std::vector<std::string> dependencies = {};
+            ShaderSource vertex_source = get_shader_source(compile_info.vertex_shader_info, ShaderStage::Vertex, dependencies);
+            ShaderSource fragment_source = get_shader_source(compile_info.fragment_shader_info, ShaderStage::Fragment, dependencies);
+
+            std::scoped_lock lock{state->mutex};
+            state->dependencies = std::move(dependencies);
+            state->pending = thread_pool->submit([this, compile_info, vertex_source, fragment_source] {
+                return create_raster_pipeline(compile_info, vertex_source, fragment_source);
+            });
+        };
+        handle.state->rebuild();
+
+        raster_pipelines[key] = handle;
+        return handle;
+    }
+
+    auto PipelineCache::add_compute_pipeline(const daxa::ComputePipelineCompileInfo& compile_info) -> ComputePipelineHandle {
+        u64 key = FNV_OFFSET;
+        hash_description(key, compile_info.shader_info, ShaderStage::Compute);
+        hash_value(key, compile_info.push_constant_size);
+
+        if(auto it = compute_pipelines.find(key); it != compute_pipelines.end()) {
+            return it->second;
+        }
+
+        ComputePipelineHandle handle = { .state = std::make_shared<ComputePipelineHandle::State>() };
+        handle.state->name = compile_info.debug_name;
+        handle.state->rebuild = [this, compile_info, state = handle.state.get()] {
+            std::vector<std::string> dependencies = {};
+            ShaderSource shader_source = get_shader_source(compile_info.shader_info, ShaderStage::Compute, dependencies);
+
+            std::scoped_lock lock{state->mutex};
+            state->dependencies = std::move(dependencies);
+            state->pending = thread_pool->submit([this, compile_info, shader_source] {
+                return create_compute_pipeline(compile_info, shader_source);
+            });
+        };
+        handle.state->rebuild();
+
+        compute_pipelines[key] = handle;
+        return handle;
+    }
+
+    void PipelineCache::reload() {
+        if(!enable_hot_reload) { return; }
+
+        auto now = std::chrono::steady_clock::now();
+        if(now - last_reload_check < reload_interval) { return; }
+        last_reload_check = now;
+
+        std::unordered_set<std::string> changed_files = {};
+        for(auto& [path, time] : file_times) {
+            std::error_code error;
+            auto write_time = std::filesystem::last_write_time(path, error);
+            if(!error && write_time != time) {
+                time = write_time;
+                changed_files.insert(path);
+            }
+        }
+        if(changed_files.empty()) { return; }
+
+        u32 rebuilt = 0;
+        auto rebuild_dependents = [&](auto& pipelines) {
+            for(auto& [key, handle] : pipelines) {
+                const auto& dependencies = handle.state->dependencies;
+                if(std::any_of(dependencies.begin(), dependencies.end(), [&](const std::string& file) { return changed_files.contains(file); })) {
+                    handle.state->rebuild();
+                    rebuilt++;
+                }
+            }
+        };
+        rebuild_dependents(raster_pipelines);
+        rebuild_dependents(compute_pipelines);
+
+        CORE_INFO("{} shader files changed, rebuilding {} pipelines", changed_files.size(), rebuilt);
+    }
+
+    auto PipelineCache::create_raster_pipeline(const daxa::RasterPipelineCompileInfo& compile_info, const ShaderSource& vertex_source, const ShaderSource& fragment_source) -> std::shared_ptr<daxa::RasterPipeline> {
+        std::vector<u32> vertex_spirv = get_spirv(compile_info.vertex_shader_info, ShaderStage::Vertex, vertex_source);
+        std::vector<u32> fragment_spirv = get_spirv(compile_info.fragment_shader_info, ShaderStage::Fragment, fragment_source);
+
+        return std::make_shared<daxa::RasterPipeline>(info.device.create_raster_pipeline({
+            .vertex_shader_info = {.binary = vertex_spirv},
+            .fragment_shader_info = {.binary = fragment_spirv},
+            .color_attachments = compile_info.color_attachments,
+            .depth_test = compile_info.depth_test,
+            .raster = compile_info.raster,
+            .push_constant_size = compile_info.push_constant_size,
+            .debug_name = compile_info.debug_name,
+        }));
+    }
+
+    auto PipelineCache::create_compute_pipeline(const daxa::ComputePipelineCompileInfo& compile_info, const ShaderSource& source) -> std::shared_ptr<daxa::ComputePipeline> {
+        std::vector<u32> spirv = get_spirv(compile_info.shader_info, ShaderStage::Compute, source);
+
+        return std::make_shared<daxa::ComputePipeline>(info.device.create_compute_pipeline({
+            .shader_info = {.binary = spirv},
+            .push_constant_size = compile_info.push_constant_size,
+            .debug_name = compile_info.debug_name,
+        }));
+    }
+
+    static auto get_source(const PipelineCache& cache, const daxa::ShaderCompileInfo& shader_info) -> std::pair<std::string, std::filesystem::path> {
+        if(const auto* code = std::get_if<daxa::ShaderCode>(&shader_info.source)) {
+            return { code->string, {} };
+        }
+
+        const auto& file = std::get<daxa::ShaderFile>(shader_info.source);
+        std::filesystem::path path = cache.find_file(file.path);
+        if(path.empty()) { throw std::runtime_error("couldn't find shader " + file.path.string()); }
+        return { read_file(path), path };
+    }
+
+    auto PipelineCache::get_shader_source(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, std::vector<std::string>& dependencies) -> ShaderSource {
+        auto [source, path] = get_source(*this, shader_info);
+
+        ShaderSource shader_source = {
+            .name = path.empty() ? std::string{"inline shader"} : path.string(),
+            .source = std::move(source),
+        };
+
+        u64& key = shader_source.key;
+        key = FNV_OFFSET;
+        hash_value(key, CACHE_VERSION);
+        hash_value(key, stage);
+        hash_value(key, info.enable_debug_info);
+        for(const auto& define : shader_info.compile_options.defines) {
+            hash_string(key, define.name);
+            hash_string(key, define.value);
+        }
+
+        if(!path.empty()) { shader_source.files[std::filesystem::weakly_canonical(path).string()] = shader_source.source; }
+        hash_source(key, *this, shader_source.source, path.parent_path(), shader_source.files);
+
+        for(const auto& [file, contents] : shader_source.files) {
+            std::error_code error;
+            auto write_time = std::filesystem::last_write_time(file, error);
+            if(!error) { file_times.try_emplace(file, write_time); }
+            dependencies.push_back(file);
+        }
+
+        return shader_source;
+    }
+
+    auto PipelineCache::get_spirv(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, const ShaderSource& source) -> std::vector<u32> {
+        std::filesystem::path binary_path = info.cache_path / fmt::format("{:016x}.spv", source.key);
+
+        if(std::ifstream file{binary_path, std::ios::binary | std::ios::ate}; file) {
+            usize size = static_cast<usize>(file.tellg());
+            if(size > 0 && size % sizeof(u32) == 0) {
+                std::vector<u32> spirv(size / sizeof(u32));
+                file.seekg(0);
+                file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(size));
+                if(file) {
+                    cached_shader_count++;
+                    return spirv;
+                }
+            }
+        }
+
+        std::vector<u32> spirv = compile(shader_info, stage, source);
+        compiled_shader_count++;
+
+        // written next to the final name and renamed so a crash mid write can't leave a truncated binary behind,
+        // per thread since two pipelines sharing a stage can compile it at the same time
+        std::filesystem::path temporary_path = binary_path;
+        temporary_path += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+            file.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(u32)));
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary_path, binary_path, error);
+        if(error) { CORE_WARN("couldn't write shader cache entry {}: {}", binary_path.string(), error.message()); }
+
+        return spirv;
+    }
+
+    auto PipelineCache::compile(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, const ShaderSource& source) const -> std::vector<u32> {
+        const std::string& name = source.name;
+
+        EShLanguage language = EShLangCompute;
+        switch(stage) {
+            case ShaderStage::Vertex: language = EShLangVertex; break;
+            case ShaderStage::Fragment: language = EShLangFragment; break;
+            case ShaderStage::Compute: language = EShLangCompute; break;
+        }
+
+        // same preamble daxa's pipeline manager gives glsl
+        std::string preamble = "#extension GL_GOOGLE_include_directive : require\n#define DAXA_SHADER 1\n#define DAXA_SHADERLANG 1\n";
+        for(const auto& define : shader_info.compile_options.defines) {
+            preamble += "#define " + define.name + " " + define.value + "\n";
+        }
+
+        glslang::TShader shader{language};
+        const char* source_string = source.source.c_str();
+        const char* source_name = name.c_str();
+        shader.setStringsWithLengthsAndNames(&source_string, nullptr, &source_name, 1);
+        shader.setPreamble(preamble.c_str());
+        shader.setEntryPoint("main");
+        shader.setEnvInput(glslang::EShSourceGlsl, language, glslang::EShClientVulkan, 100);
+        shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_3);
+        shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_6);
+
+        auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+        Includer includer{*this, source.files};
+        if(!shader.parse(GetDefaultResources(), 460, false, messages, includer)) {
+            throw std::runtime_error("failed to compile " + name + ":\n" + shader.getInfoLog());
+        }
+
+        glslang::TProgram program;
+        program.addShader(&shader);
+        if(!program.link(messages)) {
+            throw std::runtime_error("failed to link " + name + ":\n" + program.getInfoLog());
+        }
+
+        glslang::SpvOptions options;
+        options.generateDebugInfo = info.enable_debug_info;
+        options.disableOptimizer = info.enable_debug_info;
+
+        std::vector<u32> spirv = {};
+        glslang::GlslangToSpv(*program.getIntermediate(language), spirv, &options);
+        return spirv;
+    }
+}
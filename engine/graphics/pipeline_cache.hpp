@@ -0,0 +1,125 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <daxa/utils/pipeline_manager.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+namespace Stellar {
+    class ThreadPool;
+
+    void log_pipeline_error(const std::string& name, const std::exception& exception);
+
+    // a pipeline that may still be compiling on the cache's thread pool, the first dereference waits for it.
+    // hot reload builds the replacement in the background and swaps it in once it's done
+    template<typename T>
+    struct PipelineHandle {
+        struct State {
+            std::mutex mutex = {};
+            std::shared_ptr<T> pipeline = {};
+            std::future<std::shared_ptr<T>> pending = {};
+            // hashes the sources again and queues a new build, only called from the thread that owns the cache
+            std::function<void()> rebuild = {};
+            std::vector<std::string> dependencies = {};
+            std::string name = {};
+        };
+
+        auto get() const -> T& {
+            std::scoped_lock lock{state->mutex};
+            if(state->pending.valid() && (state->pipeline == nullptr || state->pending.wait_for(std::chrono::seconds{0}) == std::future_status::ready)) {
+                try {
+                    state->pipeline = state->pending.get();
+                } catch(const std::exception& exception) {
+                    // a broken edit keeps the old pipeline running, there's nothing to fall back to on the first build
+                    if(state->pipeline == nullptr) { throw; }
+                    log_pipeline_error(state->name, exception);
+                }
+            }
+            return *state->pipeline;
+        }
+
+        auto operator*() const -> T& { return get(); }
+        auto operator->() const -> T* { return &get(); }
+
+        std::shared_ptr<State> state = {};
+    };
+
+    using RasterPipelineHandle = PipelineHandle<daxa::RasterPipeline>;
+    using ComputePipelineHandle = PipelineHandle<daxa::ComputePipeline>;
+
+    // compiles glsl to spir-v once and keeps it on disk, keyed by a hash of the source with every include expanded,
+    // the defines and the stage, so a warm start creates all pipelines without running the compiler.
+    // pipelines with the same description are created once and handed out to everyone who asks for them
+    struct PipelineCache {
+        struct Info {
+            daxa::Device device;
+            std::vector<std::filesystem::path> root_paths = {};
+            std::filesystem::path cache_path = "shader_cache";
+            bool enable_debug_info = false;
+        };
+
+        explicit PipelineCache(const Info& _info);
+        ~PipelineCache();
+
+        // queued on the thread pool, returns right away
+        auto add_raster_pipeline(const daxa::RasterPipelineCompileInfo& compile_info) -> RasterPipelineHandle;
+        auto add_compute_pipeline(const daxa::ComputePipelineCompileInfo& compile_info) -> ComputePipelineHandle;
+
+        // rebuilds the pipelines that include a shader file which changed since it was last looked at,
+        // checks at most every reload_interval so it can be called each frame
+        void reload();
+
+        auto find_file(const std::filesystem::path& name, const std::filesystem::path& includer_directory = {}) const -> std::filesystem::path;
+
+        // bump when the compile options below change, old binaries are then never looked up again
+        static constexpr u64 CACHE_VERSION = 1;
+
+        Info info;
+        std::atomic<u32> compiled_shader_count = 0;
+        std::atomic<u32> cached_shader_count = 0;
+
+        bool enable_hot_reload = true;
+        std::chrono::milliseconds reload_interval = std::chrono::milliseconds{500};
+
+        std::unordered_map<u64, RasterPipelineHandle> raster_pipelines = {};
+        std::unordered_map<u64, ComputePipelineHandle> compute_pipelines = {};
+
+    private:
+        enum struct ShaderStage : u32 {
+            Vertex = 0,
+            Fragment = 1,
+            Compute = 2,
+        };
+
+        // a shader's key and the files it was hashed from. the compile runs on these instead of reading the files
+        // again, so an edit hot reload picks up in between can't be stored under the key of the old source
+        struct ShaderSource {
+            u64 key = 0;
+            std::string name = {};
+            std::string source = {};
+            // every file read while hashing by canonical path, includes as well as the shader itself
+            std::unordered_map<std::string, std::string> files = {};
+        };
+
+        static void hash_description(u64& hash, const daxa::ShaderCompileInfo& shader_info, ShaderStage stage);
+        auto get_shader_source(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, std::vector<std::string>& dependencies) -> ShaderSource;
+        auto get_spirv(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, const ShaderSource& source) -> std::vector<u32>;
+        auto compile(const daxa::ShaderCompileInfo& shader_info, ShaderStage stage, const ShaderSource& source) const -> std::vector<u32>;
+
+        auto create_raster_pipeline(const daxa::RasterPipelineCompileInfo& compile_info, const ShaderSource& vertex_source, const ShaderSource& fragment_source) -> std::shared_ptr<daxa::RasterPipeline>;
+        auto create_compute_pipeline(const daxa::ComputePipelineCompileInfo& compile_info, const ShaderSource& source) -> std::shared_ptr<daxa::ComputePipeline>;
+
+        std::unique_ptr<ThreadPool> thread_pool;
+        // last write time of every shader file a pipeline depends on
+        std::unordered_map<std::string, std::filesystem::file_time_type> file_times = {};
+        std::chrono::steady_clock::time_point last_reload_check = {};
+    };
+}
@@ -0,0 +1,98 @@
+#include <graphics/render_queue.hpp>
+#include <utils/threadpool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <future>
+
+namespace Stellar {
+    auto SortKey::make(RenderPass pass, u32 pipeline, u32 mesh, u32 depth_bucket, u32 material) -> u64 {
+        auto field = [](u32 value, u32 bits) -> u64 { return static_cast<u64>(value) & ((1ull << bits) - 1); };
+
+        u64 key = field(static_cast<u32>(pass), PASS_BITS);
+        key = (key << PIPELINE_BITS) | field(pipeline, PIPELINE_BITS);
+        key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+        key = (key << DEPTH_BITS) | field(depth_bucket, DEPTH_BITS);
+        key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+        return key;
+    }
+
+    auto SortKey::depth_bucket(f32 distance) -> u32 {
+        f32 bucket = std::sqrt(std::max(distance, 0.0f)) * 16.0f;
+        return static_cast<u32>(std::min(bucket, static_cast<f32>((1u << DEPTH_BITS) - 1)));
+    }
+
+    void RenderQueue::clear() {
+        packets.clear();
+    }
+
+    void RenderQueue::push(u64 key, u32 index) {
+        packets.push_back(Packet { .key = key, .index = index });
+    }
+
+    using Histogram = std::array<u32, RenderQueue::RADIX_SIZE>;
+
+    static auto digit(u64 key, u32 shift) -> u32 {
+        return static_cast<u32>(key >> shift) & (RenderQueue::RADIX_SIZE - 1);
+    }
+
+    void RenderQueue::sort(ThreadPool* thread_pool) {
+        usize count = packets.size();
+        if(count < 2) { return; }
+
+        scratch.resize(count);
+
+        usize task_count = (thread_pool != nullptr && count > TASK_SIZE) ? (count + TASK_SIZE - 1) / TASK_SIZE : 1;
+        usize chunk_size = (count + task_count - 1) / task_count;
+        std::vector<Histogram> histograms(task_count);
+
+        auto run = [&](auto&& fn) {
+            if(task_count == 1) {
+                fn(0);
+                return;
+            }
+
+            std::vector<std::future<void>> tasks = {};
+            for(usize task = 0; task < task_count; task++) {
+                tasks.push_back(thread_pool->submit([&fn, task] { fn(task); }));
+            }
+            for(auto& task : tasks) { task.wait(); }
+        };
+
+        for(u32 shift = 0; shift < 64; shift += RADIX_BITS) {
+            run([&](usize task) {
+                Histogram& histogram = histograms[task];
+                histogram.fill(0);
+
+                usize end = std::min((task + 1) * chunk_size, count);
+                for(usize i = task * chunk_size; i < end; i++) { histogram[digit(packets[i].key, shift)]++; }
+            });
+
+            // every key has the same digit here, the order wouldn't change
+            u32 first_digit = digit(packets[0].key, shift);
+            u32 first_digit_count = 0;
+            for(auto& histogram : histograms) { first_digit_count += histogram[first_digit]; }
+            if(first_digit_count == count) { continue; }
+
+            // turn the counts into where each chunk starts writing each digit, chunks in order keep the sort stable
+            u32 offset = 0;
+            for(u32 d = 0; d < RADIX_SIZE; d++) {
+                for(auto& histogram : histograms) {
+                    u32 digit_count = histogram[d];
+                    histogram[d] = offset;
+                    offset += digit_count;
+                }
+            }
+
+            run([&](usize task) {
+                Histogram& histogram = histograms[task];
+
+                usize end = std::min((task + 1) * chunk_size, count);
+                for(usize i = task * chunk_size; i < end; i++) { scratch[histogram[digit(packets[i].key, shift)]++] = packets[i]; }
+            });
+
+            packets.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <vector>
+
+namespace Stellar {
+    class ThreadPool;
+
+    enum struct RenderPass : u32 {
+        Opaque = 0,
+        Transparent = 1,
+    };
+
+    // packed most significant field first, so sorting the keys groups draws by pass, then pipeline, then mesh, orders
+    // each group of the same mesh by distance and only breaks ties by material. meshes are ranked front to back by the
+    // caller, so opaque draws stay roughly front to back inside a pipeline; materials are bindless and cost nothing to switch
+    struct SortKey {
+        static constexpr u32 PASS_BITS = 4;
+        static constexpr u32 PIPELINE_BITS = 8;
+        static constexpr u32 MESH_BITS = 20;
+        static constexpr u32 DEPTH_BITS = 16;
+        static constexpr u32 MATERIAL_BITS = 16;
+
+        static auto make(RenderPass pass, u32 pipeline, u32 mesh, u32 depth_bucket, u32 material) -> u64;
+        // finer close to the camera where the order matters, and coarse enough that a slowly moving camera
+        // doesn't reshuffle the queue every frame
+        static auto depth_bucket(f32 distance) -> u32;
+    };
+
+    // draw packets sorted by their key with a stable lsd radix sort, 8 bits a pass. passes where every key has
+    // the same digit are skipped, so the fields nothing varies in cost nothing
+    struct RenderQueue {
+        static constexpr u32 RADIX_BITS = 8;
+        static constexpr u32 RADIX_SIZE = 1 << RADIX_BITS;
+        static constexpr u32 TASK_SIZE = 4096;
+
+        struct Packet {
+            u64 key;
+            // whatever the queue's owner wants to get back in order
+            u32 index;
+        };
+
+        void clear();
+        void push(u64 key, u32 index);
+        // splits each pass over the thread pool once there's enough packets to be worth it
+        void sort(ThreadPool* thread_pool = nullptr);
+
+        std::vector<Packet> packets = {};
+        std::vector<Packet> scratch = {};
+    };
+}
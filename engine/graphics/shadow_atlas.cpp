@@ -0,0 +1,170 @@
+#include <graphics/shadow_atlas.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace Stellar {
+    static constexpr u32 CELLS_PER_SIDE = ShadowAtlas::SIZE / ShadowAtlas::MIN_TILE_SIZE;
+
+    static auto cell_count(u32 size) -> u32 {
+        u32 side = size / ShadowAtlas::MIN_TILE_SIZE;
+        return side * side;
+    }
+
+    // keeps the even bits of a z-order index, giving one of its coordinates
+    static auto compact_bits(u32 value) -> u32 {
+        value &= 0x55555555u;
+        value = (value ^ (value >> 1)) & 0x33333333u;
+        value = (value ^ (value >> 2)) & 0x0f0f0f0fu;
+        value = (value ^ (value >> 4)) & 0x00ff00ffu;
+        value = (value ^ (value >> 8)) & 0x0000ffffu;
+        return value;
+    }
+
+    // spreads the bits of a cell coordinate to the even bits of a z-order index
+    static auto expand_bits(u32 value) -> u32 {
+        value &= 0x0000ffffu;
+        value = (value | (value << 8)) & 0x00ff00ffu;
+        value = (value | (value << 4)) & 0x0f0f0f0fu;
+        value = (value | (value << 2)) & 0x33333333u;
+        value = (value | (value << 1)) & 0x55555555u;
+        return value;
+    }
+
+    static constexpr u32 TOTAL_CELLS = CELLS_PER_SIDE * CELLS_PER_SIDE;
+
+    // a tile aligned to its size covers a contiguous range of the z-order curve starting here
+    static auto first_cell(const ShadowAtlasTile& tile) -> u32 {
+        return expand_bits(tile.x / ShadowAtlas::MIN_TILE_SIZE) | (expand_bits(tile.y / ShadowAtlas::MIN_TILE_SIZE) << 1);
+    }
+
+    static auto tile_at(u32 cell, u32 size) -> ShadowAtlasTile {
+        return ShadowAtlasTile {
+            .x = compact_bits(cell) * ShadowAtlas::MIN_TILE_SIZE,
+            .y = compact_bits(cell >> 1) * ShadowAtlas::MIN_TILE_SIZE,
+            .size = size
+        };
+    }
+
+    static void mark(std::vector<u8>& cells, const ShadowAtlasTile& tile, u8 used) {
+        u32 first = first_cell(tile);
+        std::fill_n(cells.begin() + first, cell_count(tile.size), used);
+    }
+
+    // returns TOTAL_CELLS when no aligned range of the size is free
+    static auto find_free(const std::vector<u8>& cells, u32 size) -> u32 {
+        u32 count = cell_count(size);
+        for(u32 first = 0; first < TOTAL_CELLS; first += count) {
+            if(std::all_of(cells.begin() + first, cells.begin() + first + count, [](u8 used) { return used == 0; })) { return first; }
+        }
+        return TOTAL_CELLS;
+    }
+
+    static auto requested_size(const ShadowAtlasRequest& request) -> u32 {
+        return std::clamp(std::bit_floor(std::max(request.size, ShadowAtlas::MIN_TILE_SIZE)), ShadowAtlas::MIN_TILE_SIZE, ShadowAtlas::MAX_TILE_SIZE);
+    }
+
+    static void repack(std::span<ShadowAtlasRequest> requests) {
+        std::vector<ShadowAtlasRequest*> order = {};
+        order.reserve(requests.size());
+        for(auto& request : requests) { order.push_back(&request); }
+
+        std::stable_sort(order.begin(), order.end(), [](const ShadowAtlasRequest* a, const ShadowAtlasRequest* b) { return a->importance > b->importance; });
+
+        u32 used_cells = 0;
+        for(auto* request : order) {
+            request->tile = {};
+
+            u32 size = requested_size(*request);
+            while(size >= ShadowAtlas::MIN_TILE_SIZE && used_cells + cell_count(size) > TOTAL_CELLS) { size /= 2; }
+            if(size < ShadowAtlas::MIN_TILE_SIZE) { continue; }
+
+            request->tile.size = size;
+            used_cells += cell_count(size);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [](const ShadowAtlasRequest* a, const ShadowAtlasRequest* b) { return a->tile.size > b->tile.size; });
+
+        u32 cursor = 0;
+        for(auto* request : order) {
+            if(request->tile.size == 0) { continue; }
+
+            request->tile = tile_at(cursor, request->tile.size);
+            cursor += cell_count(request->tile.size);
+        }
+    }
+
+    void ShadowAtlas::allocate(std::span<ShadowAtlasRequest> requests) {
+        std::vector<u8> cells(TOTAL_CELLS, 0);
+
+        // shrinking tiles give up their space and are placed again inside what they freed, the rest stay put
+        for(auto& request : requests) {
+            if(request.tile.size > requested_size(request)) { request.tile = {}; }
+            if(request.tile.size != 0) { mark(cells, request.tile, 1); }
+        }
+
+        std::vector<ShadowAtlasRequest*> order = {};
+        order.reserve(requests.size());
+        for(auto& request : requests) { order.push_back(&request); }
+
+        std::stable_sort(order.begin(), order.end(), [](const ShadowAtlasRequest* a, const ShadowAtlasRequest* b) { return a->importance > b->importance; });
+
+        f32 least_placed_importance = std::numeric_limits<f32>::max();
+        for(auto* request : order) {
+            if(request->tile.size != 0) { least_placed_importance = std::min(least_placed_importance, request->importance); }
+        }
+
+        bool needs_repack = false;
+        for(auto* request : order) {
+            u32 size = requested_size(*request);
+            if(request->tile.size == size) { continue; }
+
+            if(request->tile.size != 0) {
+                // growing only moves the tile once the bigger one fits, until then it keeps the one it has
+                mark(cells, request->tile, 0);
+                u32 first = find_free(cells, size);
+                if(first != TOTAL_CELLS) { request->tile = tile_at(first, size); }
+                mark(cells, request->tile, 1);
+                continue;
+            }
+
+            u32 first = TOTAL_CELLS;
+            while(size >= MIN_TILE_SIZE && (first = find_free(cells, size)) == TOTAL_CELLS) { size /= 2; }
+            if(first != TOTAL_CELLS) {
+                request->tile = tile_at(first, size);
+                mark(cells, request->tile, 1);
+                continue;
+            }
+
+            // not even the smallest tile is free, only a repack that shrinks or drops less important lights makes room
+            if(request->importance > least_placed_importance * EVICT_HYSTERESIS) {
+                needs_repack = true;
+                break;
+            }
+        }
+
+        if(needs_repack) { repack(requests); }
+    }
+
+    auto ShadowAtlas::tile_size_for_coverage(f32 coverage, u32 current_size) -> u32 {
+        auto size_for = [](f32 value) -> u32 {
+            u32 size = static_cast<u32>(std::clamp(value, 0.0f, 1.0f) * static_cast<f32>(MAX_TILE_SIZE));
+            return std::clamp(std::bit_ceil(std::max(size, 1u)), MIN_TILE_SIZE, MAX_TILE_SIZE);
+        };
+
+        u32 size = size_for(coverage);
+        if(current_size != 0 && size < current_size && size_for(coverage * SHRINK_HYSTERESIS) >= current_size) { return current_size; }
+        return size;
+    }
+
+    auto ShadowAtlas::tile_rect(const ShadowAtlasTile& tile) -> glm::vec4 {
+        f32 inverse_size = 1.0f / static_cast<f32>(SIZE);
+        return glm::vec4{
+            static_cast<f32>(tile.x) * inverse_size,
+            static_cast<f32>(tile.y) * inverse_size,
+            static_cast<f32>(tile.size) * inverse_size,
+            static_cast<f32>(tile.size) * inverse_size
+        };
+    }
+}
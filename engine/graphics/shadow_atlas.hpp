@@ -0,0 +1,43 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <span>
+
+namespace Stellar {
+    struct ShadowAtlasTile {
+        u32 x = 0;
+        u32 y = 0;
+        u32 size = 0; // zero when the light got no space this frame
+
+        auto operator==(const ShadowAtlasTile& other) const -> bool = default;
+    };
+
+    struct ShadowAtlasRequest {
+        u32 size = 0;
+        f32 importance = 0.0f;
+        // the light's tile from last frame going in, the one it gets coming out
+        ShadowAtlasTile tile = {};
+    };
+
+    // places power of two tiles in one square atlas, each aligned to its size along a z-order curve. tiles whose size
+    // didn't change keep their place so their cached contents stay valid, only the lights that changed size or have
+    // no tile yet are placed in the free space. when one of those doesn't fit the whole atlas is repacked: sizes are
+    // granted in order of importance and halved until they fit, then placed largest first, which can't fragment
+    struct ShadowAtlas {
+        static constexpr u32 SIZE = 2048;
+        static constexpr u32 MIN_TILE_SIZE = 128;
+        static constexpr u32 MAX_TILE_SIZE = 1024;
+        // a tile only shrinks once the light would still fit the smaller size at this much more coverage
+        static constexpr f32 SHRINK_HYSTERESIS = 1.5f;
+        // a light left without a tile only evicts others through a repack once it's this much more important
+        static constexpr f32 EVICT_HYSTERESIS = 1.5f;
+
+        static void allocate(std::span<ShadowAtlasRequest> requests);
+
+        // coverage is the fraction of the screen height the light's bounds span, the current size is held until
+        // the coverage clearly calls for a smaller one
+        static auto tile_size_for_coverage(f32 coverage, u32 current_size = 0) -> u32;
+        static auto tile_rect(const ShadowAtlasTile& tile) -> glm::vec4;
+    };
+}
@@ -35,22 +35,6 @@ namespace Stellar {
             .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY
         });
 
-        sampler_id = device.create_sampler({
-            .magnification_filter = daxa::Filter::LINEAR,
-            .minification_filter = daxa::Filter::LINEAR,
-            .mipmap_filter = daxa::Filter::LINEAR,
-            .address_mode_u = daxa::SamplerAddressMode::REPEAT,
-            .address_mode_v = daxa::SamplerAddressMode::REPEAT,
-            .address_mode_w = daxa::SamplerAddressMode::REPEAT,
-            .mip_lod_bias = 0.0f,
-            .enable_anisotropy = true,
-            .max_anisotropy = 16.0f,
-            .enable_compare = false,
-            .compare_op = daxa::CompareOp::ALWAYS,
-            .min_lod = 0.0f,
-            .max_lod = static_cast<f32>(mip_levels),
-            .enable_unnormalized_coordinates = false,
-        });
 
         auto* staging_texture_buffer_ptr = device.get_host_address_as<u8>(staging_texture_buffer);
         std::memcpy(staging_texture_buffer_ptr, data, static_cast<u32>(size_x * size_y) * static_cast<u32>(4 * sizeof(u8)));
@@ -194,7 +178,6 @@ namespace Stellar {
 
     Texture::~Texture() {
         device.destroy_image(image_id);
-        device.destroy_sampler(sampler_id);
     }
 
     auto Texture::load(daxa::Device device, const std::string_view& _path, daxa::Format format) -> std::pair<std::unique_ptr<Texture>, daxa::CommandList> {
@@ -230,22 +213,6 @@ namespace Stellar {
             .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY
         });
 
-        texture->sampler_id = device.create_sampler({
-            .magnification_filter = daxa::Filter::LINEAR,
-            .minification_filter = daxa::Filter::LINEAR,
-            .mipmap_filter = daxa::Filter::LINEAR,
-            .address_mode_u = daxa::SamplerAddressMode::REPEAT,
-            .address_mode_v = daxa::SamplerAddressMode::REPEAT,
-            .address_mode_w = daxa::SamplerAddressMode::REPEAT,
-            .mip_lod_bias = 0.0f,
-            .enable_anisotropy = true,
-            .max_anisotropy = 16.0f,
-            .enable_compare = false,
-            .compare_op = daxa::CompareOp::ALWAYS,
-            .min_lod = 0.0f,
-            .max_lod = static_cast<f32>(mip_levels),
-            .enable_unnormalized_coordinates = false,
-        });
 
         daxa::ImageId image_id = texture->image_id;
 
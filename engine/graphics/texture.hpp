@@ -4,6 +4,7 @@
 using namespace daxa::types;
 
 namespace Stellar {
+    // an image with its mip chain, sampled with one of the shared samplers from the material registry
     struct Texture {
         Texture() = default;
         Texture(daxa::Device _device, const std::string_view& _path, daxa::Format format);
@@ -13,7 +14,6 @@ namespace Stellar {
 
         daxa::Device device;
         daxa::ImageId image_id;
-        daxa::SamplerId sampler_id;
         std::string path;
     };
 }
\ No newline at end of file
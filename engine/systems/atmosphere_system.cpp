@@ -0,0 +1,185 @@
+#include "atmosphere_system.hpp"
+
+#include "../../shaders/shared.inl"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Stellar {
+    AtmosphereSystem::AtmosphereSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        transmittance_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"TRANSMITTANCE_LUT"}}}},
+            .push_constant_size = sizeof(AtmospherePush),
+            .debug_name = "atmosphere_transmittance_pipeline",
+        });
+
+        multiple_scattering_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"MULTIPLE_SCATTERING_LUT"}}}},
+            .push_constant_size = sizeof(AtmospherePush),
+            .debug_name = "atmosphere_multiple_scattering_pipeline",
+        });
+
+        sky_view_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"SKY_VIEW_LUT"}}}},
+            .push_constant_size = sizeof(AtmospherePush),
+            .debug_name = "atmosphere_sky_view_pipeline",
+        });
+
+        // fullscreen triangle at the far plane, only pixels the g-buffer left at the cleared depth pass the test
+        sky_pipeline = pipeline_cache.add_raster_pipeline({
+            .vertex_shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
+            .fragment_shader_info = {.source = daxa::ShaderFile{"atmosphere.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
+            .color_attachments = {{ .format = daxa::Format::R8G8B8A8_SRGB }},
+            .depth_test = {
+                .depth_attachment_format = daxa::Format::D32_SFLOAT,
+                .enable_depth_test = true,
+                .enable_depth_write = false,
+                .depth_test_compare_op = daxa::CompareOp::LESS_OR_EQUAL,
+            },
+            .raster = {
+                .face_culling = daxa::FaceCullFlagBits::NONE
+            },
+            .push_constant_size = sizeof(AtmospherePush),
+            .debug_name = "atmosphere_sky_pipeline",
+        });
+
+        transmittance_lut = device.create_image({
+            .format = daxa::Format::R16G16B16A16_SFLOAT,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { TRANSMITTANCE_LUT_X, TRANSMITTANCE_LUT_Y, 1 },
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_WRITE | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .debug_name = "atmosphere_transmittance_lut"
+        });
+
+        multiple_scattering_lut = device.create_image({
+            .format = daxa::Format::R16G16B16A16_SFLOAT,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { MULTIPLE_SCATTERING_LUT_SIZE, MULTIPLE_SCATTERING_LUT_SIZE, 1 },
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_WRITE | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .debug_name = "atmosphere_multiple_scattering_lut"
+        });
+
+        sky_view_lut = device.create_image({
+            .format = daxa::Format::R16G16B16A16_SFLOAT,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { SKY_VIEW_LUT_X, SKY_VIEW_LUT_Y, 1 },
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_WRITE | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .debug_name = "atmosphere_sky_view_lut"
+        });
+
+        // the sky view lut wraps around in azimuth
+        lut_sampler = device.create_sampler({
+            .magnification_filter = daxa::Filter::LINEAR,
+            .minification_filter = daxa::Filter::LINEAR,
+            .mipmap_filter = daxa::Filter::LINEAR,
+            .address_mode_u = daxa::SamplerAddressMode::REPEAT,
+            .address_mode_v = daxa::SamplerAddressMode::CLAMP_TO_EDGE,
+            .address_mode_w = daxa::SamplerAddressMode::CLAMP_TO_EDGE,
+            .mip_lod_bias = 0.0f,
+            .enable_anisotropy = false,
+            .max_anisotropy = 0.0f,
+            .enable_compare = false,
+            .compare_op = daxa::CompareOp::ALWAYS,
+            .min_lod = 0.0f,
+            .max_lod = 0.0f,
+            .enable_unnormalized_coordinates = false,
+        });
+    }
+
+    AtmosphereSystem::~AtmosphereSystem() {
+        device.destroy_image(transmittance_lut);
+        device.destroy_image(multiple_scattering_lut);
+        device.destroy_image(sky_view_lut);
+        device.destroy_sampler(lut_sampler);
+    }
+
+    static auto atmosphere_push(const AtmosphereSystem& system, const AtmosphereSystem::RenderInfo& render_info) -> AtmospherePush {
+        glm::vec3 sun_direction = glm::normalize(render_info.sun_direction);
+        return AtmospherePush {
+            .transmittance_lut = system.transmittance_lut.default_view(),
+            .multiple_scattering_lut = system.multiple_scattering_lut.default_view(),
+            .sky_view_lut = system.sky_view_lut.default_view(),
+            .lut_sampler = system.lut_sampler,
+            .camera_info = render_info.camera_buffer_address,
+            .sun_direction = *reinterpret_cast<f32vec3*>(&sun_direction),
+            .camera_height = std::max(render_info.camera_position.y + AtmosphereSystem::GROUND_OFFSET, 1.0f),
+        };
+    }
+
+    void AtmosphereSystem::update(daxa::CommandList& cmd_list, const RenderInfo& render_info) {
+        glm::vec3 sun_direction = glm::normalize(render_info.sun_direction);
+        f32 camera_height = std::max(render_info.camera_position.y + GROUND_OFFSET, 1.0f);
+
+        // the sky view lut is stored relative to the sun azimuth, only its elevation and the altitude matter
+        bool sun_moved = std::abs(sun_direction.y - last_sun_direction.y) > sun_threshold;
+        bool height_moved = std::abs(camera_height - last_camera_height) > height_threshold;
+        if(luts_valid && sky_view_valid && !sun_moved && !height_moved) { return; }
+
+        AtmospherePush push = atmosphere_push(*this, render_info);
+
+        if(!luts_valid) {
+            cmd_list.pipeline_barrier_image_transition({
+                .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                .before_layout = daxa::ImageLayout::UNDEFINED,
+                .after_layout = daxa::ImageLayout::GENERAL,
+                .image_id = transmittance_lut
+            });
+
+            cmd_list.pipeline_barrier_image_transition({
+                .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                .before_layout = daxa::ImageLayout::UNDEFINED,
+                .after_layout = daxa::ImageLayout::GENERAL,
+                .image_id = multiple_scattering_lut
+            });
+
+            cmd_list.set_pipeline(*transmittance_pipeline);
+            push.dst = transmittance_lut.default_view();
+            push.dst_size = { TRANSMITTANCE_LUT_X, TRANSMITTANCE_LUT_Y };
+            cmd_list.push_constant(push);
+            cmd_list.dispatch((TRANSMITTANCE_LUT_X + 7) / 8, (TRANSMITTANCE_LUT_Y + 7) / 8);
+
+            cmd_list.pipeline_barrier({
+                .awaited_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_READ,
+            });
+
+            cmd_list.set_pipeline(*multiple_scattering_pipeline);
+            push.dst = multiple_scattering_lut.default_view();
+            push.dst_size = { MULTIPLE_SCATTERING_LUT_SIZE, MULTIPLE_SCATTERING_LUT_SIZE };
+            cmd_list.push_constant(push);
+            cmd_list.dispatch((MULTIPLE_SCATTERING_LUT_SIZE + 7) / 8, (MULTIPLE_SCATTERING_LUT_SIZE + 7) / 8);
+
+            cmd_list.pipeline_barrier({
+                .awaited_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_READ,
+            });
+
+            luts_valid = true;
+        }
+
+        cmd_list.set_pipeline(*sky_view_pipeline);
+        push.dst = sky_view_lut.default_view();
+        push.dst_size = { SKY_VIEW_LUT_X, SKY_VIEW_LUT_Y };
+        cmd_list.push_constant(push);
+        cmd_list.dispatch((SKY_VIEW_LUT_X + 7) / 8, (SKY_VIEW_LUT_Y + 7) / 8);
+
+        sky_view_valid = true;
+        last_sun_direction = sun_direction;
+        last_camera_height = camera_height;
+    }
+
+    void AtmosphereSystem::render(daxa::CommandList& cmd_list, const RenderInfo& render_info) {
+        cmd_list.set_pipeline(*sky_pipeline);
+        cmd_list.push_constant(atmosphere_push(*this, render_info));
+        cmd_list.draw({ .vertex_count = 3 });
+    }
+
+    void AtmosphereSystem::register_task_images(daxa::TaskList& task_list) {
+        // the transmittance and multiple scattering luts are written once and stay with their own barriers
+        task_sky_view_lut = task_list.create_task_image({ .debug_name = "task_sky_view_lut" });
+        task_list.add_runtime_image(task_sky_view_lut, sky_view_lut);
+
+        // a new task list starts every image from undefined
+        sky_view_valid = false;
+    }
+}
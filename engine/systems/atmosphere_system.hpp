@@ -0,0 +1,59 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+namespace Stellar {
+    // sky from precomputed scattering luts: transmittance and multiple scattering depend only on the planet and are
+    // built once, the sky view lut is rebuilt when the sun or the camera altitude moves and the sky pass only samples it
+    struct AtmosphereSystem {
+        struct RenderInfo {
+            daxa::BufferDeviceAddress camera_buffer_address;
+            glm::vec3 sun_direction;
+            glm::vec3 camera_position;
+        };
+
+        static constexpr u32 TRANSMITTANCE_LUT_X = 256;
+        static constexpr u32 TRANSMITTANCE_LUT_Y = 64;
+        static constexpr u32 MULTIPLE_SCATTERING_LUT_SIZE = 32;
+        static constexpr u32 SKY_VIEW_LUT_X = 192;
+        static constexpr u32 SKY_VIEW_LUT_Y = 108;
+
+        // the scene origin sits this high above the ground
+        static constexpr f32 GROUND_OFFSET = 1000.0f;
+
+        AtmosphereSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
+        ~AtmosphereSystem();
+
+        // computes the luts that went stale, has to be recorded outside a renderpass
+        void update(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+        // draws the sky behind everything in the bound renderpass
+        void render(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+        void register_task_images(daxa::TaskList& task_list);
+
+        ComputePipelineHandle transmittance_pipeline;
+        ComputePipelineHandle multiple_scattering_pipeline;
+        ComputePipelineHandle sky_view_pipeline;
+        RasterPipelineHandle sky_pipeline;
+
+        daxa::ImageId transmittance_lut;
+        daxa::ImageId multiple_scattering_lut;
+        daxa::ImageId sky_view_lut;
+        daxa::SamplerId lut_sampler;
+        daxa::TaskImageId task_sky_view_lut;
+
+        bool luts_valid = false;
+        bool sky_view_valid = false;
+        glm::vec3 last_sun_direction = { 0.0f, 0.0f, 0.0f };
+        f32 last_camera_height = 0.0f;
+
+        // sun elevation change in cosine and altitude change in meters that trigger a sky view rebuild
+        f32 sun_threshold = 0.0005f;
+        f32 height_threshold = 50.0f;
+
+        daxa::Device device;
+    };
+}
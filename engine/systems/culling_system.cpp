@@ -0,0 +1,296 @@
+#include "culling_system.hpp"
+
+#include "../../shaders/shared.inl"
+
+#include <graphics/frustum.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace Stellar {
+    CullingSystem::CullingSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        cull_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"cull.glsl"}},
+            .push_constant_size = sizeof(CullPush),
+            .debug_name = "cull_pipeline",
+        });
+
+        hiz_build_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"hiz_build.glsl"}},
+            .push_constant_size = sizeof(HiZPush),
+            .debug_name = "hiz_build_pipeline",
+        });
+
+        cull_info_buffer = device.create_buffer({
+            .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+            .size = sizeof(FrustumCullInfo),
+            .debug_name = "cull info buffer",
+        });
+
+        create_hiz();
+        // the task list needs real buffers to track from the start
+        grow_buffers(1, 1);
+    }
+
+    CullingSystem::~CullingSystem() {
+        device.destroy_buffer(cull_info_buffer);
+        if(!culled_command_buffer.is_empty()) { device.destroy_buffer(culled_command_buffer); }
+        if(!late_culled_command_buffer.is_empty()) { device.destroy_buffer(late_culled_command_buffer); }
+        if(!culled_instance_buffer.is_empty()) { device.destroy_buffer(culled_instance_buffer); }
+        if(!late_culled_instance_buffer.is_empty()) { device.destroy_buffer(late_culled_instance_buffer); }
+        if(!visibility_buffer.is_empty()) { device.destroy_buffer(visibility_buffer); }
+        destroy_hiz();
+    }
+
+    void CullingSystem::create_hiz() {
+        hiz_size_x = std::max(size_x / 2, 1u);
+        hiz_size_y = std::max(size_y / 2, 1u);
+        hiz_mip_count = static_cast<u32>(std::bit_width(std::max(hiz_size_x, hiz_size_y)));
+
+        hiz_image = device.create_image({
+            .format = daxa::Format::R32_SFLOAT,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { hiz_size_x, hiz_size_y, 1 },
+            .mip_level_count = hiz_mip_count,
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::SHADER_READ_WRITE,
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .debug_name = "hiz_image"
+        });
+
+        for(u32 mip = 0; mip < hiz_mip_count; mip++) {
+            hiz_mip_views.push_back(device.create_image_view({
+                .type = daxa::ImageViewType::REGULAR_2D,
+                .format = daxa::Format::R32_SFLOAT,
+                .image_id = hiz_image,
+                .slice = {.base_mip_level = mip, .level_count = 1},
+                .debug_name = "hiz_mip_view",
+            }));
+        }
+    }
+
+    void CullingSystem::destroy_hiz() {
+        for(auto& view : hiz_mip_views) { device.destroy_image_view(view); }
+        hiz_mip_views.clear();
+        device.destroy_image(hiz_image);
+    }
+
+    auto CullingSystem::grow_buffers(u32 commands, u32 instances) -> bool {
+        bool grown = false;
+
+        if(commands > command_capacity) {
+            command_capacity = commands;
+
+            if(!culled_command_buffer.is_empty()) { device.destroy_buffer(culled_command_buffer); }
+            culled_command_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * command_capacity),
+                .debug_name = "culled command buffer",
+            });
+
+            if(!late_culled_command_buffer.is_empty()) { device.destroy_buffer(late_culled_command_buffer); }
+            late_culled_command_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * command_capacity),
+                .debug_name = "late culled command buffer",
+            });
+
+            grown = true;
+        }
+
+        if(instances > instance_capacity) {
+            instance_capacity = instances;
+
+            if(!culled_instance_buffer.is_empty()) { device.destroy_buffer(culled_instance_buffer); }
+            culled_instance_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawInstance) * instance_capacity),
+                .debug_name = "culled instance buffer",
+            });
+
+            if(!late_culled_instance_buffer.is_empty()) { device.destroy_buffer(late_culled_instance_buffer); }
+            late_culled_instance_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawInstance) * instance_capacity),
+                .debug_name = "late culled instance buffer",
+            });
+
+            if(!visibility_buffer.is_empty()) { device.destroy_buffer(visibility_buffer); }
+            visibility_buffer = device.create_buffer({
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .size = static_cast<u32>(sizeof(DrawVisibility) * instance_capacity),
+                .debug_name = "visibility buffer",
+            });
+
+            visibility_valid = false;
+            grown = true;
+        }
+
+        return grown;
+    }
+
+    void CullingSystem::update(daxa::TaskList& task_list, DrawCommandBuilder* _draw_commands) {
+        draw_commands = _draw_commands;
+        command_count = static_cast<u32>(draw_commands->commands.size());
+        instance_count = static_cast<u32>(draw_commands->instances.size());
+
+        if(grow_buffers(draw_commands->command_capacity, draw_commands->instance_capacity)) {
+            task_list.clear_runtime_buffers(task_culled_command_buffer);
+            task_list.add_runtime_buffer(task_culled_command_buffer, culled_command_buffer);
+            task_list.clear_runtime_buffers(task_late_culled_command_buffer);
+            task_list.add_runtime_buffer(task_late_culled_command_buffer, late_culled_command_buffer);
+            task_list.clear_runtime_buffers(task_culled_instance_buffer);
+            task_list.add_runtime_buffer(task_culled_instance_buffer, culled_instance_buffer);
+            task_list.clear_runtime_buffers(task_late_culled_instance_buffer);
+            task_list.add_runtime_buffer(task_late_culled_instance_buffer, late_culled_instance_buffer);
+            task_list.clear_runtime_buffers(task_visibility_buffer);
+            task_list.add_runtime_buffer(task_visibility_buffer, visibility_buffer);
+        }
+
+        // the history is indexed by the builder's visibility slots, which follow the objects however the draws
+        // are sorted. it only has to be forgotten when the buffer is new or occlusion culling was off last frame
+        clear_visibility = occlusion_culling && !visibility_valid;
+        visibility_valid = occlusion_culling;
+    }
+
+    void CullingSystem::reset(daxa::CommandList& cmd_list) {
+        if(command_count == 0) { return; }
+
+        u32 commands_size = static_cast<u32>(sizeof(DrawIndexedIndirectCommand) * command_count);
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = draw_commands->empty_command_buffer,
+            .dst_buffer = culled_command_buffer,
+            .size = commands_size,
+        });
+
+        cmd_list.copy_buffer_to_buffer({
+            .src_buffer = draw_commands->empty_command_buffer,
+            .dst_buffer = late_culled_command_buffer,
+            .size = commands_size,
+        });
+
+        if(clear_visibility) {
+            cmd_list.clear_buffer({
+                .buffer = visibility_buffer,
+                .offset = 0,
+                .size = sizeof(DrawVisibility) * instance_capacity,
+                .clear_value = 0,
+            });
+        }
+    }
+
+    void CullingSystem::dispatch(daxa::CommandList& cmd_list, u32 phase, daxa::BufferId command_buffer, daxa::BufferId instance_buffer) {
+        cmd_list.set_pipeline(*cull_pipeline);
+        cmd_list.push_constant(CullPush {
+            .cull_info = device.get_device_address(cull_info_buffer),
+            .commands = device.get_device_address(draw_commands->command_buffer),
+            .draw_data = device.get_device_address(draw_commands->draw_data_buffer),
+            .culled_commands = device.get_device_address(command_buffer),
+            .culled_instances = device.get_device_address(instance_buffer),
+            .visibility = device.get_device_address(visibility_buffer),
+            .hiz = hiz_image.default_view(),
+            .phase = phase,
+        });
+        cmd_list.dispatch((instance_count + 63) / 64);
+    }
+
+    void CullingSystem::cull(daxa::CommandList& cmd_list, const CullInfo& cull_info) {
+        if(command_count == 0) { return; }
+
+        Frustum frustum = Frustum::from_matrix(cull_info.view_projection);
+        FrustumCullInfo info = {};
+        std::memcpy(&info.planes, frustum.planes.data(), sizeof(info.planes));
+        std::memcpy(&info.view_projection, &cull_info.view_projection, sizeof(info.view_projection));
+        // only the part of the pyramid built from this frame's render size is valid
+        info.render_size = { render_size_x, render_size_y };
+        info.hiz_size = { std::max(render_size_x / 2, 1u), std::max(render_size_y / 2, 1u) };
+        info.hiz_mip_count = hiz_mip_count;
+        info.instance_count = instance_count;
+
+        auto* buffer_ptr = device.get_host_address_as<FrustumCullInfo>(cull_info_buffer);
+        std::memcpy(buffer_ptr, &info, sizeof(FrustumCullInfo));
+
+        dispatch(cmd_list, occlusion_culling ? CULL_PHASE_EARLY : CULL_PHASE_FRUSTUM, culled_command_buffer, culled_instance_buffer);
+    }
+
+    void CullingSystem::build_hiz(daxa::CommandList& cmd_list, daxa::ImageId depth_image) {
+        // the task list puts depth and the pyramid in their layouts, only the mip to mip dependencies are ours
+        cmd_list.set_pipeline(*hiz_build_pipeline);
+
+        u32 src_x = render_size_x;
+        u32 src_y = render_size_y;
+        for(u32 mip = 0; mip < hiz_mip_count; mip++) {
+            u32 dst_x = std::max(std::max(render_size_x / 2, 1u) >> mip, 1u);
+            u32 dst_y = std::max(std::max(render_size_y / 2, 1u) >> mip, 1u);
+
+            cmd_list.push_constant(HiZPush {
+                .src = mip == 0 ? depth_image.default_view() : hiz_mip_views[mip - 1],
+                .dst = hiz_mip_views[mip],
+                .src_size = { src_x, src_y },
+                .dst_size = { dst_x, dst_y },
+            });
+            cmd_list.dispatch((dst_x + 15) / 16, (dst_y + 15) / 16);
+
+            cmd_list.pipeline_barrier({
+                .awaited_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_WRITE,
+                .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_READ,
+            });
+
+            src_x = dst_x;
+            src_y = dst_y;
+        }
+    }
+
+    void CullingSystem::cull_late(daxa::CommandList& cmd_list) {
+        if(command_count == 0) { return; }
+
+        dispatch(cmd_list, CULL_PHASE_LATE, late_culled_command_buffer, late_culled_instance_buffer);
+    }
+
+    auto CullingSystem::get_culled_draws() const -> CulledDraws {
+        return CulledDraws {
+            .command_buffer = culled_command_buffer,
+            .instance_buffer = culled_instance_buffer
+        };
+    }
+
+    auto CullingSystem::get_late_culled_draws() const -> CulledDraws {
+        return CulledDraws {
+            .command_buffer = late_culled_command_buffer,
+            .instance_buffer = late_culled_instance_buffer
+        };
+    }
+
+    void CullingSystem::resize(u32 sx, u32 sy) {
+        size_x = sx;
+        size_y = sy;
+        render_size_x = sx;
+        render_size_y = sy;
+
+        destroy_hiz();
+        create_hiz();
+    }
+
+    void CullingSystem::set_render_size(u32 sx, u32 sy) {
+        render_size_x = std::clamp(sx, 1u, size_x);
+        render_size_y = std::clamp(sy, 1u, size_y);
+    }
+
+    void CullingSystem::register_task_images(daxa::TaskList& task_list) {
+        task_hiz_image = task_list.create_task_image({ .debug_name = "task_hiz_image" });
+        task_list.add_runtime_image(task_hiz_image, hiz_image);
+    }
+
+    void CullingSystem::register_task_buffers(daxa::TaskList& task_list) {
+        task_culled_command_buffer = task_list.create_task_buffer({ .debug_name = "task_culled_command_buffer" });
+        task_list.add_runtime_buffer(task_culled_command_buffer, culled_command_buffer);
+        task_late_culled_command_buffer = task_list.create_task_buffer({ .debug_name = "task_late_culled_command_buffer" });
+        task_list.add_runtime_buffer(task_late_culled_command_buffer, late_culled_command_buffer);
+        task_culled_instance_buffer = task_list.create_task_buffer({ .debug_name = "task_culled_instance_buffer" });
+        task_list.add_runtime_buffer(task_culled_instance_buffer, culled_instance_buffer);
+        task_late_culled_instance_buffer = task_list.create_task_buffer({ .debug_name = "task_late_culled_instance_buffer" });
+        task_list.add_runtime_buffer(task_late_culled_instance_buffer, late_culled_instance_buffer);
+        task_visibility_buffer = task_list.create_task_buffer({ .debug_name = "task_visibility_buffer" });
+        task_list.add_runtime_buffer(task_visibility_buffer, visibility_buffer);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+#include <graphics/draw_commands.hpp>
+
+namespace Stellar {
+    // two phase occlusion culling: the early phase draws what was visible last frame,
+    // the late phase tests everything against a hi-z pyramid built from that depth.
+    // each instance is tested on its own and the visible ones are appended to their instanced command
+    struct CullingSystem {
+        struct CullInfo {
+            glm::mat4 view_projection;
+        };
+
+        CullingSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
+        ~CullingSystem();
+
+        // grows the buffers to the built draws before the task list runs, so the task list always tracks the live ones
+        void update(daxa::TaskList& task_list, DrawCommandBuilder* _draw_commands);
+        // empties both phases' commands and forgets stale visibility, everything in it is a transfer
+        void reset(daxa::CommandList& cmd_list);
+        void cull(daxa::CommandList& cmd_list, const CullInfo& cull_info);
+        void build_hiz(daxa::CommandList& cmd_list, daxa::ImageId depth_image);
+        void cull_late(daxa::CommandList& cmd_list);
+
+        auto get_culled_draws() const -> CulledDraws;
+        auto get_late_culled_draws() const -> CulledDraws;
+
+        void resize(u32 sx, u32 sy);
+        void set_render_size(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
+        void register_task_buffers(daxa::TaskList& task_list);
+
+        ComputePipelineHandle cull_pipeline;
+        ComputePipelineHandle hiz_build_pipeline;
+
+        daxa::BufferId cull_info_buffer;
+        daxa::BufferId culled_command_buffer;
+        daxa::BufferId late_culled_command_buffer;
+        daxa::BufferId culled_instance_buffer;
+        daxa::BufferId late_culled_instance_buffer;
+        daxa::BufferId visibility_buffer;
+        u32 command_capacity = 0;
+        u32 instance_capacity = 0;
+
+        daxa::ImageId hiz_image;
+        std::vector<daxa::ImageViewId> hiz_mip_views;
+        u32 hiz_size_x = 0;
+        u32 hiz_size_y = 0;
+        u32 hiz_mip_count = 0;
+        daxa::TaskImageId task_hiz_image;
+
+        daxa::TaskBufferId task_culled_command_buffer;
+        daxa::TaskBufferId task_late_culled_command_buffer;
+        daxa::TaskBufferId task_culled_instance_buffer;
+        daxa::TaskBufferId task_late_culled_instance_buffer;
+        daxa::TaskBufferId task_visibility_buffer;
+
+        DrawCommandBuilder* draw_commands = nullptr;
+        u32 command_count = 0;
+        u32 instance_count = 0;
+        bool visibility_valid = false;
+        bool clear_visibility = true;
+
+        bool occlusion_culling = true;
+
+        daxa::Device device;
+
+        u32 size_x = 1280;
+        u32 size_y = 720;
+        // region of the images rendered to this frame, at most size_x by size_y
+        u32 render_size_x = 1280;
+        u32 render_size_y = 720;
+
+        void create_hiz();
+        void destroy_hiz();
+        auto grow_buffers(u32 commands, u32 instances) -> bool;
+        void dispatch(daxa::CommandList& cmd_list, u32 phase, daxa::BufferId command_buffer, daxa::BufferId instance_buffer);
+    };
+}
@@ -6,10 +6,15 @@
 #include <data/scene.hpp>
 #include <data/components.hpp>
 #include <graphics/model.hpp>
+#include <graphics/draw_commands.hpp>
+#include <graphics/material_registry.hpp>
+#include <systems/culling_system.hpp>
+
+#include <algorithm>
 
 namespace Stellar {
-    DefferedRenderingSystem::DefferedRenderingSystem(daxa::Device& _device, daxa::PipelineManager pipeline_manager) : device{_device} {
-        depth_prepass_pipeline = pipeline_manager.add_raster_pipeline({
+    DefferedRenderingSystem::DefferedRenderingSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        depth_prepass_pipeline = pipeline_cache.add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"depth_prepass.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"depth_prepass.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .depth_test = {
@@ -22,28 +27,31 @@ namespace Stellar {
             },
             .push_constant_size = sizeof(DepthPrepassPush),
             .debug_name = "depth_prepass_pipeline",
-        }).value();
+        });
 
-        deffered_pipeline = pipeline_manager.add_raster_pipeline({
-            .vertex_shader_info = {.source = daxa::ShaderFile{"deffered.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
-            .fragment_shader_info = {.source = daxa::ShaderFile{"deffered.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
-            .color_attachments = {
-                { .format = daxa::Format::R8G8B8A8_SRGB },
-                { .format = daxa::Format::R16G16B16A16_SFLOAT }
-            },
-            .depth_test = {
-                .depth_attachment_format = daxa::Format::D32_SFLOAT,
-                .enable_depth_test = true,
-                .enable_depth_write = false,
-            },
-            .raster = {
-                .face_culling = daxa::FaceCullFlagBits::FRONT_BIT
-            },
-            .push_constant_size = sizeof(DrawPush),
-            .debug_name = "deffered_pipeline",
-        }).value();
+        for(u32 features = 0; features < MATERIAL_PERMUTATION_COUNT; features++) {
+            deffered_pipelines[features] = pipeline_cache.add_raster_pipeline({
+                .vertex_shader_info = {.source = daxa::ShaderFile{"deffered.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
+                .fragment_shader_info = {.source = daxa::ShaderFile{"deffered.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}, daxa::ShaderDefine{"MATERIAL_FEATURES", std::to_string(features)}}}},
+                .color_attachments = {
+                    { .format = daxa::Format::R8G8B8A8_SRGB },
+                    { .format = daxa::Format::R16G16_SNORM },
+                    { .format = daxa::Format::R16G16_SFLOAT }
+                },
+                .depth_test = {
+                    .depth_attachment_format = daxa::Format::D32_SFLOAT,
+                    .enable_depth_test = true,
+                    .enable_depth_write = false,
+                },
+                .raster = {
+                    .face_culling = daxa::FaceCullFlagBits::FRONT_BIT
+                },
+                .push_constant_size = sizeof(DrawPush),
+                .debug_name = "deffered_pipeline_" + std::to_string(features),
+            });
+        }
 
-        composition_pipeline = pipeline_manager.add_raster_pipeline({
+        composition_pipeline = pipeline_cache.add_raster_pipeline({
             .vertex_shader_info = {.source = daxa::ShaderFile{"composition.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
             .fragment_shader_info = {.source = daxa::ShaderFile{"composition.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
             .color_attachments = {
@@ -54,29 +62,21 @@ namespace Stellar {
             },
             .push_constant_size = sizeof(CompositionPush),
             .debug_name = "composition_pipeline",
-        }).value();
-        
-        albedo_image = device.create_image({
-            .format = daxa::Format::R8G8B8A8_SRGB,
-            .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
-            .debug_name = "albedo_image"
         });
-
-        normal_image = device.create_image({
-            .format = daxa::Format::R16G16B16A16_SFLOAT,
+        
+        velocity_image = device.create_image({
+            .format = daxa::Format::R16G16_SFLOAT,
             .aspect = daxa::ImageAspectFlagBits::COLOR,
             .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
-            .debug_name = "normal_image"
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .debug_name = "velocity_image"
         });
 
         render_image = device.create_image({
             .format = daxa::Format::R8G8B8A8_SRGB,
             .aspect = daxa::ImageAspectFlagBits::COLOR,
             .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_SRC | daxa::ImageUsageFlagBits::TRANSFER_DST,
             .debug_name = "render_image"
         });
 
@@ -84,110 +84,77 @@ namespace Stellar {
             .format = daxa::Format::D32_SFLOAT,
             .aspect = daxa::ImageAspectFlagBits::DEPTH,
             .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT,
+            .usage = daxa::ImageUsageFlagBits::DEPTH_STENCIL_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
             .debug_name = "depth_image"
         });
     }
 
     DefferedRenderingSystem::~DefferedRenderingSystem() {
-        device.destroy_image(albedo_image);
-        device.destroy_image(normal_image);
+        destroy_gbuffer_images();
+        device.destroy_image(velocity_image);
         device.destroy_image(render_image);
         device.destroy_image(depth_image);
     }
 
-    void DefferedRenderingSystem::render_gbuffer(daxa::CommandList &cmd_list, const DefferedRenderInfo& render_info) {
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .image_id = render_image
-        });
-
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::GENERAL,
-            .image_slice = {.image_aspect = daxa::ImageAspectFlagBits::DEPTH },
-            .image_id = depth_image,
-        });
-
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .image_id = albedo_image
-        });
-
-        cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .image_id = normal_image
-        });
+    void DefferedRenderingSystem::render_depth_prepass(daxa::CommandList &cmd_list, const DefferedRenderInfo& render_info, bool late) {
+        auto& culling_system = *render_info.culling_system;
 
         cmd_list.begin_renderpass({
             .depth_attachment = {{
                 .image_view = depth_image.default_view(),
-                .load_op = daxa::AttachmentLoadOp::CLEAR,
+                .load_op = late ? daxa::AttachmentLoadOp::LOAD : daxa::AttachmentLoadOp::CLEAR,
                 .clear_value = daxa::DepthValue{1.0f, 0},
             }},
-            .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
+            .render_area = {.x = 0, .y = 0, .width = render_size_x, .height = render_size_y},
         });
- 
+
         cmd_list.set_pipeline(*depth_prepass_pipeline);
 
-        render_info.scene->iterate([&](Entity entity){
-            if(entity.has_component<ModelComponent>()) {
-                auto& tc = entity.get_component<TransformComponent>();
-                auto& mc = entity.get_component<ModelComponent>();
-                if(!mc.model) { return; }
-
-                DepthPrepassPush draw_push;
-                draw_push.camera_info = render_info.camera_buffer_address;
-                draw_push.transform_buffer = device.get_device_address(tc.transform_buffer);
-                mc.model->draw(cmd_list, draw_push);
-            }
-        });
+        DepthPrepassPush depth_prepass_push;
+        depth_prepass_push.camera_info = render_info.camera_buffer_address;
+        render_info.scene->draw_commands->draw(cmd_list, depth_prepass_push, late ? culling_system.get_late_culled_draws() : culling_system.get_culled_draws());
 
         cmd_list.end_renderpass();
+    }
+
+    void DefferedRenderingSystem::render_gbuffer(daxa::CommandList &cmd_list, const DefferedRenderInfo& render_info) {
+        auto& culling_system = *render_info.culling_system;
 
         cmd_list.begin_renderpass({
             .color_attachments = {
                 {
-                    .image_view = this->albedo_image.default_view(),
+                    .image_view = render_info.albedo_image.default_view(),
                     .load_op = daxa::AttachmentLoadOp::CLEAR,
                     .clear_value = std::array<f32, 4>{0.05f, 0.05f, 0.05f, 1.0f},
                 },
                 {
-                    .image_view = this->normal_image.default_view(),
+                    .image_view = render_info.normal_image.default_view(),
                     .load_op = daxa::AttachmentLoadOp::CLEAR,
                     .clear_value = std::array<f32, 4>{0.0f, 0.0f, 0.0f, 1.0f},
                 },
+                {
+                    .image_view = this->velocity_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::CLEAR,
+                    .clear_value = std::array<f32, 4>{0.0f, 0.0f, 0.0f, 0.0f},
+                },
             },
             .depth_attachment = {{
                 .image_view = depth_image.default_view(),
                 .load_op = daxa::AttachmentLoadOp::LOAD,
                 .clear_value = daxa::DepthValue{1.0f, 0},
             }},
-            .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y},
+            .render_area = {.x = 0, .y = 0, .width = render_size_x, .height = render_size_y},
         });
  
-        cmd_list.set_pipeline(*deffered_pipeline);
-
-        render_info.scene->iterate([&](Entity entity){
-            if(entity.has_component<ModelComponent>()) {
-                auto& tc = entity.get_component<TransformComponent>();
-                auto& mc = entity.get_component<ModelComponent>();
-                if(!mc.model) { return; }
-
-                DrawPush draw_push;
-                draw_push.camera_info = render_info.camera_buffer_address;
-                draw_push.transform_buffer = device.get_device_address(tc.transform_buffer);
-                draw_push.light_buffer = device.get_device_address(render_info.scene->light_buffer);
-                mc.model->draw(cmd_list, draw_push);
-            }
-        });
+        // the draws bind the pipeline of each material permutation themselves
+        DrawPush draw_push;
+        draw_push.camera_info = render_info.camera_buffer_address;
+        draw_push.light_buffer = device.get_device_address(render_info.scene->light_buffer);
+        draw_push.material_buffer = render_info.scene->material_registry->get_material_buffer_address();
+        render_info.scene->draw_commands->draw(cmd_list, draw_push, culling_system.get_culled_draws(), deffered_pipelines);
+        if(culling_system.occlusion_culling) {
+            render_info.scene->draw_commands->draw(cmd_list, draw_push, culling_system.get_late_culled_draws(), deffered_pipelines);
+        }
 
         cmd_list.end_renderpass();
     }
@@ -201,18 +168,22 @@ namespace Stellar {
                     .clear_value = std::array<f32, 4>{0.05f, 0.05f, 0.05f, 1.0f},
                 },
             },
-            .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y },
+            .render_area = {.x = 0, .y = 0, .width = render_size_x, .height = render_size_y },
         });
 
         cmd_list.set_pipeline(*composition_pipeline);
         cmd_list.push_constant(CompositionPush {
-            .albedo = { .texture_id = albedo_image.default_view(), .sampler_id = render_info.sampler },
-            .normal = { .texture_id = normal_image.default_view(), .sampler_id = render_info.sampler },
+            .albedo = { .texture_id = render_info.albedo_image.default_view(), .sampler_id = render_info.sampler },
+            .normal = { .texture_id = render_info.normal_image.default_view(), .sampler_id = render_info.sampler },
             .depth = { .texture_id = depth_image.default_view(), .sampler_id = render_info.sampler },
             .ssao = { .texture_id = render_info.ssao_image.default_view(), .sampler_id = render_info.sampler },
             .light_buffer = device.get_device_address(render_info.scene->light_buffer),
             .camera_info = render_info.camera_buffer_address,
-            .ambient = render_info.ambient
+            .clusters = device.get_device_address(render_info.light_clusters),
+            .z_near = render_info.z_near,
+            .z_far = render_info.z_far,
+            .ambient = render_info.ambient,
+            .uv_scale = { static_cast<f32>(render_size_x) / static_cast<f32>(size_x), static_cast<f32>(render_size_y) / static_cast<f32>(size_y) },
         });
 
         cmd_list.draw({ .vertex_count = 3 });
@@ -222,25 +193,22 @@ namespace Stellar {
     void DefferedRenderingSystem::resize(u32 sx, u32 sy) {
         size_x = sx;
         size_y = sy;
+        render_size_x = sx;
+        render_size_y = sy;
 
-        device.destroy_image(albedo_image);
-        albedo_image = device.create_image({
-            .format = daxa::Format::R8G8B8A8_SRGB,
-            .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
-            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
-            .debug_name = "albedo_image"
-        });
+        if(keep_gbuffer) {
+            destroy_gbuffer_images();
+            create_gbuffer_images();
+        }
 
-        device.destroy_image(normal_image);
-        normal_image = device.create_image({
-            .format = daxa::Format::R16G16B16A16_SFLOAT,
+        device.destroy_image(velocity_image);
+        velocity_image = device.create_image({
+            .format = daxa::Format::R16G16_SFLOAT,
             .aspect = daxa::ImageAspectFlagBits::COLOR,
             .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
             .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
-            .debug_name = "normal_image"
+            .debug_name = "velocity_image"
         });
 
         device.destroy_image(render_image);
@@ -248,7 +216,7 @@ namespace Stellar {
             .format = daxa::Format::R8G8B8A8_SRGB,
             .aspect = daxa::ImageAspectFlagBits::COLOR,
             .size = { size_x, size_y, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_SRC | daxa::ImageUsageFlagBits::TRANSFER_DST,
             .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
             .debug_name = "render_image"
         });
@@ -263,4 +231,72 @@ namespace Stellar {
             .debug_name = "depth_image"
         });
     }
-}
\ No newline at end of file
+
+    void DefferedRenderingSystem::set_render_size(u32 sx, u32 sy) {
+        render_size_x = std::clamp(sx, 1u, size_x);
+        render_size_y = std::clamp(sy, 1u, size_y);
+    }
+
+    void DefferedRenderingSystem::create_gbuffer_images() {
+        albedo_image = device.create_image({
+            .format = daxa::Format::R8G8B8A8_SRGB,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { size_x, size_y, 1 },
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .debug_name = "albedo_image"
+        });
+
+        normal_image = device.create_image({
+            .format = daxa::Format::R16G16_SNORM,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { size_x, size_y, 1 },
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .debug_name = "normal_image"
+        });
+    }
+
+    void DefferedRenderingSystem::destroy_gbuffer_images() {
+        if(!albedo_image.is_empty()) { device.destroy_image(albedo_image); }
+        if(!normal_image.is_empty()) { device.destroy_image(normal_image); }
+        albedo_image = {};
+        normal_image = {};
+    }
+
+    void DefferedRenderingSystem::register_task_images(daxa::TaskList& task_list) {
+        if(keep_gbuffer) {
+            if(albedo_image.is_empty()) { create_gbuffer_images(); }
+
+            task_albedo_image = task_list.create_task_image({ .debug_name = "task_albedo_image" });
+            task_list.add_runtime_image(task_albedo_image, albedo_image);
+
+            task_normal_image = task_list.create_task_image({ .debug_name = "task_normal_image" });
+            task_list.add_runtime_image(task_normal_image, normal_image);
+        } else {
+            // only live from the g-buffer pass to composition, the task list can alias them with the other transients
+            destroy_gbuffer_images();
+
+            task_albedo_image = task_list.create_transient_image({
+                .format = daxa::Format::R8G8B8A8_SRGB,
+                .size = { size_x, size_y, 1 },
+                .debug_name = "task_albedo_image",
+            });
+
+            task_normal_image = task_list.create_transient_image({
+                .format = daxa::Format::R16G16_SNORM,
+                .size = { size_x, size_y, 1 },
+                .debug_name = "task_normal_image",
+            });
+        }
+
+        task_velocity_image = task_list.create_task_image({ .debug_name = "task_velocity_image" });
+        task_list.add_runtime_image(task_velocity_image, velocity_image);
+
+        task_render_image = task_list.create_task_image({ .debug_name = "task_render_image" });
+        task_list.add_runtime_image(task_render_image, render_image);
+
+        task_depth_image = task_list.create_task_image({ .debug_name = "task_depth_image" });
+        task_list.add_runtime_image(task_depth_image, depth_image);
+    }
+}
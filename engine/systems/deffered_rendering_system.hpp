@@ -3,45 +3,80 @@
 #include <core/types.hpp>
 
 #include <daxa/daxa.hpp>
-#include <daxa/utils/pipeline_manager.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+#include <graphics/draw_commands.hpp>
 
 namespace Stellar {
     struct Scene;
+    struct CullingSystem;
 
     struct DefferedRenderingSystem {
         struct DefferedRenderInfo {
             std::shared_ptr<Scene> scene;
             daxa::BufferDeviceAddress camera_buffer_address;
+            CullingSystem* culling_system;
+            // the g-buffer attachments as the task list resolved them, only needed by the g-buffer pass
+            daxa::ImageId albedo_image = {};
+            daxa::ImageId normal_image = {};
         };
 
         struct CompositionRenderInfo {
             std::shared_ptr<Scene> scene;
             daxa::SamplerId sampler;
             daxa::ImageId ssao_image;
+            daxa::ImageId albedo_image;
+            daxa::ImageId normal_image;
             daxa::BufferDeviceAddress camera_buffer_address;
+            daxa::BufferId light_clusters;
+            f32 z_near;
+            f32 z_far;
             f32 ambient;
         };
 
-        DefferedRenderingSystem(daxa::Device& _device, daxa::PipelineManager pipeline_manager);
+        DefferedRenderingSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
         ~DefferedRenderingSystem();
 
+        // layouts and barriers come from the uses the editor's task list declares for each of these
+        void render_depth_prepass(daxa::CommandList& cmd_list, const DefferedRenderInfo& render_info, bool late);
         void render_gbuffer(daxa::CommandList& cmd_list, const DefferedRenderInfo& render_info);
         void render_composition(daxa::CommandList& cmd_list, const CompositionRenderInfo& render_info);
 
         void resize(u32 sx, u32 sy);
+        void set_render_size(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
 
-        std::shared_ptr<daxa::RasterPipeline> depth_prepass_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> deffered_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> composition_pipeline;
+        RasterPipelineHandle depth_prepass_pipeline;
+        // one per material permutation, the pipeline cache shares the vertex shader between them
+        MaterialPipelines deffered_pipelines;
+        RasterPipelineHandle composition_pipeline;
 
-        daxa::ImageId albedo_image;
-        daxa::ImageId normal_image;
+        // only allocated while keep_gbuffer is set, the task list's transients stand in for them otherwise
+        daxa::ImageId albedo_image = {};
+        daxa::ImageId normal_image = {};
+        // uv space motion since last frame, written by whichever renderer ran, read by temporal upscaling
+        daxa::ImageId velocity_image;
         daxa::ImageId render_image;
         daxa::ImageId depth_image;
 
+        daxa::TaskImageId task_albedo_image;
+        daxa::TaskImageId task_normal_image;
+        daxa::TaskImageId task_velocity_image;
+        daxa::TaskImageId task_render_image;
+        daxa::TaskImageId task_depth_image;
+
         daxa::Device device;
 
         u32 size_x = 1280;
         u32 size_y = 720;
+        // region of the images rendered to this frame, at most size_x by size_y
+        u32 render_size_x = 1280;
+        u32 render_size_y = 720;
+        // set while the viewport shows the albedo or normal attachment, which then has to outlive the frame
+        bool keep_gbuffer = false;
+
+        void create_gbuffer_images();
+        void destroy_gbuffer_images();
     };
 }
\ No newline at end of file
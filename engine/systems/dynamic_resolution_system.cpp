@@ -0,0 +1,110 @@
+#include "dynamic_resolution_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Stellar {
+    DynamicResolutionSystem::DynamicResolutionSystem(daxa::Device& _device) : device{_device} {
+        timestamp_query_pool = device.create_timeline_query_pool({
+            .query_count = 2 * QUERY_FRAMES,
+            .debug_name = "frame timestamp query pool",
+        });
+
+        create_images();
+    }
+
+    DynamicResolutionSystem::~DynamicResolutionSystem() {
+        device.destroy_image(output_image);
+    }
+
+    void DynamicResolutionSystem::create_images() {
+        output_image = device.create_image({
+            .format = daxa::Format::R8G8B8A8_SRGB,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { size_x, size_y, 1 },
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .debug_name = "dynamic_resolution_output_image"
+        });
+    }
+
+    void DynamicResolutionSystem::update(u32 viewport_x, u32 viewport_y) {
+        u32 slot = static_cast<u32>(frame_index % QUERY_FRAMES);
+        if(frame_index >= QUERY_FRAMES) {
+            // value, availability pairs for the begin and end timestamp
+            std::vector<u64> results = timestamp_query_pool.get_query_results(slot * 2, 2);
+            if(results[1] != 0 && results[3] != 0) {
+                f32 ms = static_cast<f32>(results[2] - results[0]) * device.properties().limits.timestamp_period / 1000000.0f;
+                gpu_frame_time = gpu_frame_time == 0.0f ? ms : glm::mix(gpu_frame_time, ms, 0.1f);
+            }
+        }
+
+        if(!enabled) {
+            scale = max_scale;
+        } else if(gpu_frame_time > 0.0f && std::abs(gpu_frame_time - target_frame_time) > target_frame_time * deadband) {
+            // gpu time follows the pixel count, so the per axis scale goes with the square root of the ratio
+            f32 wanted = scale * std::sqrt(target_frame_time / gpu_frame_time);
+            scale = glm::mix(scale, wanted, 0.25f);
+        }
+        scale = std::clamp(scale, min_scale, max_scale);
+
+        // even sizes keep the half resolution passes aligned with the full resolution texels
+        render_size_x = std::clamp(static_cast<u32>(static_cast<f32>(viewport_x) * scale) & ~1u, 2u, size_x);
+        render_size_y = std::clamp(static_cast<u32>(static_cast<f32>(viewport_y) * scale) & ~1u, 2u, size_y);
+    }
+
+    void DynamicResolutionSystem::begin_frame(daxa::CommandList& cmd_list) {
+        u32 slot = static_cast<u32>(frame_index % QUERY_FRAMES);
+        cmd_list.reset_timestamps({
+            .query_pool = timestamp_query_pool,
+            .start_index = slot * 2,
+            .count = 2,
+        });
+
+        cmd_list.write_timestamp({
+            .query_pool = timestamp_query_pool,
+            .pipeline_stage = daxa::PipelineStageFlagBits::TOP_OF_PIPE,
+            .query_index = slot * 2,
+        });
+    }
+
+    void DynamicResolutionSystem::end_frame(daxa::CommandList& cmd_list) {
+        u32 slot = static_cast<u32>(frame_index % QUERY_FRAMES);
+        cmd_list.write_timestamp({
+            .query_pool = timestamp_query_pool,
+            .pipeline_stage = daxa::PipelineStageFlagBits::BOTTOM_OF_PIPE,
+            .query_index = slot * 2 + 1,
+        });
+
+        frame_index++;
+    }
+
+    void DynamicResolutionSystem::upscale(daxa::CommandList& cmd_list, daxa::ImageId render_image) {
+        cmd_list.blit_image_to_image({
+            .src_image = render_image,
+            .src_image_layout = daxa::ImageLayout::TRANSFER_SRC_OPTIMAL,
+            .dst_image = output_image,
+            .dst_image_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+            .src_slice = { .image_aspect = daxa::ImageAspectFlagBits::COLOR },
+            .src_offsets = {{{0, 0, 0}, {static_cast<i32>(render_size_x), static_cast<i32>(render_size_y), 1}}},
+            .dst_slice = { .image_aspect = daxa::ImageAspectFlagBits::COLOR },
+            .dst_offsets = {{{0, 0, 0}, {static_cast<i32>(size_x), static_cast<i32>(size_y), 1}}},
+            .filter = daxa::Filter::LINEAR,
+        });
+    }
+
+    void DynamicResolutionSystem::resize(u32 sx, u32 sy) {
+        size_x = sx;
+        size_y = sy;
+        render_size_x = std::min(render_size_x, size_x);
+        render_size_y = std::min(render_size_y, size_y);
+
+        device.destroy_image(output_image);
+        create_images();
+    }
+
+    void DynamicResolutionSystem::register_task_images(daxa::TaskList& task_list) {
+        task_output_image = task_list.create_task_image({ .debug_name = "task_dynamic_resolution_output_image" });
+        task_list.add_runtime_image(task_output_image, output_image);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <daxa/utils/task_list.hpp>
+
+namespace Stellar {
+    // picks the internal render resolution each frame from measured gpu frame time. the viewport sized targets
+    // are kept and only a smaller region of them is rendered, which is then stretched over the viewport
+    struct DynamicResolutionSystem {
+        // timestamps are read back this many frames late so the cpu never waits on them
+        static constexpr u32 QUERY_FRAMES = 4;
+
+        explicit DynamicResolutionSystem(daxa::Device& _device);
+        ~DynamicResolutionSystem();
+
+        // reads the oldest finished frame's gpu time and derives this frame's render size
+        void update(u32 viewport_x, u32 viewport_y);
+        // recorded by the first and the last task of the editor's task list, which also renders the shadows
+        void begin_frame(daxa::CommandList& cmd_list);
+        void end_frame(daxa::CommandList& cmd_list);
+        void upscale(daxa::CommandList& cmd_list, daxa::ImageId render_image);
+
+        void resize(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
+
+        daxa::TimelineQueryPool timestamp_query_pool;
+
+        // written by the blit or by temporal upscaling when that is enabled
+        daxa::ImageId output_image;
+        daxa::TaskImageId task_output_image;
+
+        bool enabled = true;
+        f32 target_frame_time = 16.6f;
+        f32 min_scale = 0.5f;
+        f32 max_scale = 1.0f;
+        // time outside target * (1 +- deadband) before the scale moves at all
+        f32 deadband = 0.05f;
+
+        f32 scale = 1.0f;
+        f32 gpu_frame_time = 0.0f;
+        u32 render_size_x = 1280;
+        u32 render_size_y = 720;
+
+        u64 frame_index = 0;
+
+        daxa::Device device;
+
+        u32 size_x = 1280;
+        u32 size_y = 720;
+
+        void create_images();
+    };
+}
@@ -0,0 +1,42 @@
+#include "light_cluster_system.hpp"
+
+#include "../../shaders/shared.inl"
+
+#include <data/scene.hpp>
+
+namespace Stellar {
+    LightClusterSystem::LightClusterSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        light_cluster_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"light_cluster.glsl"}},
+            .push_constant_size = sizeof(LightClusterPush),
+            .debug_name = "light_cluster_pipeline",
+        });
+
+        cluster_buffer = device.create_buffer({
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .size = static_cast<u32>(sizeof(LightCluster) * LIGHT_CLUSTER_COUNT),
+            .debug_name = "light cluster buffer",
+        });
+    }
+
+    LightClusterSystem::~LightClusterSystem() {
+        device.destroy_buffer(cluster_buffer);
+    }
+
+    void LightClusterSystem::build(daxa::CommandList& cmd_list, const BuildInfo& build_info) {
+        cmd_list.set_pipeline(*light_cluster_pipeline);
+        cmd_list.push_constant(LightClusterPush {
+            .light_buffer = device.get_device_address(build_info.scene->light_buffer),
+            .camera_info = build_info.camera_buffer_address,
+            .clusters = device.get_device_address(cluster_buffer),
+            .z_near = build_info.z_near,
+            .z_far = build_info.z_far,
+        });
+        cmd_list.dispatch((LIGHT_CLUSTER_COUNT + 63) / 64);
+    }
+
+    void LightClusterSystem::register_task_buffers(daxa::TaskList& task_list) {
+        task_cluster_buffer = task_list.create_task_buffer({ .debug_name = "task_light_cluster_buffer" });
+        task_list.add_runtime_buffer(task_cluster_buffer, cluster_buffer);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+namespace Stellar {
+    struct Scene;
+
+    // bins point and spot lights into a froxel grid every frame so composition only shades the lights
+    // whose influence radius reaches a pixel's cluster
+    struct LightClusterSystem {
+        struct BuildInfo {
+            std::shared_ptr<Scene> scene;
+            daxa::BufferDeviceAddress camera_buffer_address;
+            f32 z_near;
+            f32 z_far;
+        };
+
+        LightClusterSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
+        ~LightClusterSystem();
+
+        void build(daxa::CommandList& cmd_list, const BuildInfo& build_info);
+        void register_task_buffers(daxa::TaskList& task_list);
+
+        ComputePipelineHandle light_cluster_pipeline;
+
+        daxa::BufferId cluster_buffer;
+        daxa::TaskBufferId task_cluster_buffer;
+
+        daxa::Device device;
+    };
+}
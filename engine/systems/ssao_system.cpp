@@ -2,118 +2,229 @@
 
 #include "../../shaders/shared.inl"
 
+#include <graphics/blue_noise.hpp>
+
+#include <algorithm>
+#include <cstring>
+
 namespace Stellar {
-    SSAOSystem::SSAOSystem(daxa::Device& _device, daxa::PipelineManager pipeline_manager) : device{_device} {
-        this->ssao_generation_pipeline = pipeline_manager.add_raster_pipeline({
-            .vertex_shader_info = { .source = daxa::ShaderFile{"ssao_generation.glsl"}, .compile_options = { .defines = { daxa::ShaderDefine{"DRAW_VERT"}}}},
-            .fragment_shader_info = { .source = daxa::ShaderFile{"ssao_generation.glsl"}, .compile_options = { .defines = { daxa::ShaderDefine{"DRAW_FRAG"}}}},
-            .color_attachments = { { .format = daxa::Format::R8_UNORM, } },
-            .raster = { .polygon_mode = daxa::PolygonMode::FILL, },
+    static constexpr u32 BLUE_NOISE_SIZE = 64;
+
+    SSAOSystem::SSAOSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        this->ssao_generation_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"ssao_generation.glsl"}},
             .push_constant_size = sizeof(SSAOGenerationPush),
-            .debug_name = "ssao_generation_code",
-        }).value();
-
-        this->ssao_blur_pipeline = pipeline_manager.add_raster_pipeline({
-            .vertex_shader_info = { .source = daxa::ShaderFile{"ssao_blur.glsl"}, .compile_options = { .defines = { daxa::ShaderDefine{"DRAW_VERT"}}}},
-            .fragment_shader_info = { .source = daxa::ShaderFile{"ssao_blur.glsl"}, .compile_options = { .defines = { daxa::ShaderDefine{"DRAW_FRAG"}}}},
-            .color_attachments = { { .format = daxa::Format::R8_UNORM, } },
-            .raster = { .polygon_mode = daxa::PolygonMode::FILL, },
-            .push_constant_size = sizeof(SSAOBlurPush),
-            .debug_name = "ssao_blur_pipeline",
-        }).value();
-
-        this->ssao_image = device.create_image({
-            .format = daxa::Format::R8_UNORM,
-            .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x / 2, size_y / 2, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-            .debug_name = "ssao_image"
+            .debug_name = "ssao_generation_pipeline",
         });
 
-        this->ssao_blur_image = device.create_image({
+        this->ssao_visibility_generation_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"ssao_generation.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"VISIBILITY_BUFFER"}}}},
+            .push_constant_size = sizeof(SSAOGenerationPush),
+            .debug_name = "ssao_visibility_generation_pipeline",
+        });
+
+        this->ssao_temporal_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"ssao_temporal.glsl"}},
+            .push_constant_size = sizeof(SSAOTemporalPush),
+            .debug_name = "ssao_temporal_pipeline",
+        });
+
+        this->ssao_upsample_pipeline = pipeline_cache.add_compute_pipeline({
+            .shader_info = {.source = daxa::ShaderFile{"ssao_upsample.glsl"}},
+            .push_constant_size = sizeof(SSAOUpsamplePush),
+            .debug_name = "ssao_upsample_pipeline",
+        });
+
+        create_images();
+
+        std::vector<u8> blue_noise = generate_blue_noise(BLUE_NOISE_SIZE);
+
+        this->blue_noise_image = device.create_image({
             .format = daxa::Format::R8_UNORM,
             .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x / 2, size_y / 2, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-            .debug_name = "ssao_blur_image"
+            .size = { BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 1 },
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_ONLY | daxa::ImageUsageFlagBits::TRANSFER_DST,
+            .debug_name = "blue_noise_image"
         });
-    }
 
-    SSAOSystem::~SSAOSystem() {
-        device.destroy_image(ssao_image);
-        device.destroy_image(ssao_blur_image);
-    }
+        daxa::BufferId staging_buffer = device.create_buffer({
+            .memory_flags = daxa::MemoryFlagBits::HOST_ACCESS_RANDOM,
+            .size = static_cast<u32>(blue_noise.size()),
+            .debug_name = "blue noise staging buffer",
+        });
+        std::memcpy(device.get_host_address_as<u8>(staging_buffer), blue_noise.data(), blue_noise.size());
+
+        daxa::CommandList cmd_list = device.create_command_list({ .debug_name = "blue noise upload cmd list" });
 
-    void SSAOSystem::render(daxa::CommandList &cmd_list, const RenderInfo& render_info) {
         cmd_list.pipeline_barrier_image_transition({
             .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
             .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .image_id = ssao_image
+            .after_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+            .image_id = blue_noise_image,
+        });
+
+        cmd_list.copy_buffer_to_image({
+            .buffer = staging_buffer,
+            .image = blue_noise_image,
+            .image_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+            .image_slice = { .image_aspect = daxa::ImageAspectFlagBits::COLOR },
+            .image_extent = { BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, 1 }
         });
 
         cmd_list.pipeline_barrier_image_transition({
-            .waiting_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
-            .before_layout = daxa::ImageLayout::UNDEFINED,
-            .after_layout = daxa::ImageLayout::ATTACHMENT_OPTIMAL,
-            .image_id = ssao_blur_image
+            .awaited_pipeline_access = daxa::AccessConsts::TRANSFER_WRITE,
+            .waiting_pipeline_access = daxa::AccessConsts::COMPUTE_SHADER_READ,
+            .before_layout = daxa::ImageLayout::TRANSFER_DST_OPTIMAL,
+            .after_layout = daxa::ImageLayout::READ_ONLY_OPTIMAL,
+            .image_id = blue_noise_image,
+        });
+
+        cmd_list.destroy_buffer_deferred(staging_buffer);
+        cmd_list.complete();
+        device.submit_commands({
+            .command_lists = {std::move(cmd_list)},
         });
+    }
 
-        cmd_list.begin_renderpass({
-            .color_attachments = {{
-                    .image_view = this->ssao_image.default_view(),
-                    .load_op = daxa::AttachmentLoadOp::CLEAR,
-                    .clear_value = std::array<f32, 4>{1.0f, 0.0f, 0.0f, 1.0f},
-            }},
-            .render_area = {.x = 0, .y = 0, .width = size_x / 2, .height = size_y / 2},
+    SSAOSystem::~SSAOSystem() {
+        destroy_images();
+        device.destroy_image(blue_noise_image);
+    }
+
+    void SSAOSystem::create_images() {
+        this->ssao_blur_image = device.create_image({
+            .format = daxa::Format::R8_UNORM,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { size_x, size_y, 1 },
+            .usage = daxa::ImageUsageFlagBits::SHADER_READ_WRITE | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .debug_name = "ssao_blur_image"
         });
-        cmd_list.set_pipeline(*ssao_generation_pipeline);
+
+        for(auto& history_image : ssao_history_images) {
+            history_image = device.create_image({
+                .format = daxa::Format::R16G16_SFLOAT,
+                .aspect = daxa::ImageAspectFlagBits::COLOR,
+                .size = { std::max(size_x / 2, 1u), std::max(size_y / 2, 1u), 1 },
+                .usage = daxa::ImageUsageFlagBits::SHADER_READ_WRITE | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+                .debug_name = "ssao_history_image"
+            });
+        }
+
+        history_valid = false;
+    }
+
+    void SSAOSystem::destroy_images() {
+        device.destroy_image(ssao_blur_image);
+        for(auto& history_image : ssao_history_images) { device.destroy_image(history_image); }
+    }
+
+    void SSAOSystem::render_raw(daxa::CommandList &cmd_list, const RenderInfo& render_info) {
+        u32 half_x = std::max(render_size_x / 2, 1u);
+        u32 half_y = std::max(render_size_y / 2, 1u);
+
+        bool from_visibility = !render_info.visibility_image.is_empty();
+        cmd_list.set_pipeline(from_visibility ? *ssao_visibility_generation_pipeline : *ssao_generation_pipeline);
         cmd_list.push_constant(SSAOGenerationPush {
-            .normal = { .texture_id = render_info.normal_image.default_view(), .sampler_id = render_info.sampler },
-            .depth = { .texture_id = render_info.depth_image.default_view(), .sampler_id = render_info.sampler },
-            .camera_info = render_info.camera_buffer_address
+            .normal = render_info.normal_image.default_view(),
+            .depth = render_info.depth_image.default_view(),
+            .blue_noise = blue_noise_image.default_view(),
+            .ssao = render_info.ssao_image.default_view(),
+            .camera_info = render_info.camera_buffer_address,
+            .src_size = { render_size_x, render_size_y },
+            .dst_size = { half_x, half_y },
+            .sample_count = static_cast<u32>(quality),
+            .radius = radius,
+            .frame_index = temporal_accumulation ? frame_index : 0,
+            .visibility = from_visibility ? render_info.visibility_image.default_view() : render_info.normal_image.default_view(),
+            .draw_data_buffer = render_info.draw_data_buffer,
+            .material_buffer = render_info.material_buffer,
         });
-        cmd_list.draw({ .vertex_count = 3 });
-        cmd_list.end_renderpass();
-    // SSAO blur
-        cmd_list.begin_renderpass({
-            .color_attachments = {
-                {
-                    .image_view = this->ssao_blur_image.default_view(),
-                    .load_op = daxa::AttachmentLoadOp::CLEAR,
-                    .clear_value = std::array<f32, 4>{0.0f, 0.0f, 0.0f, 1.0f},
-                },
+        cmd_list.dispatch((half_x + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE, (half_y + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE);
+    }
+
+    void SSAOSystem::render_temporal(daxa::CommandList &cmd_list, const RenderInfo& render_info) {
+        u32 half_x = std::max(render_size_x / 2, 1u);
+        u32 half_y = std::max(render_size_y / 2, 1u);
+
+        daxa::ImageId history_image = ssao_history_images[frame_index % 2];
+        daxa::ImageId accumulated_image = ssao_history_images[(frame_index + 1) % 2];
+
+        cmd_list.set_pipeline(*ssao_temporal_pipeline);
+        cmd_list.push_constant(SSAOTemporalPush {
+            .ssao = render_info.ssao_image.default_view(),
+            .depth = render_info.depth_image.default_view(),
+            .history = { .texture_id = history_image.default_view(), .sampler_id = render_info.sampler },
+            .dst = accumulated_image.default_view(),
+            .camera_info = render_info.camera_buffer_address,
+            .previous_view_projection = *reinterpret_cast<const f32mat4x4*>(&previous_view_projection),
+            .src_size = { render_size_x, render_size_y },
+            .dst_size = { half_x, half_y },
+            .blend = temporal_blend,
+            .history_valid = (temporal_accumulation && history_valid) ? 1u : 0u,
+            .history_uv_scale = {
+                static_cast<f32>(previous_half_x) / static_cast<f32>(std::max(size_x / 2, 1u)),
+                static_cast<f32>(previous_half_y) / static_cast<f32>(std::max(size_y / 2, 1u))
             },
-            .render_area = {.x = 0, .y = 0, .width = size_x / 2, .height = size_y / 2},
         });
-        cmd_list.set_pipeline(*ssao_blur_pipeline);
-        cmd_list.push_constant(SSAOBlurPush {
-            .ssao = { .texture_id = ssao_image.default_view(), .sampler_id = render_info.sampler },
+        cmd_list.dispatch((half_x + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE, (half_y + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE);
+    }
+
+    void SSAOSystem::render_upsample(daxa::CommandList &cmd_list, const RenderInfo& render_info) {
+        u32 half_x = std::max(render_size_x / 2, 1u);
+        u32 half_y = std::max(render_size_y / 2, 1u);
+
+        daxa::ImageId accumulated_image = ssao_history_images[(frame_index + 1) % 2];
+
+        cmd_list.set_pipeline(*ssao_upsample_pipeline);
+        cmd_list.push_constant(SSAOUpsamplePush {
+            .ssao = accumulated_image.default_view(),
+            .depth = render_info.depth_image.default_view(),
+            .dst = ssao_blur_image.default_view(),
+            .camera_info = render_info.camera_buffer_address,
+            .src_size = { half_x, half_y },
+            .dst_size = { render_size_x, render_size_y },
         });
-        cmd_list.draw({ .vertex_count = 3 });
-        cmd_list.end_renderpass();
+        cmd_list.dispatch((render_size_x + 15) / 16, (render_size_y + 15) / 16);
+
+        previous_view_projection = render_info.view_projection;
+        previous_half_x = half_x;
+        previous_half_y = half_y;
+        history_valid = true;
+        frame_index++;
     }
 
     void SSAOSystem::resize(u32 sx, u32 sy) {
         size_x = sx;
         size_y = sy;
+        render_size_x = sx;
+        render_size_y = sy;
 
-        device.destroy_image(ssao_image);
-        this->ssao_image = device.create_image({
-            .format = daxa::Format::R8_UNORM,
-            .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x / 2, size_y / 2, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-            .debug_name = "ssao_image"
-        });
+        destroy_images();
+        create_images();
+    }
 
-        device.destroy_image(ssao_blur_image);
-        this->ssao_blur_image = device.create_image({
+    void SSAOSystem::set_render_size(u32 sx, u32 sy) {
+        render_size_x = std::clamp(sx, 1u, size_x);
+        render_size_y = std::clamp(sy, 1u, size_y);
+    }
+
+    void SSAOSystem::register_task_images(daxa::TaskList& task_list) {
+        // only lives between the raw and the temporal task, so the task list can alias its memory
+        task_ssao_image = task_list.create_transient_image({
             .format = daxa::Format::R8_UNORM,
-            .aspect = daxa::ImageAspectFlagBits::COLOR,
-            .size = { size_x / 2, size_y / 2, 1 },
-            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
-            .debug_name = "ssao_blur_image"
+            .size = { std::max(size_x / 2, 1u), std::max(size_y / 2, 1u), 1 },
+            .debug_name = "task_ssao_image",
         });
+
+        task_ssao_blur_image = task_list.create_task_image({ .debug_name = "task_ssao_blur_image" });
+        task_list.add_runtime_image(task_ssao_blur_image, ssao_blur_image);
+
+        for(usize i = 0; i < ssao_history_images.size(); i++) {
+            task_ssao_history_images[i] = task_list.create_task_image({ .debug_name = "task_ssao_history_image" });
+            task_list.add_runtime_image(task_ssao_history_images[i], ssao_history_images[i]);
+        }
+
+        // a new task list starts every image from undefined
+        history_valid = false;
     }
-}
\ No newline at end of file
+}
@@ -3,33 +3,81 @@
 #include <core/types.hpp>
 
 #include <daxa/daxa.hpp>
-#include <daxa/utils/pipeline_manager.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
 
 namespace Stellar {
+    // ambient occlusion at half resolution in compute, accumulated over frames with a reprojected history,
+    // then a depth aware upsample to full resolution
     struct SSAOSystem {
         struct RenderInfo {
             daxa::ImageId depth_image;
             daxa::ImageId normal_image;
+            // half resolution raw ao, transient in the task list so only set for the raw and temporal tasks
+            daxa::ImageId ssao_image = {};
             daxa::SamplerId sampler;
             daxa::BufferDeviceAddress camera_buffer_address;
+            glm::mat4 view_projection;
+            // set when the visibility buffer renderer ran, normals are then resolved from it instead of the g-buffer
+            daxa::ImageId visibility_image = {};
+            daxa::BufferDeviceAddress draw_data_buffer = {};
+            daxa::BufferDeviceAddress material_buffer = {};
         };
 
-        SSAOSystem(daxa::Device& _device, daxa::PipelineManager pipeline_manager);
+        // kernel samples taken per half resolution pixel each frame
+        enum struct Quality : u32 {
+            Low = 4,
+            Medium = 8,
+            High = 16,
+            Ultra = 26,
+        };
+
+        SSAOSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
         ~SSAOSystem();
 
-        void render(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+        // separate tasks so the raw image is only alive between the first two. the upsample ends the frame
+        void render_raw(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+        void render_temporal(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+        void render_upsample(daxa::CommandList& cmd_list, const RenderInfo& render_info);
 
         void resize(u32 sx, u32 sy);
+        void set_render_size(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
 
-        std::shared_ptr<daxa::RasterPipeline> ssao_generation_pipeline;
-        std::shared_ptr<daxa::RasterPipeline> ssao_blur_pipeline;
+        ComputePipelineHandle ssao_generation_pipeline;
+        ComputePipelineHandle ssao_visibility_generation_pipeline;
+        ComputePipelineHandle ssao_temporal_pipeline;
+        ComputePipelineHandle ssao_upsample_pipeline;
 
-        daxa::ImageId ssao_image;
         daxa::ImageId ssao_blur_image;
+        daxa::ImageId blue_noise_image;
+        std::array<daxa::ImageId, 2> ssao_history_images;
+
+        daxa::TaskImageId task_ssao_image;
+        daxa::TaskImageId task_ssao_blur_image;
+        std::array<daxa::TaskImageId, 2> task_ssao_history_images;
+
+        Quality quality = Quality::Medium;
+        f32 radius = 0.3f;
+        bool temporal_accumulation = true;
+        // weight of the current frame against the history
+        f32 temporal_blend = 0.1f;
+
+        u32 frame_index = 0;
+        bool history_valid = false;
+        glm::mat4 previous_view_projection{1.0f};
+        u32 previous_half_x = 1;
+        u32 previous_half_y = 1;
 
         daxa::Device device;
 
         u32 size_x = 1280;
         u32 size_y = 720;
+        // region of the images rendered to this frame, at most size_x by size_y
+        u32 render_size_x = 1280;
+        u32 render_size_y = 720;
+
+        void create_images();
+        void destroy_images();
     };
-}
\ No newline at end of file
+}
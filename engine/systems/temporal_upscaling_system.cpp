@@ -0,0 +1,131 @@
+#include "temporal_upscaling_system.hpp"
+
+#include "../../shaders/shared.inl"
+
+namespace Stellar {
+    static auto halton(u32 index, u32 base) -> f32 {
+        f32 result = 0.0f;
+        f32 fraction = 1.0f;
+        while(index > 0) {
+            fraction /= static_cast<f32>(base);
+            result += fraction * static_cast<f32>(index % base);
+            index /= base;
+        }
+        return result;
+    }
+
+    TemporalUpscalingSystem::TemporalUpscalingSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        temporal_upscale_pipeline = pipeline_cache.add_raster_pipeline({
+            .vertex_shader_info = {.source = daxa::ShaderFile{"temporal_upscale.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
+            .fragment_shader_info = {.source = daxa::ShaderFile{"temporal_upscale.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
+            .color_attachments = {
+                { .format = daxa::Format::R16G16B16A16_SFLOAT },
+                { .format = daxa::Format::R8G8B8A8_SRGB },
+            },
+            .raster = {
+                .face_culling = daxa::FaceCullFlagBits::NONE
+            },
+            .push_constant_size = sizeof(TemporalUpscalePush),
+            .debug_name = "temporal_upscale_pipeline",
+        });
+
+        create_images();
+    }
+
+    TemporalUpscalingSystem::~TemporalUpscalingSystem() {
+        destroy_images();
+    }
+
+    void TemporalUpscalingSystem::create_images() {
+        for(auto& history_image : history_images) {
+            history_image = device.create_image({
+                .format = daxa::Format::R16G16B16A16_SFLOAT,
+                .aspect = daxa::ImageAspectFlagBits::COLOR,
+                .size = { size_x, size_y, 1 },
+                .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+                .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+                .debug_name = "taau_history_image"
+            });
+        }
+
+        history_valid = false;
+    }
+
+    void TemporalUpscalingSystem::destroy_images() {
+        for(auto& history_image : history_images) { device.destroy_image(history_image); }
+    }
+
+    void TemporalUpscalingSystem::update(daxa::TaskList& task_list) {
+        frame_index++;
+
+        // halton(2, 3) covers the pixel evenly over the cycle, centered on the pixel
+        u32 phase = frame_index % TEMPORAL_UPSCALE_JITTER_PHASES + 1;
+        jitter = enabled ? glm::vec2{ halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f } : glm::vec2{ 0.0f, 0.0f };
+
+        task_list.clear_runtime_images(task_history_image);
+        task_list.add_runtime_image(task_history_image, history_images[frame_index % 2]);
+        task_list.clear_runtime_images(task_accumulation_image);
+        task_list.add_runtime_image(task_accumulation_image, history_images[(frame_index + 1) % 2]);
+    }
+
+    auto TemporalUpscalingSystem::get_jitter_offset(u32 render_size_x, u32 render_size_y) const -> glm::vec2 {
+        return { 2.0f * jitter.x / static_cast<f32>(render_size_x), 2.0f * jitter.y / static_cast<f32>(render_size_y) };
+    }
+
+    void TemporalUpscalingSystem::render(daxa::CommandList& cmd_list, const RenderInfo& render_info) {
+        daxa::ImageId accumulation_image = history_images[(frame_index + 1) % 2];
+
+        cmd_list.begin_renderpass({
+            .color_attachments = {
+                {
+                    .image_view = accumulation_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::DONT_CARE,
+                },
+                {
+                    .image_view = render_info.output_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::DONT_CARE,
+                },
+            },
+            .render_area = {.x = 0, .y = 0, .width = size_x, .height = size_y },
+        });
+
+        cmd_list.set_pipeline(*temporal_upscale_pipeline);
+        cmd_list.push_constant(TemporalUpscalePush {
+            .color = render_info.color_image.default_view(),
+            .depth = render_info.depth_image.default_view(),
+            .velocity = render_info.velocity_image.default_view(),
+            .history = { .texture_id = history_images[frame_index % 2].default_view(), .sampler_id = render_info.sampler },
+            .camera_info = render_info.camera_buffer_address,
+            .render_size = { render_info.render_size_x, render_info.render_size_y },
+            .output_size = { size_x, size_y },
+            .jitter = { jitter.x, jitter.y },
+            .blend = blend,
+            .history_valid = history_valid ? 1u : 0u,
+        });
+
+        cmd_list.draw({ .vertex_count = 3 });
+        cmd_list.end_renderpass();
+
+        history_valid = true;
+    }
+
+    void TemporalUpscalingSystem::resize(u32 sx, u32 sy) {
+        size_x = sx;
+        size_y = sy;
+
+        destroy_images();
+        create_images();
+    }
+
+    void TemporalUpscalingSystem::register_task_images(daxa::TaskList& task_list) {
+        // runtime images are swapped in update every frame, read last frame's result and write this one's
+        task_history_image = task_list.create_task_image({ .debug_name = "task_taau_history_image" });
+        task_list.add_runtime_image(task_history_image, history_images[frame_index % 2]);
+
+        task_accumulation_image = task_list.create_task_image({ .debug_name = "task_taau_accumulation_image" });
+        task_list.add_runtime_image(task_accumulation_image, history_images[(frame_index + 1) % 2]);
+
+        // a new task list starts every image from undefined
+        history_valid = false;
+    }
+}
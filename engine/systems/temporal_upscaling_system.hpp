@@ -0,0 +1,59 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+namespace Stellar {
+    // taau: the scene is rendered at the dynamic resolution with a sub pixel jitter that changes every frame,
+    // this reconstructs the viewport sized image by reprojecting an output resolution history along the g-buffer motion vectors
+    struct TemporalUpscalingSystem {
+        struct RenderInfo {
+            daxa::ImageId color_image;
+            daxa::ImageId depth_image;
+            daxa::ImageId velocity_image;
+            daxa::ImageId output_image;
+            daxa::SamplerId sampler;
+            daxa::BufferDeviceAddress camera_buffer_address;
+            u32 render_size_x;
+            u32 render_size_y;
+        };
+
+        TemporalUpscalingSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
+        ~TemporalUpscalingSystem();
+
+        // advances the jitter sequence and swaps which history image is read and which is written this frame
+        void update(daxa::TaskList& task_list);
+        // offset of the projection in ndc, zero while disabled
+        auto get_jitter_offset(u32 render_size_x, u32 render_size_y) const -> glm::vec2;
+        void render(daxa::CommandList& cmd_list, const RenderInfo& render_info);
+
+        void resize(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
+
+        RasterPipelineHandle temporal_upscale_pipeline;
+
+        std::array<daxa::ImageId, 2> history_images;
+        daxa::TaskImageId task_history_image;
+        daxa::TaskImageId task_accumulation_image;
+
+        bool enabled = false;
+        // weight of a sample landing exactly on an output pixel against the history
+        f32 blend = 0.1f;
+
+        u32 frame_index = 0;
+        bool history_valid = false;
+        // in render pixels
+        glm::vec2 jitter = { 0.0f, 0.0f };
+
+        daxa::Device device;
+
+        u32 size_x = 1280;
+        u32 size_y = 720;
+
+        void create_images();
+        void destroy_images();
+    };
+}
@@ -0,0 +1,157 @@
+#include "visibility_rendering_system.hpp"
+
+#include "../../shaders/shared.inl"
+
+#include <data/scene.hpp>
+#include <graphics/draw_commands.hpp>
+#include <graphics/material_registry.hpp>
+#include <systems/culling_system.hpp>
+
+#include <algorithm>
+
+namespace Stellar {
+    VisibilityRenderingSystem::VisibilityRenderingSystem(daxa::Device& _device, PipelineCache& pipeline_cache) : device{_device} {
+        visibility_pipeline = pipeline_cache.add_raster_pipeline({
+            .vertex_shader_info = {.source = daxa::ShaderFile{"visibility.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}}}},
+            .fragment_shader_info = {.source = daxa::ShaderFile{"visibility.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}}}},
+            .color_attachments = {
+                { .format = daxa::Format::R32G32_UINT },
+                { .format = daxa::Format::R16G16_SFLOAT },
+            },
+            .depth_test = {
+                .depth_attachment_format = daxa::Format::D32_SFLOAT,
+                .enable_depth_test = true,
+                .enable_depth_write = false,
+                .depth_test_compare_op = daxa::CompareOp::EQUAL,
+            },
+            .raster = {
+                .face_culling = daxa::FaceCullFlagBits::FRONT_BIT
+            },
+            .push_constant_size = sizeof(DepthPrepassPush),
+            .debug_name = "visibility_pipeline",
+        });
+
+        composition_pipeline = pipeline_cache.add_raster_pipeline({
+            .vertex_shader_info = {.source = daxa::ShaderFile{"composition.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_VERT"}, daxa::ShaderDefine{"VISIBILITY_BUFFER"}}}},
+            .fragment_shader_info = {.source = daxa::ShaderFile{"composition.glsl"}, .compile_options = {.defines = {daxa::ShaderDefine{"DRAW_FRAG"}, daxa::ShaderDefine{"VISIBILITY_BUFFER"}}}},
+            .color_attachments = {
+                { .format = daxa::Format::R8G8B8A8_SRGB },
+            },
+            .raster = {
+                .face_culling = daxa::FaceCullFlagBits::NONE
+            },
+            .push_constant_size = sizeof(CompositionPush),
+            .debug_name = "visibility_composition_pipeline",
+        });
+
+        create_images();
+    }
+
+    VisibilityRenderingSystem::~VisibilityRenderingSystem() {
+        device.destroy_image(visibility_image);
+    }
+
+    void VisibilityRenderingSystem::create_images() {
+        visibility_image = device.create_image({
+            .format = daxa::Format::R32G32_UINT,
+            .aspect = daxa::ImageAspectFlagBits::COLOR,
+            .size = { size_x, size_y, 1 },
+            .usage = daxa::ImageUsageFlagBits::COLOR_ATTACHMENT | daxa::ImageUsageFlagBits::SHADER_READ_ONLY,
+            .memory_flags = daxa::MemoryFlagBits::DEDICATED_MEMORY,
+            .debug_name = "visibility_image"
+        });
+    }
+
+    void VisibilityRenderingSystem::render_visibility(daxa::CommandList& cmd_list, const VisibilityRenderInfo& render_info) {
+        auto& culling_system = *render_info.culling_system;
+
+        cmd_list.begin_renderpass({
+            .color_attachments = {
+                {
+                    .image_view = visibility_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::CLEAR,
+                    .clear_value = std::array<u32, 4>{0, 0, 0, 0},
+                },
+                {
+                    .image_view = render_info.velocity_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::CLEAR,
+                    .clear_value = std::array<f32, 4>{0.0f, 0.0f, 0.0f, 0.0f},
+                },
+            },
+            .depth_attachment = {{
+                .image_view = render_info.depth_image.default_view(),
+                .load_op = daxa::AttachmentLoadOp::LOAD,
+                .clear_value = daxa::DepthValue{1.0f, 0},
+            }},
+            .render_area = {.x = 0, .y = 0, .width = render_size_x, .height = render_size_y},
+        });
+
+        cmd_list.set_pipeline(*visibility_pipeline);
+
+        DepthPrepassPush visibility_push;
+        visibility_push.camera_info = render_info.camera_buffer_address;
+        render_info.scene->draw_commands->draw(cmd_list, visibility_push, culling_system.get_culled_draws());
+        if(culling_system.occlusion_culling) {
+            render_info.scene->draw_commands->draw(cmd_list, visibility_push, culling_system.get_late_culled_draws());
+        }
+
+        cmd_list.end_renderpass();
+    }
+
+    void VisibilityRenderingSystem::render_composition(daxa::CommandList& cmd_list, const CompositionRenderInfo& render_info) {
+        cmd_list.begin_renderpass({
+            .color_attachments = {
+                {
+                    .image_view = render_info.render_image.default_view(),
+                    .load_op = daxa::AttachmentLoadOp::CLEAR,
+                    .clear_value = std::array<f32, 4>{0.05f, 0.05f, 0.05f, 1.0f},
+                },
+            },
+            .render_area = {.x = 0, .y = 0, .width = render_size_x, .height = render_size_y },
+        });
+
+        daxa::BufferId draw_data_buffer = render_info.scene->draw_commands->draw_data_buffer;
+
+        // albedo and normal are never read by this permutation, the slots keep valid ids
+        cmd_list.set_pipeline(*composition_pipeline);
+        cmd_list.push_constant(CompositionPush {
+            .albedo = { .texture_id = render_info.depth_image.default_view(), .sampler_id = render_info.sampler },
+            .normal = { .texture_id = render_info.depth_image.default_view(), .sampler_id = render_info.sampler },
+            .depth = { .texture_id = render_info.depth_image.default_view(), .sampler_id = render_info.sampler },
+            .ssao = { .texture_id = render_info.ssao_image.default_view(), .sampler_id = render_info.sampler },
+            .light_buffer = device.get_device_address(render_info.scene->light_buffer),
+            .camera_info = render_info.camera_buffer_address,
+            .clusters = device.get_device_address(render_info.light_clusters),
+            .z_near = render_info.z_near,
+            .z_far = render_info.z_far,
+            .ambient = render_info.ambient,
+            .visibility = visibility_image.default_view(),
+            .draw_data_buffer = draw_data_buffer.is_empty() ? daxa::BufferDeviceAddress{} : device.get_device_address(draw_data_buffer),
+            .material_buffer = render_info.scene->material_registry->get_material_buffer_address(),
+            .uv_scale = { static_cast<f32>(render_size_x) / static_cast<f32>(size_x), static_cast<f32>(render_size_y) / static_cast<f32>(size_y) },
+        });
+
+        cmd_list.draw({ .vertex_count = 3 });
+        cmd_list.end_renderpass();
+    }
+
+    void VisibilityRenderingSystem::resize(u32 sx, u32 sy) {
+        size_x = sx;
+        size_y = sy;
+        render_size_x = sx;
+        render_size_y = sy;
+
+        device.destroy_image(visibility_image);
+        create_images();
+    }
+
+    void VisibilityRenderingSystem::set_render_size(u32 sx, u32 sy) {
+        render_size_x = std::clamp(sx, 1u, size_x);
+        render_size_y = std::clamp(sy, 1u, size_y);
+    }
+
+    void VisibilityRenderingSystem::register_task_images(daxa::TaskList& task_list) {
+        task_visibility_image = task_list.create_task_image({ .debug_name = "task_visibility_image" });
+        task_list.add_runtime_image(task_visibility_image, visibility_image);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <core/types.hpp>
+
+#include <daxa/daxa.hpp>
+#include <graphics/pipeline_cache.hpp>
+#include <daxa/utils/task_list.hpp>
+
+namespace Stellar {
+    struct Scene;
+    struct CullingSystem;
+
+    // alternative to the deferred g-buffer: after the depth prepass only (draw index, triangle index) is rasterized,
+    // composition then refetches the triangle, interpolates it and evaluates the material once per pixel.
+    // shares the depth prepass, culling and render target with DefferedRenderingSystem
+    struct VisibilityRenderingSystem {
+        struct VisibilityRenderInfo {
+            std::shared_ptr<Scene> scene;
+            daxa::BufferDeviceAddress camera_buffer_address;
+            CullingSystem* culling_system;
+            daxa::ImageId depth_image;
+            daxa::ImageId velocity_image;
+        };
+
+        struct CompositionRenderInfo {
+            std::shared_ptr<Scene> scene;
+            daxa::SamplerId sampler;
+            daxa::ImageId depth_image;
+            daxa::ImageId ssao_image;
+            daxa::ImageId render_image;
+            daxa::BufferDeviceAddress camera_buffer_address;
+            daxa::BufferId light_clusters;
+            f32 z_near;
+            f32 z_far;
+            f32 ambient;
+        };
+
+        VisibilityRenderingSystem(daxa::Device& _device, PipelineCache& pipeline_cache);
+        ~VisibilityRenderingSystem();
+
+        void render_visibility(daxa::CommandList& cmd_list, const VisibilityRenderInfo& render_info);
+        void render_composition(daxa::CommandList& cmd_list, const CompositionRenderInfo& render_info);
+
+        void resize(u32 sx, u32 sy);
+        void set_render_size(u32 sx, u32 sy);
+        void register_task_images(daxa::TaskList& task_list);
+
+        RasterPipelineHandle visibility_pipeline;
+        RasterPipelineHandle composition_pipeline;
+
+        daxa::ImageId visibility_image;
+        daxa::TaskImageId task_visibility_image;
+
+        daxa::Device device;
+
+        u32 size_x = 1280;
+        u32 size_y = 720;
+        // region of the images rendered to this frame, at most size_x by size_y
+        u32 render_size_x = 1280;
+        u32 render_size_y = 720;
+
+        void create_images();
+    };
+}
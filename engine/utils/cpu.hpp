@@ -0,0 +1,36 @@
+#pragma once
+
+// the engine is built for the baseline instruction set, the avx2 paths are compiled per function
+// and only taken once the cpu it's running on says it can execute them
+#if defined(STELLAR_ENABLE_AVX2) && (defined(__x86_64__) || defined(_M_X64))
+    #define STELLAR_AVX2 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define STELLAR_TARGET_AVX2
+    #else
+        #define STELLAR_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace Stellar {
+    inline auto cpu_has_avx2() -> bool {
+    #if defined(STELLAR_AVX2)
+        static const bool supported = [] {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4] = {};
+            __cpuid(info, 1);
+            // the os has to save the ymm registers too, not just the cpu support them
+            bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+        #else
+            return __builtin_cpu_supports("avx2") != 0;
+        #endif
+        }();
+        return supported;
+    #else
+        return false;
+    #endif
+    }
+}
@@ -3,167 +3,255 @@
 #include <daxa/daxa.inl>
 #include "shared.inl"
 
-#define sample_texture(tex, uv) texture(tex.texture_id, tex.sampler_id, uv)
-#define texture_size(tex, mip) textureSize(tex.texture_id, mip)
-
-#define MATERIAL deref(daxa_push_constant.material_buffer[daxa_push_constant.material_index])
-#define LIGHTS_BUFFER deref(daxa_push_constant.light_buffer)
 #define CAMERA deref(daxa_push_constant.camera_info)
-#define TRANSFORM deref(daxa_push_constant.transform_buffer)
-#define VERTEX deref(daxa_push_constant.vertex_buffer[gl_VertexIndex])
-
-DAXA_USE_PUSH_CONSTANT(SkyPush)
-
-#if defined(DRAW_VERT)
-
-out gl_PerVertex {
-    vec4 gl_Position;
-};
-
-layout(location = 0) out f32vec3 out_position;
-
-void main() {
-    out_position = deref(daxa_push_constant.vertex_buffer[gl_VertexIndex]).position;
-    gl_Position = (CAMERA.projection_matrix * CAMERA.view_matrix * daxa_push_constant.model_matrix * f32vec4(deref(daxa_push_constant.vertex_buffer[gl_VertexIndex]).position, 1.0)).xyww;
-}
-
-#elif defined(DRAW_FRAG)
 
-layout(location = 0) out f32vec4 out_color;
-
-layout(location = 0) in f32vec3 in_position;
+DAXA_USE_PUSH_CONSTANT(AtmospherePush)
 
 #define PI 3.141592
-#define iSteps 16
-#define jSteps 8
 
-vec2 rsi(vec3 r0, vec3 rd, float sr) {
+// planet at the origin, distances in meters
+#define PLANET_RADIUS 6371e3
+#define ATMOSPHERE_RADIUS 6471e3
+#define RAYLEIGH_SCATTERING f32vec3(5.5e-6, 13.0e-6, 22.4e-6)
+#define MIE_SCATTERING 21e-6
+#define RAYLEIGH_SCALE_HEIGHT 8e3
+#define MIE_SCALE_HEIGHT 1.2e3
+#define MIE_G 0.758
+#define SUN_INTENSITY 22.0
+
+f32vec2 rsi(f32vec3 r0, f32vec3 rd, f32 sr) {
     // ray-sphere intersection that assumes
     // the sphere is centered at the origin.
     // No intersection when result.x > result.y
-    float a = dot(rd, rd);
-    float b = 2.0 * dot(rd, r0);
-    float c = dot(r0, r0) - (sr * sr);
-    float d = (b*b) - 4.0*a*c;
-    if (d < 0.0) return vec2(1e5,-1e5);
-    return vec2(
+    f32 a = dot(rd, rd);
+    f32 b = 2.0 * dot(rd, r0);
+    f32 c = dot(r0, r0) - (sr * sr);
+    f32 d = (b*b) - 4.0*a*c;
+    if (d < 0.0) return f32vec2(1e5,-1e5);
+    return f32vec2(
         (-b - sqrt(d))/(2.0*a),
         (-b + sqrt(d))/(2.0*a)
     );
 }
 
-vec3 atmosphere(vec3 r, vec3 r0, vec3 pSun, float iSun, float rPlanet, float rAtmos, vec3 kRlh, float kMie, float shRlh, float shMie, float g) {
-    // Normalize the sun and view directions.
-    pSun = normalize(pSun);
-    r = normalize(r);
-
-    // Calculate the step size of the primary ray.
-    vec2 p = rsi(r0, r, rAtmos);
-    if (p.x > p.y) return vec3(0,0,0);
-    p.y = min(p.y, rsi(r0, r, rPlanet).x);
-    float iStepSize = (p.y - p.x) / float(iSteps);
+f32vec3 extinction_at(f32 height) {
+    return RAYLEIGH_SCATTERING * exp(-height / RAYLEIGH_SCALE_HEIGHT) + MIE_SCATTERING * exp(-height / MIE_SCALE_HEIGHT);
+}
 
-    // Initialize the primary ray time.
-    float iTime = 0.0;
+f32 rayleigh_phase(f32 mu) {
+    return 3.0 / (16.0 * PI) * (1.0 + mu * mu);
+}
 
-    // Initialize accumulators for Rayleigh and Mie scattering.
-    vec3 totalRlh = vec3(0,0,0);
-    vec3 totalMie = vec3(0,0,0);
+f32 mie_phase(f32 mu) {
+    f32 gg = MIE_G * MIE_G;
+    return 3.0 / (8.0 * PI) * ((1.0 - gg) * (mu * mu + 1.0)) / (pow(1.0 + gg - 2.0 * mu * MIE_G, 1.5) * (2.0 + gg));
+}
 
-    // Initialize optical depth accumulators for the primary ray.
-    float iOdRlh = 0.0;
-    float iOdMie = 0.0;
+// luts are indexed by (cos of the sun zenith angle, height in the atmosphere)
+f32vec2 lut_uv(f32 height, f32 sun_cos_zenith) {
+    return f32vec2(sun_cos_zenith * 0.5 + 0.5, clamp(height / (ATMOSPHERE_RADIUS - PLANET_RADIUS), 0.0, 1.0));
+}
 
-    // Calculate the Rayleigh and Mie phases.
-    float mu = dot(r, pSun);
-    float mumu = mu * mu;
-    float gg = g * g;
-    float pRlh = 3.0 / (16.0 * PI) * (1.0 + mumu);
-    float pMie = 3.0 / (8.0 * PI) * ((1.0 - gg) * (mumu + 1.0)) / (pow(1.0 + gg - 2.0 * mu * g, 1.5) * (2.0 + gg));
+void lut_params(f32vec2 uv, out f32 height, out f32 sun_cos_zenith) {
+    sun_cos_zenith = uv.x * 2.0 - 1.0;
+    height = uv.y * (ATMOSPHERE_RADIUS - PLANET_RADIUS);
+}
 
-    // Sample the primary ray.
-    for (int i = 0; i < iSteps; i++) {
+f32vec3 sample_lut(daxa_Image2Df32 lut, f32vec3 position, f32vec3 sun_direction) {
+    f32 r = length(position);
+    f32vec2 uv = lut_uv(r - PLANET_RADIUS, dot(position / r, sun_direction));
+    return texture(lut, daxa_push_constant.lut_sampler, uv).rgb;
+}
 
-        // Calculate the primary ray sample position.
-        vec3 iPos = r0 + r * (iTime + iStepSize * 0.5);
+#if defined(TRANSMITTANCE_LUT)
 
-        // Calculate the height of the sample.
-        float iHeight = length(iPos) - rPlanet;
+#define TRANSMITTANCE_STEPS 40
 
-        // Calculate the optical depth of the Rayleigh and Mie scattering for this step.
-        float odStepRlh = exp(-iHeight / shRlh) * iStepSize;
-        float odStepMie = exp(-iHeight / shMie) * iStepSize;
+layout(local_size_x = 8, local_size_y = 8) in;
+void main() {
+    u32vec2 texel = gl_GlobalInvocationID.xy;
+    if(any(greaterThanEqual(texel, daxa_push_constant.dst_size))) { return; }
+
+    f32 height, sun_cos_zenith;
+    lut_params((f32vec2(texel) + 0.5) / f32vec2(daxa_push_constant.dst_size), height, sun_cos_zenith);
+
+    f32vec3 position = f32vec3(0.0, PLANET_RADIUS + height, 0.0);
+    f32vec3 sun_direction = f32vec3(sqrt(max(1.0 - sun_cos_zenith * sun_cos_zenith, 0.0)), sun_cos_zenith, 0.0);
+
+    // rays that hit the ground never see the sun
+    f32vec2 planet_hit = rsi(position, sun_direction, PLANET_RADIUS);
+    f32vec3 transmittance = f32vec3(0.0);
+    if(planet_hit.x > planet_hit.y || planet_hit.y < 0.0) {
+        f32 step_size = rsi(position, sun_direction, ATMOSPHERE_RADIUS).y / f32(TRANSMITTANCE_STEPS);
+        f32vec3 optical_depth = f32vec3(0.0);
+        for(i32 i = 0; i < TRANSMITTANCE_STEPS; i++) {
+            f32vec3 sample_position = position + sun_direction * (f32(i) + 0.5) * step_size;
+            optical_depth += extinction_at(length(sample_position) - PLANET_RADIUS) * step_size;
+        }
+        transmittance = exp(-optical_depth);
+    }
 
-        // Accumulate optical depth.
-        iOdRlh += odStepRlh;
-        iOdMie += odStepMie;
+    imageStore(daxa_push_constant.dst, i32vec2(texel), f32vec4(transmittance, 1.0));
+}
 
-        // Calculate the step size of the secondary ray.
-        float jStepSize = rsi(iPos, pSun, rAtmos).y / float(jSteps);
+#elif defined(MULTIPLE_SCATTERING_LUT)
 
-        // Initialize the secondary ray time.
-        float jTime = 0.0;
+// second order scattering towards a point from all directions with an isotropic phase, extended to infinite
+// orders with the geometric series 1 / (1 - f_ms) (Hillaire 2020)
+#define DIRECTION_COUNT 8
+#define MULTIPLE_SCATTERING_STEPS 20
 
-        // Initialize optical depth accumulators for the secondary ray.
-        float jOdRlh = 0.0;
-        float jOdMie = 0.0;
+layout(local_size_x = 8, local_size_y = 8) in;
+void main() {
+    u32vec2 texel = gl_GlobalInvocationID.xy;
+    if(any(greaterThanEqual(texel, daxa_push_constant.dst_size))) { return; }
+
+    f32 height, sun_cos_zenith;
+    lut_params((f32vec2(texel) + 0.5) / f32vec2(daxa_push_constant.dst_size), height, sun_cos_zenith);
+
+    f32vec3 position = f32vec3(0.0, PLANET_RADIUS + height, 0.0);
+    f32vec3 sun_direction = f32vec3(sqrt(max(1.0 - sun_cos_zenith * sun_cos_zenith, 0.0)), sun_cos_zenith, 0.0);
+
+    f32vec3 second_order = f32vec3(0.0);
+    f32vec3 transfer = f32vec3(0.0);
+    const f32 isotropic_phase = 1.0 / (4.0 * PI);
+
+    for(i32 i = 0; i < DIRECTION_COUNT; i++) {
+        for(i32 j = 0; j < DIRECTION_COUNT; j++) {
+            f32 theta = 2.0 * PI * (f32(i) + 0.5) / f32(DIRECTION_COUNT);
+            f32 phi = acos(1.0 - 2.0 * (f32(j) + 0.5) / f32(DIRECTION_COUNT));
+            f32vec3 direction = f32vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+
+            f32vec2 atmosphere_hit = rsi(position, direction, ATMOSPHERE_RADIUS);
+            f32vec2 planet_hit = rsi(position, direction, PLANET_RADIUS);
+            f32 distance = atmosphere_hit.y;
+            if(planet_hit.x > 0.0 && planet_hit.x < planet_hit.y) { distance = min(distance, planet_hit.x); }
+            f32 step_size = distance / f32(MULTIPLE_SCATTERING_STEPS);
+
+            f32vec3 view_transmittance = f32vec3(1.0);
+            f32vec3 luminance = f32vec3(0.0);
+            f32vec3 luminance_transfer = f32vec3(0.0);
+            for(i32 s = 0; s < MULTIPLE_SCATTERING_STEPS; s++) {
+                f32vec3 sample_position = position + direction * (f32(s) + 0.5) * step_size;
+                f32 sample_height = length(sample_position) - PLANET_RADIUS;
+
+                f32vec3 scattering = RAYLEIGH_SCATTERING * exp(-sample_height / RAYLEIGH_SCALE_HEIGHT) + MIE_SCATTERING * exp(-sample_height / MIE_SCALE_HEIGHT);
+                f32vec3 step_transmittance = exp(-extinction_at(sample_height) * step_size);
+                f32vec3 sun_transmittance = sample_lut(daxa_push_constant.transmittance_lut, sample_position, sun_direction);
+
+                // analytic integration over the step, see the sky view pass
+                f32vec3 integral = (1.0 - step_transmittance) / max(extinction_at(sample_height), f32vec3(1e-12));
+                luminance += view_transmittance * scattering * sun_transmittance * isotropic_phase * integral;
+                luminance_transfer += view_transmittance * scattering * integral;
+                view_transmittance *= step_transmittance;
+            }
+
+            second_order += luminance;
+            transfer += luminance_transfer;
+        }
+    }
 
-        // Sample the secondary ray.
-        for (int j = 0; j < jSteps; j++) {
+    // uniform sphere weight of every direction
+    f32 direction_weight = 1.0 / f32(DIRECTION_COUNT * DIRECTION_COUNT);
+    second_order *= direction_weight;
+    transfer *= direction_weight;
 
-            // Calculate the secondary ray sample position.
-            vec3 jPos = iPos + pSun * (jTime + jStepSize * 0.5);
+    f32vec3 multiple_scattering = second_order / (1.0 - transfer);
+    imageStore(daxa_push_constant.dst, i32vec2(texel), f32vec4(multiple_scattering, 1.0));
+}
 
-            // Calculate the height of the sample.
-            float jHeight = length(jPos) - rPlanet;
+#elif defined(SKY_VIEW_LUT)
 
-            // Accumulate the optical depth.
-            jOdRlh += exp(-jHeight / shRlh) * jStepSize;
-            jOdMie += exp(-jHeight / shMie) * jStepSize;
+#define SKY_VIEW_STEPS 32
 
-            // Increment the secondary ray time.
-            jTime += jStepSize;
+// x is the azimuth from the sun, y the elevation with more resolution around the horizon
+layout(local_size_x = 8, local_size_y = 8) in;
+void main() {
+    u32vec2 texel = gl_GlobalInvocationID.xy;
+    if(any(greaterThanEqual(texel, daxa_push_constant.dst_size))) { return; }
+
+    f32vec2 uv = (f32vec2(texel) + 0.5) / f32vec2(daxa_push_constant.dst_size);
+    f32 azimuth = (uv.x * 2.0 - 1.0) * PI;
+    f32 v = uv.y * 2.0 - 1.0;
+    f32 elevation = sign(v) * v * v * (PI * 0.5);
+
+    f32vec3 position = f32vec3(0.0, PLANET_RADIUS + daxa_push_constant.camera_height, 0.0);
+    f32vec3 direction = f32vec3(cos(elevation) * cos(azimuth), sin(elevation), cos(elevation) * sin(azimuth));
+
+    f32 sun_cos_zenith = daxa_push_constant.sun_direction.y;
+    f32vec3 sun_direction = f32vec3(sqrt(max(1.0 - sun_cos_zenith * sun_cos_zenith, 0.0)), sun_cos_zenith, 0.0);
+
+    f32vec2 atmosphere_hit = rsi(position, direction, ATMOSPHERE_RADIUS);
+    f32vec2 planet_hit = rsi(position, direction, PLANET_RADIUS);
+    f32 start = max(atmosphere_hit.x, 0.0);
+    f32 end = atmosphere_hit.y;
+    if(planet_hit.x > 0.0 && planet_hit.x < planet_hit.y) { end = min(end, planet_hit.x); }
+
+    f32vec3 luminance = f32vec3(0.0);
+    if(end > start) {
+        f32 step_size = (end - start) / f32(SKY_VIEW_STEPS);
+        f32 mu = dot(direction, sun_direction);
+        f32 rayleigh = rayleigh_phase(mu);
+        f32 mie = mie_phase(mu);
+
+        f32vec3 view_transmittance = f32vec3(1.0);
+        for(i32 i = 0; i < SKY_VIEW_STEPS; i++) {
+            f32vec3 sample_position = position + direction * (start + (f32(i) + 0.5) * step_size);
+            f32 sample_height = length(sample_position) - PLANET_RADIUS;
+
+            f32vec3 rayleigh_scattering = RAYLEIGH_SCATTERING * exp(-sample_height / RAYLEIGH_SCALE_HEIGHT);
+            f32vec3 mie_scattering = f32vec3(MIE_SCATTERING * exp(-sample_height / MIE_SCALE_HEIGHT));
+            f32vec3 extinction = extinction_at(sample_height);
+
+            f32vec3 sun_transmittance = sample_lut(daxa_push_constant.transmittance_lut, sample_position, sun_direction);
+            f32vec3 multiple_scattering = sample_lut(daxa_push_constant.multiple_scattering_lut, sample_position, sun_direction);
+
+            f32vec3 in_scattering = (rayleigh_scattering * rayleigh + mie_scattering * mie) * sun_transmittance + (rayleigh_scattering + mie_scattering) * multiple_scattering;
+
+            // integrate in-scattering analytically over the step so coarse steps don't overshoot
+            f32vec3 step_transmittance = exp(-extinction * step_size);
+            luminance += view_transmittance * in_scattering * (1.0 - step_transmittance) / max(extinction, f32vec3(1e-12));
+            view_transmittance *= step_transmittance;
         }
+    }
 
-        // Calculate attenuation.
-        vec3 attn = exp(-(kMie * (iOdMie + jOdMie) + kRlh * (iOdRlh + jOdRlh)));
-
-        // Accumulate scattering.
-        totalRlh += odStepRlh * attn;
-        totalMie += odStepMie * attn;
+    imageStore(daxa_push_constant.dst, i32vec2(texel), f32vec4(luminance * SUN_INTENSITY, 1.0));
+}
 
-        // Increment the primary ray time.
-        iTime += iStepSize;
+#elif defined(DRAW_VERT)
 
-    }
+layout(location = 0) out f32vec2 out_uv;
 
-    // Calculate and return the final color.
-    return iSun * (pRlh * kRlh * totalRlh + pMie * kMie * totalMie);
+// fullscreen at the far plane, depth testing against the g-buffer depth keeps only the pixels nothing was drawn to
+void main() {
+    out_uv = f32vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = f32vec4(out_uv * 2.0f - 1.0f, 1.0f, 1.0f);
 }
 
+#elif defined(DRAW_FRAG)
+
+layout(location = 0) in f32vec2 in_uv;
+layout(location = 0) out f32vec4 out_color;
+
 void main() {
-    //out_color = vec4(1.0);
-
-    vec3 color = atmosphere(
-        normalize(in_position),             // normalized ray direction
-        vec3(0,6372e3,0) + CAMERA.position, // ray origin
-        daxa_push_constant.sun_position,    // position of the sun
-        22.0,                               // intensity of the sun
-        6371e3,                             // radius of the planet in meters
-        6471e3,                             // radius of the atmosphere in meters
-        vec3(5.5e-6, 13.0e-6, 22.4e-6),     // Rayleigh scattering coefficient
-        21e-6,                              // Mie scattering coefficient
-        8e3,                                // Rayleigh scale height
-        1.2e3,                              // Mie scale height
-        0.758                               // Mie preferred scattering direction
-    );
+    f32vec4 view_position = CAMERA.inverse_projection_matrix * f32vec4(in_uv * 2.0 - 1.0, 1.0, 1.0);
+    f32vec3 direction = normalize((CAMERA.inverse_view_matrix * f32vec4(view_position.xyz / view_position.w, 0.0)).xyz);
+
+    // the lut frame has the sun at azimuth zero
+    f32 elevation = asin(clamp(direction.y, -1.0, 1.0));
+    f32vec2 sun_horizontal = daxa_push_constant.sun_direction.xz;
+    f32 sun_azimuth = dot(sun_horizontal, sun_horizontal) > 0.0 ? atan(sun_horizontal.y, sun_horizontal.x) : 0.0;
+    f32 azimuth = atan(direction.z, direction.x) - sun_azimuth;
+    azimuth = mod(azimuth + PI, 2.0 * PI) - PI;
 
-    //vec3 color = vec3(1.0);
+    f32 v = elevation / (PI * 0.5);
+    f32vec2 uv = f32vec2(azimuth / (2.0 * PI) + 0.5, (sign(v) * sqrt(abs(v))) * 0.5 + 0.5);
+    f32vec3 color = texture(daxa_push_constant.sky_view_lut, daxa_push_constant.lut_sampler, uv).rgb;
 
     // Apply exposure.
     color = 1.0 - exp(-1.0 * color);
 
-    out_color = vec4(color, 1);
+    out_color = f32vec4(color, 1.0);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -6,14 +6,17 @@
 #define sample_texture(tex, uv) texture(tex.texture_id, tex.sampler_id, uv)
 #define texture_size(tex, mip) textureSize(tex.texture_id, mip)
 
-#define MATERIAL deref(daxa_push_constant.material_buffer[daxa_push_constant.material_index])
 #define LIGHTS_BUFFER deref(daxa_push_constant.light_buffer)
+#define CLUSTER(i) deref(daxa_push_constant.clusters[i])
 #define CAMERA deref(daxa_push_constant.camera_info)
-#define TRANSFORM deref(daxa_push_constant.transform_buffer)
 #define VERTEX deref(daxa_push_constant.vertex_buffer[gl_VertexIndex])
 
 DAXA_USE_PUSH_CONSTANT(CompositionPush)
 
+#if defined(VISIBILITY_BUFFER)
+#include "visibility_resolve.glsl"
+#endif
+
 #if defined(DRAW_VERT)
 
 layout(location = 0) out f32vec2 out_uv;
@@ -36,16 +39,27 @@ f32 linstep(f32 low, f32 high, f32 v) {
 
 #define SHADOW 0.05
 
-f32 normal_shadow(TextureId shadow_image, f32vec4 shadow_coord, f32vec2 off, f32 bias) {
+// maps a [0, 1] uv of a light's shadow map into its tile of the atlas, clamped so filtering never reads a neighbour
+f32vec2 atlas_uv(f32vec4 rect, f32vec2 uv) {
+    return rect.xy + clamp(uv, 0.0, 1.0) * rect.zw;
+}
+
+bool outside_shadow_map(f32vec4 rect, f32vec2 uv) {
+    return rect.z == 0.0 || any(lessThan(uv, f32vec2(0.0))) || any(greaterThan(uv, f32vec2(1.0)));
+}
+
+f32 normal_shadow(TextureId shadow_image, f32vec4 rect, f32vec4 shadow_coord, f32vec2 off, f32 bias) {
     f32vec3 proj_coord = shadow_coord.xyz * 0.5 + 0.5;
-	return max(sample_shadow(shadow_image, proj_coord.xy + off, shadow_coord.z - bias).r, SHADOW);
+	return max(sample_shadow(shadow_image, atlas_uv(rect, proj_coord.xy + off), shadow_coord.z - bias).r, SHADOW);
 }
 
-f32 shadow_pcf(TextureId shadow_image, f32vec4 shadow_coord, f32 bias) {
+f32 shadow_pcf(TextureId shadow_image, f32vec4 rect, f32vec4 shadow_coord, f32 bias) {
+    if(outside_shadow_map(rect, shadow_coord.xy * 0.5 + 0.5)) { return 1.0; }
+
     i32vec2 tex_dim = texture_size(shadow_image, 0);
 	f32 scale = 0.25;
-	f32 dx = scale * 1.0 / f32(tex_dim.x);
-	f32 dy = scale * 1.0 / f32(tex_dim.y);
+	f32 dx = scale * 1.0 / (f32(tex_dim.x) * rect.z);
+	f32 dy = scale * 1.0 / (f32(tex_dim.y) * rect.w);
 
 	f32 shadow_factor = 0.0;
 	i32 count = 0;
@@ -53,7 +67,7 @@ f32 shadow_pcf(TextureId shadow_image, f32vec4 shadow_coord, f32 bias) {
 	
 	for (i32 x = -range; x <= range; x++) {
 		for (i32 y = -range; y <= range; y++) {
-			shadow_factor += normal_shadow(shadow_image, shadow_coord, f32vec2(dx*x, dy*y), bias);
+			shadow_factor += normal_shadow(shadow_image, rect, shadow_coord, f32vec2(dx*x, dy*y), bias);
 			count++;
 		}
 	
@@ -61,10 +75,11 @@ f32 shadow_pcf(TextureId shadow_image, f32vec4 shadow_coord, f32 bias) {
 	return (shadow_factor / count);
 }
 
-f32 variance_shadow(TextureId shadow_image, f32vec4 shadow_coord) {
+f32 variance_shadow(TextureId shadow_image, f32vec4 rect, f32vec4 shadow_coord) {
     f32vec3 proj_coord = shadow_coord.xyz * 0.5 + 0.5;
+    if(outside_shadow_map(rect, proj_coord.xy)) { return 1.0; }
 	
-    f32vec2 moments = sample_texture(shadow_image, proj_coord.xy).xy;
+    f32vec2 moments = sample_texture(shadow_image, atlas_uv(rect, proj_coord.xy)).xy;
     f32 p = step(shadow_coord.z, moments.x);
     f32 variance = max(moments.y - moments.x * moments.x, 0.00002);
 	f32 d = shadow_coord.z - moments.x;
@@ -80,7 +95,7 @@ f32vec3 calculate_directional_light(DirectionalLight light, f32vec3 frag_color,
 
     f32vec4 shadow_coord = light.light_matrix * position;
     f32 shadow = 1.0;
-    shadow = shadow_pcf(light.shadow_image, shadow_coord / shadow_coord.w, bias);
+    shadow = shadow_pcf(light.shadow_image, light.shadow_rect, shadow_coord / shadow_coord.w, bias);
     
     f32vec3 view_dir = normalize(camera_position - frag_position);
     f32vec3 halfway_dir = normalize(light_dir + view_dir);
@@ -92,12 +107,19 @@ f32vec3 calculate_directional_light(DirectionalLight light, f32vec3 frag_color,
     return frag_color * light.color * (diffuse + exp(exponent)) * shadow * light.intensity;
 }
 
+// fades 1/d² out to zero at the radius the light was culled with
+f32 range_window(f32 distance, f32 radius) {
+    f32 r = distance / radius;
+    f32 window = clamp(1.0 - (r * r) * (r * r), 0.0, 1.0);
+    return window * window;
+}
+
 f32vec3 calculate_point_light(PointLight light, f32vec3 frag_color, f32vec3 normal, f32vec4 position, f32vec3 camera_position) {
     f32vec3 frag_position = position.xyz;
     f32vec3 light_dir = normalize(light.position - frag_position);
 
     f32 distance = length(light.position.xyz - frag_position);
-    f32 attenuation = 1.0f / (distance * distance);
+    f32 attenuation = range_window(distance, light.radius) / (distance * distance);
 
     f32vec3 view_dir = normalize(camera_position - frag_position);
     f32vec3 halfway_dir = normalize(light_dir + view_dir);
@@ -116,14 +138,14 @@ f32vec3 calculate_spot_light(SpotLight light, f32vec3 frag_color, f32vec3 normal
 
     f32vec4 shadow_coord = light.light_matrix * position;
     f32 shadow = 1.0;
-    shadow = variance_shadow(light.shadow_image, shadow_coord / shadow_coord.w);
+    shadow = variance_shadow(light.shadow_image, light.shadow_rect, shadow_coord / shadow_coord.w);
 
     f32 theta = dot(light_dir, normalize(-light.direction)); 
     f32 epsilon = (light.cut_off - light.outer_cut_off);
     f32 intensity = clamp((theta - light.outer_cut_off) / epsilon, 0, 1.0);
 
     f32 distance = length(light.position - frag_position);
-    f32 attenuation = 1.0 / (distance * distance); 
+    f32 attenuation = range_window(distance, light.radius) / (distance * distance); 
 
     f32vec3 view_dir = normalize(camera_position - frag_position);
     f32vec3 halfway_dir = normalize(light_dir + view_dir);
@@ -164,28 +186,54 @@ f32vec3 ACESFilm(f32vec3 x) {
 }
 
 void main() {
-    f32vec4 color = sample_texture(daxa_push_constant.albedo, in_uv);
-    f32vec4 normal = sample_texture(daxa_push_constant.normal, in_uv);
+    // in_uv spans the rendered region, texture_uv is where that region sits in the targets
+    f32vec2 texture_uv = in_uv * daxa_push_constant.uv_scale;
+
+#if defined(VISIBILITY_BUFFER)
+    // material evaluated once per pixel from the triangle the visibility pass kept, the clear values match the g-buffer's
+    f32vec4 color = f32vec4(0.05, 0.05, 0.05, 1.0);
+    f32vec3 normal = f32vec3(0.0);
+    u32vec2 ids = texelFetch(daxa_push_constant.visibility, i32vec2(gl_FragCoord.xy), 0).xy;
+    f32vec2 screen_size = f32vec2(textureSize(daxa_push_constant.visibility, 0)) * daxa_push_constant.uv_scale;
+    VisibilitySurface surface;
+    if(resolve_visibility(ids, in_uv * 2.0 - 1.0, screen_size, CAMERA.projection_matrix * CAMERA.view_matrix, daxa_push_constant.draw_data_buffer, daxa_push_constant.material_buffer, surface)) {
+        color = f32vec4(surface_albedo(surface), 1.0);
+        normal = surface_normal(surface);
+    }
+#else
+    f32vec4 color = sample_texture(daxa_push_constant.albedo, texture_uv);
+    f32vec3 normal = decode_normal(sample_texture(daxa_push_constant.normal, texture_uv).xy);
+#endif
 
     f32vec3 ambient = f32vec3(max(daxa_push_constant.ambient, 0.01));
     
     ambient *= color.rgb;
-    ambient *= sample_texture(daxa_push_constant.ssao, in_uv).r;
+    ambient *= sample_texture(daxa_push_constant.ssao, texture_uv).r;
 
-    f32vec4 position = f32vec4(get_world_position_from_depth(in_uv, sample_texture(daxa_push_constant.depth, in_uv).r), 1.0);
+    f32vec4 position = f32vec4(get_world_position_from_depth(in_uv, sample_texture(daxa_push_constant.depth, texture_uv).r), 1.0);
     
     f32vec3 camera_position = CAMERA.inverse_view_matrix[3].xyz;
 
     for(uint i = 0; i < LIGHTS_BUFFER.num_directional_lights; i++) {
-        ambient += calculate_directional_light(LIGHTS_BUFFER.directional_lights[i], ambient.rgb, normal.xyz, position, camera_position);
+        ambient += calculate_directional_light(LIGHTS_BUFFER.directional_lights[i], ambient.rgb, normal, position, camera_position);
     }
 
-    for(uint i = 0; i < LIGHTS_BUFFER.num_point_lights; i++) {
-        ambient += calculate_point_light(LIGHTS_BUFFER.point_lights[i], ambient.rgb, normal.xyz, position, camera_position);
+    f32 view_depth = -(CAMERA.view_matrix * position).z;
+    f32 slice = log(view_depth / daxa_push_constant.z_near) / log(daxa_push_constant.z_far / daxa_push_constant.z_near) * f32(LIGHT_CLUSTER_Z);
+    u32vec3 cluster = u32vec3(
+        min(u32vec2(in_uv * f32vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y)), u32vec2(LIGHT_CLUSTER_X - 1, LIGHT_CLUSTER_Y - 1)),
+        u32(clamp(slice, 0.0, f32(LIGHT_CLUSTER_Z - 1)))
+    );
+    u32 cluster_index = cluster.x + cluster.y * LIGHT_CLUSTER_X + cluster.z * LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y;
+    u32 point_count = CLUSTER(cluster_index).point_count;
+    u32 spot_count = CLUSTER(cluster_index).spot_count;
+
+    for(uint i = 0; i < point_count; i++) {
+        ambient += calculate_point_light(LIGHTS_BUFFER.point_lights[CLUSTER(cluster_index).light_indices[i]], ambient.rgb, normal, position, camera_position);
     }
 
-    for(uint i = 0; i < LIGHTS_BUFFER.num_spot_lights; i++) {
-        ambient += calculate_spot_light(LIGHTS_BUFFER.spot_lights[i], ambient.rgb, normal.xyz, position, camera_position);
+    for(uint i = point_count; i < point_count + spot_count; i++) {
+        ambient += calculate_spot_light(LIGHTS_BUFFER.spot_lights[CLUSTER(cluster_index).light_indices[i]], ambient.rgb, normal, position, camera_position);
     }
 
     out_color = f32vec4(ambient, 1.0);
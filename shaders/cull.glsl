@@ -0,0 +1,104 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(CullPush)
+
+#define CULL_INFO deref(daxa_push_constant.cull_info)
+
+bool frustum_test(f32vec3 world_center, f32vec3 world_extent) {
+    for(u32 i = 0; i < 6; i++) {
+        f32vec4 plane = CULL_INFO.planes[i];
+        if(dot(plane.xyz, world_center) + plane.w < -dot(abs(plane.xyz), world_extent)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool occlusion_test(f32vec3 world_center, f32vec3 world_extent) {
+    f32vec2 uv_min = f32vec2(1.0);
+    f32vec2 uv_max = f32vec2(0.0);
+    f32 min_z = 1.0;
+
+    for(u32 i = 0; i < 8; i++) {
+        f32vec3 corner_sign = f32vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        f32vec4 clip = CULL_INFO.view_projection * f32vec4(world_center + world_extent * corner_sign, 1.0);
+
+        // crosses the near plane, can't be bounded on screen
+        if(clip.w <= 0.0) { return true; }
+
+        f32vec3 ndc = clip.xyz / clip.w;
+        uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+        uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+        min_z = min(min_z, ndc.z);
+    }
+
+    uv_min = clamp(uv_min, 0.0, 1.0);
+    uv_max = clamp(uv_max, 0.0, 1.0);
+
+    // pick the mip where the rectangle covers at most 2x2 texels
+    f32vec2 size = (uv_max - uv_min) * f32vec2(CULL_INFO.hiz_size);
+    i32 mip = clamp(i32(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, i32(CULL_INFO.hiz_mip_count) - 1);
+
+    // each texel covers two of the level below and the last one also takes the leftover row or column of an odd size,
+    // so the covered pixels are walked down level by level instead of scaling the uvs, which would drift off that folding
+    i32vec2 render_size = i32vec2(CULL_INFO.render_size);
+    i32vec2 texel_min = clamp(i32vec2(uv_min * f32vec2(render_size)), i32vec2(0), render_size - 1);
+    i32vec2 texel_max = clamp(i32vec2(uv_max * f32vec2(render_size)), i32vec2(0), render_size - 1);
+    for(i32 level = 0; level < i32(CULL_INFO.hiz_mip_count); level++) {
+        i32vec2 level_size = max(i32vec2(CULL_INFO.hiz_size) >> level, i32vec2(1));
+        texel_min = min(texel_min / 2, level_size - 1);
+        texel_max = min(texel_max / 2, level_size - 1);
+        // the pixel rounding can leave three texels at the estimated mip, the corners alone would skip the middle one
+        if(level >= mip && all(lessThanEqual(texel_max - texel_min, i32vec2(1)))) { mip = level; break; }
+    }
+
+    f32 max_depth = max(
+        max(texelFetch(daxa_push_constant.hiz, texel_min, mip).r, texelFetch(daxa_push_constant.hiz, i32vec2(texel_max.x, texel_min.y), mip).r),
+        max(texelFetch(daxa_push_constant.hiz, i32vec2(texel_min.x, texel_max.y), mip).r, texelFetch(daxa_push_constant.hiz, texel_max, mip).r)
+    );
+
+    return min_z <= max_depth;
+}
+
+// appends the instance to its command, the command's instance range was reserved for every instance it could draw
+void emit(u32 draw_index, DrawData draw_data) {
+    u32 slot = atomicAdd(deref(daxa_push_constant.culled_commands[draw_data.command_index]).instance_count, 1);
+    u32 first_instance = deref(daxa_push_constant.commands[draw_data.command_index]).first_instance;
+    deref(daxa_push_constant.culled_instances[first_instance + slot]).draw_index = draw_index;
+}
+
+layout(local_size_x = 64) in;
+void main() {
+    u32 index = gl_GlobalInvocationID.x;
+    if(index >= CULL_INFO.instance_count) { return; }
+
+    DrawData draw_data = deref(daxa_push_constant.draw_data[index]);
+    f32mat4x4 model_matrix = deref(draw_data.transform_buffer).model_matrix;
+
+    f32vec3 center = (draw_data.aabb_max + draw_data.aabb_min) * 0.5;
+    f32vec3 extent = (draw_data.aabb_max - draw_data.aabb_min) * 0.5;
+    f32vec3 world_center = (model_matrix * f32vec4(center, 1.0)).xyz;
+    f32vec3 world_extent = abs(model_matrix[0].xyz) * extent.x + abs(model_matrix[1].xyz) * extent.y + abs(model_matrix[2].xyz) * extent.z;
+
+    if(daxa_push_constant.phase == CULL_PHASE_FRUSTUM) {
+        if(frustum_test(world_center, world_extent)) { emit(index, draw_data); }
+        return;
+    }
+
+    bool was_visible = deref(daxa_push_constant.visibility[draw_data.visibility_slot]).visible == 1;
+
+    if(daxa_push_constant.phase == CULL_PHASE_EARLY) {
+        if(was_visible && frustum_test(world_center, world_extent)) { emit(index, draw_data); }
+        return;
+    }
+
+    bool visible = frustum_test(world_center, world_extent) && occlusion_test(world_center, world_extent);
+    deref(daxa_push_constant.visibility[draw_data.visibility_slot]).visible = visible ? 1 : 0;
+
+    // everything that was visible last frame has already been drawn by the early phase
+    if(visible && !was_visible) { emit(index, draw_data); }
+}
@@ -5,10 +5,8 @@
 
 #define sample_texture(tex, uv) texture(tex.texture_id, tex.sampler_id, uv)
 
-#define MATERIAL deref(daxa_push_constant.material_buffer[daxa_push_constant.material_index])
 #define LIGHTS_BUFFER deref(daxa_push_constant.light_buffer)
 #define CAMERA deref(daxa_push_constant.camera_info)
-#define TRANSFORM deref(daxa_push_constant.transform_buffer)
 #define VERTEX deref(daxa_push_constant.vertex_buffer[gl_VertexIndex])
 
 
@@ -19,8 +17,14 @@ DAXA_USE_PUSH_CONSTANT(DrawPush)
 layout(location = 0) out f32vec2 out_uv;
 layout(location = 1) out f32vec3 out_position;
 layout(location = 2) out f32vec3 out_normal;
+layout(location = 3) flat out u32 out_material_index;
+layout(location = 4) out f32vec4 out_current_clip;
+layout(location = 5) out f32vec4 out_previous_clip;
 
 void main() {
+    out_material_index = DRAW_DATA.material_index;
+    out_current_clip = CAMERA.unjittered_view_projection * TRANSFORM.model_matrix * f32vec4(VERTEX.position, 1.0);
+    out_previous_clip = CAMERA.previous_view_projection * TRANSFORM.previous_model_matrix * f32vec4(VERTEX.position, 1.0);
     out_normal = f32mat3x3(TRANSFORM.normal_matrix) * VERTEX.normal;
     out_uv = VERTEX.uv;
     out_position = (TRANSFORM.model_matrix * f32vec4(VERTEX.position, 1.0)).xyz;
@@ -29,15 +33,26 @@ void main() {
 
 #elif defined(DRAW_FRAG)
 
+// set per pipeline to the MATERIAL_FEATURE bits of the materials it draws
+#if !defined(MATERIAL_FEATURES)
+#define MATERIAL_FEATURES 0
+#endif
+
 layout(location = 0) in f32vec2 in_uv;
 layout(location = 1) in f32vec3 in_position;
 layout(location = 2) in f32vec3 in_normal;
+layout(location = 3) flat in u32 in_material_index;
+layout(location = 4) in f32vec4 in_current_clip;
+layout(location = 5) in f32vec4 in_previous_clip;
+
+#define MATERIAL deref(daxa_push_constant.material_buffer[in_material_index])
 
 layout(location = 0) out f32vec4 out_albedo;
-layout(location = 1) out f32vec4 out_normal;
+layout(location = 1) out f32vec2 out_normal;
+layout(location = 2) out f32vec2 out_velocity;
 
-f32vec3 apply_normal_mapping(TextureId normal_map, f32vec3 position, f32vec3 normal, f32vec2 uv) {
-    f32vec3 tangent_normal = sample_texture(normal_map, uv).xyz * 2.0 - 1.0;
+f32vec3 apply_normal_mapping(daxa_Image2Df32 normal_map, f32vec3 position, f32vec3 normal, f32vec2 uv) {
+    f32vec3 tangent_normal = texture(normal_map, MATERIAL.sampler, uv).xyz * 2.0 - 1.0;
 
     f32vec3 Q1  = dFdx(position);
     f32vec3 Q2  = dFdy(position);
@@ -55,18 +70,19 @@ f32vec3 apply_normal_mapping(TextureId normal_map, f32vec3 position, f32vec3 nor
 
 void main() {
     f32vec3 color = f32vec3(1.0);
-    if(MATERIAL.has_albedo_texture == 1) {
-        color = sample_texture(MATERIAL.albedo_texture, in_uv).rgb;
-    }
+#if (MATERIAL_FEATURES & MATERIAL_FEATURE_ALBEDO_TEXTURE) != 0
+    color = texture(MATERIAL.albedo_texture, MATERIAL.sampler, in_uv).rgb;
+#endif
 
     out_albedo = f32vec4(color, 1.0);
 
     f32vec3 normal = normalize(in_normal);
-    if(MATERIAL.has_normal_map_texture == 1) {
-        normal = apply_normal_mapping(MATERIAL.normal_map_texture, in_position, normal, in_uv);
-    }
+#if (MATERIAL_FEATURES & MATERIAL_FEATURE_NORMAL_MAP) != 0
+    normal = apply_normal_mapping(MATERIAL.normal_map_texture, in_position, normal, in_uv);
+#endif
 
-    out_normal = f32vec4(normal, 1.0);
+    out_normal = encode_normal(normal);
+    out_velocity = motion_vector(in_current_clip, in_previous_clip);
 }
 
 #endif
\ No newline at end of file
@@ -110,8 +110,8 @@ f32vec3 calculate_spot_light(SpotLight light, f32vec3 frag_color, f32vec3 normal
     return frag_color * light.color * ((diffuse + exp(exponent)) * shadow) * attenuation * light.intensity * intensity;
 }
 
-f32vec3 apply_normal_mapping(TextureId normal_map, f32vec3 position, f32vec3 normal, f32vec2 uv) {
-    f32vec3 tangent_normal = sample_texture(normal_map, uv).xyz * 2.0 - 1.0;
+f32vec3 apply_normal_mapping(daxa_Image2Df32 normal_map, f32vec3 position, f32vec3 normal, f32vec2 uv) {
+    f32vec3 tangent_normal = texture(normal_map, MATERIAL.sampler, uv).xyz * 2.0 - 1.0;
 
     f32vec3 Q1  = dFdx(in_position);
     f32vec3 Q2  = dFdy(in_position);
@@ -128,7 +128,7 @@ f32vec3 apply_normal_mapping(TextureId normal_map, f32vec3 position, f32vec3 nor
 }
 
 void main() {
-    f32vec3 tex_col = sample_texture(MATERIAL.albedo_texture, in_uv).rgb;
+    f32vec3 tex_col = texture(MATERIAL.albedo_texture, MATERIAL.sampler, in_uv).rgb;
 
     f32vec3 ambient = f32vec3(0.05);
     
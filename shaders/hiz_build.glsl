@@ -0,0 +1,27 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(HiZPush)
+
+layout(local_size_x = 16, local_size_y = 16) in;
+void main() {
+    u32vec2 texel = gl_GlobalInvocationID.xy;
+    if(any(greaterThanEqual(texel, daxa_push_constant.dst_size))) { return; }
+
+    i32vec2 src_texel = i32vec2(texel * 2);
+    i32vec2 src_max = i32vec2(daxa_push_constant.src_size) - 1;
+
+    // odd source sizes fold the leftover row / column into the last destination texel
+    i32vec2 footprint = i32vec2(2) + i32vec2(equal(texel, daxa_push_constant.dst_size - 1)) * (i32vec2(daxa_push_constant.src_size) & 1);
+
+    f32 depth = 0.0;
+    for(i32 y = 0; y < footprint.y; y++) {
+        for(i32 x = 0; x < footprint.x; x++) {
+            depth = max(depth, texelFetch(daxa_push_constant.src, min(src_texel + i32vec2(x, y), src_max), 0).r);
+        }
+    }
+
+    imageStore(daxa_push_constant.dst, i32vec2(texel), f32vec4(depth));
+}
@@ -0,0 +1,80 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(LightClusterPush)
+
+#define LIGHTS_BUFFER deref(daxa_push_constant.light_buffer)
+#define CAMERA deref(daxa_push_constant.camera_info)
+
+f32 slice_depth(u32 slice) {
+    return daxa_push_constant.z_near * pow(daxa_push_constant.z_far / daxa_push_constant.z_near, f32(slice) / f32(LIGHT_CLUSTER_Z));
+}
+
+// point on the view ray through ndc at a view space distance along -z
+f32vec3 view_ray_at(f32vec2 ndc, f32 depth) {
+    f32vec4 p = CAMERA.inverse_projection_matrix * f32vec4(ndc, 1.0, 1.0);
+    p.xyz /= p.w;
+    return p.xyz * (depth / -p.z);
+}
+
+bool sphere_intersects_aabb(f32vec3 center, f32 radius, f32vec3 aabb_min, f32vec3 aabb_max) {
+    f32vec3 closest = clamp(center, aabb_min, aabb_max);
+    f32vec3 d = center - closest;
+    return dot(d, d) <= radius * radius;
+}
+
+layout(local_size_x = 64) in;
+void main() {
+    u32 index = gl_GlobalInvocationID.x;
+    if(index >= LIGHT_CLUSTER_COUNT) { return; }
+
+    u32vec3 cluster = u32vec3(index % LIGHT_CLUSTER_X, (index / LIGHT_CLUSTER_X) % LIGHT_CLUSTER_Y, index / (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y));
+    f32vec2 cluster_dim = f32vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y);
+    f32vec2 ndc_min = f32vec2(cluster.xy) / cluster_dim * 2.0 - 1.0;
+    f32vec2 ndc_max = f32vec2(cluster.xy + 1) / cluster_dim * 2.0 - 1.0;
+
+    f32 near_depth = slice_depth(cluster.z);
+    f32 far_depth = slice_depth(cluster.z + 1);
+
+    f32vec3 a = view_ray_at(ndc_min, near_depth);
+    f32vec3 b = view_ray_at(ndc_max, near_depth);
+    f32vec3 c = view_ray_at(ndc_min, far_depth);
+    f32vec3 d = view_ray_at(ndc_max, far_depth);
+    f32vec3 aabb_min = min(min(a, b), min(c, d));
+    f32vec3 aabb_max = max(max(a, b), max(c, d));
+
+    u32 count = 0;
+    u32 point_count = 0;
+    for(i32 i = 0; i < LIGHTS_BUFFER.num_point_lights && count < MAX_LIGHTS_PER_CLUSTER; i++) {
+        PointLight light = LIGHTS_BUFFER.point_lights[i];
+        f32vec3 center = (CAMERA.view_matrix * f32vec4(light.position, 1.0)).xyz;
+        if(sphere_intersects_aabb(center, light.radius, aabb_min, aabb_max)) {
+            deref(daxa_push_constant.clusters[index]).light_indices[count++] = i;
+            point_count++;
+        }
+    }
+
+    u32 spot_count = 0;
+    for(i32 i = 0; i < LIGHTS_BUFFER.num_spot_lights && count < MAX_LIGHTS_PER_CLUSTER; i++) {
+        SpotLight light = LIGHTS_BUFFER.spot_lights[i];
+        f32vec3 position = (CAMERA.view_matrix * f32vec4(light.position, 1.0)).xyz;
+        f32vec3 direction = normalize((CAMERA.view_matrix * f32vec4(light.direction, 0.0)).xyz);
+
+        // bounding sphere of the cone, wide cones fall back to the whole range
+        f32vec3 center = position;
+        f32 radius = light.radius;
+        if(light.outer_cut_off > 0.70710678) {
+            radius = light.radius / (2.0 * light.outer_cut_off);
+            center = position + direction * radius;
+        }
+
+        if(sphere_intersects_aabb(center, radius, aabb_min, aabb_max)) {
+            deref(daxa_push_constant.clusters[index]).light_indices[count++] = i;
+            spot_count++;
+        }
+    }
+
+    deref(daxa_push_constant.clusters[index]).point_count = point_count;
+    deref(daxa_push_constant.clusters[index]).spot_count = spot_count;
+}
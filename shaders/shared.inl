@@ -6,36 +6,120 @@ struct TextureId {
     daxa_SamplerId sampler_id;
 };
 
+// an entry of the material registry's global table, every texture of it is read through the one sampler
 struct MaterialInfo {
-    TextureId albedo_texture;
+    daxa_Image2Df32 albedo_texture;
     daxa_f32vec4 albedo_factor;
     daxa_u32 has_albedo_texture;
-    TextureId metallic_texture;
+    daxa_Image2Df32 metallic_texture;
     daxa_f32 metallic_factor;
     daxa_u32 has_metallic_texture;
-    TextureId roughness_texture;
+    daxa_Image2Df32 roughness_texture;
     daxa_f32 roughness_factor;
     daxa_u32 has_roughness_texture;
     daxa_u32 has_metallic_roughness_combined;
-    TextureId normal_map_texture;
+    daxa_Image2Df32 normal_map_texture;
     daxa_u32 has_normal_map_texture;
+    daxa_SamplerId sampler;
 };
 
+// the optional inputs the g-buffer pass reads, it has a pipeline for every combination so no fragment branches on them
+#define MATERIAL_FEATURE_ALBEDO_TEXTURE 1
+#define MATERIAL_FEATURE_NORMAL_MAP 2
+#define MATERIAL_PERMUTATION_COUNT 4
+
 DAXA_ENABLE_BUFFER_PTR(MaterialInfo)
 
 struct TransformInfo {
     daxa_f32mat4x4 model_matrix;
     daxa_f32mat4x4 normal_matrix;
+    // last frame's model matrix, equal to model_matrix once the entity stopped moving
+    daxa_f32mat4x4 previous_model_matrix;
 };
 
 DAXA_ENABLE_BUFFER_PTR(TransformInfo)
 
+struct DrawIndexedIndirectCommand {
+    daxa_u32 index_count;
+    daxa_u32 instance_count;
+    daxa_u32 first_index;
+    daxa_i32 vertex_offset;
+    daxa_u32 first_instance;
+};
+
+DAXA_ENABLE_BUFFER_PTR(DrawIndexedIndirectCommand)
+
+struct Vertex {
+    daxa_f32vec3 position;
+    daxa_f32vec2 uv;
+    daxa_f32vec3 normal;
+    daxa_f32vec3 tangent;
+};
+
+DAXA_ENABLE_BUFFER_PTR(Vertex)
+
+struct Index {
+    daxa_u32 value;
+};
+
+DAXA_ENABLE_BUFFER_PTR(Index)
+
+struct DrawData {
+    daxa_BufferPtr(TransformInfo) transform_buffer;
+    // into the global material table
+    daxa_u32 material_index;
+    // the instanced command drawing this model primitive, culling appends the instance to it
+    daxa_u32 command_index;
+    daxa_f32vec3 aabb_min;
+    daxa_f32vec3 aabb_max;
+    // the model's geometry, so the visibility buffer resolve can refetch a triangle from its ids
+    daxa_BufferPtr(Vertex) vertex_buffer;
+    daxa_BufferPtr(Index) index_buffer;
+    daxa_u32 first_index;
+    daxa_i32 vertex_offset;
+    // stays with the same entity and primitive from frame to frame however the draws get sorted, indexes the occlusion history
+    daxa_u32 visibility_slot;
+};
+
+DAXA_ENABLE_BUFFER_PTR(DrawData)
+
+// one per drawn instance, gl_InstanceIndex picks the entry and the entry picks the draw data
+struct DrawInstance {
+    daxa_u32 draw_index;
+};
+
+DAXA_ENABLE_BUFFER_PTR(DrawInstance)
+
+struct DrawVisibility {
+    daxa_u32 visible;
+};
+
+DAXA_ENABLE_BUFFER_PTR(DrawVisibility)
+
+struct FrustumCullInfo {
+    daxa_f32vec4 planes[6];
+    daxa_f32mat4x4 view_projection;
+    daxa_u32vec2 render_size;
+    daxa_u32vec2 hiz_size;
+    daxa_u32 hiz_mip_count;
+    daxa_u32 instance_count;
+};
+
+DAXA_ENABLE_BUFFER_PTR(FrustumCullInfo)
+
+#define CULL_PHASE_FRUSTUM 0
+#define CULL_PHASE_EARLY 1
+#define CULL_PHASE_LATE 2
+
 struct CameraInfo {
     daxa_f32mat4x4 projection_matrix;
     daxa_f32mat4x4 inverse_projection_matrix;
     daxa_f32mat4x4 view_matrix;
     daxa_f32mat4x4 inverse_view_matrix;
     daxa_f32vec3 position;
+    // projection * view without the temporal upscaling jitter, for this and the previous frame. motion vectors come from these
+    daxa_f32mat4x4 unjittered_view_projection;
+    daxa_f32mat4x4 previous_view_projection;
 };
 
 DAXA_ENABLE_BUFFER_PTR(CameraInfo)
@@ -45,6 +129,7 @@ struct DirectionalLight {
     daxa_f32vec3 color;
     daxa_f32 intensity;
     TextureId shadow_image;
+    daxa_f32vec4 shadow_rect;
     daxa_f32mat4x4 light_matrix;
 };
 
@@ -52,6 +137,7 @@ struct PointLight {
     daxa_f32vec3 position;
     daxa_f32vec3 color;
     daxa_f32 intensity;
+    daxa_f32 radius;
 };
 
 struct SpotLight {
@@ -61,7 +147,9 @@ struct SpotLight {
     daxa_f32 intensity;
     daxa_f32 cut_off;
     daxa_f32 outer_cut_off;
+    daxa_f32 radius;
     TextureId shadow_image;
+    daxa_f32vec4 shadow_rect;
     daxa_f32mat4x4 light_matrix;
 };
 
@@ -77,14 +165,29 @@ struct LightBuffer {
 
 DAXA_ENABLE_BUFFER_PTR(LightBuffer)
 
-struct Vertex {
-    daxa_f32vec3 position;
-    daxa_f32vec2 uv;
-    daxa_f32vec3 normal;
-    daxa_f32vec3 tangent;
+// froxels: screen tiles split into exponentially spaced depth slices
+#define LIGHT_CLUSTER_X 16
+#define LIGHT_CLUSTER_Y 9
+#define LIGHT_CLUSTER_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 64
+
+// point light indices come first, spot light indices follow them
+struct LightCluster {
+    daxa_u32 point_count;
+    daxa_u32 spot_count;
+    daxa_u32 light_indices[MAX_LIGHTS_PER_CLUSTER];
 };
 
-DAXA_ENABLE_BUFFER_PTR(Vertex)
+DAXA_ENABLE_BUFFER_PTR(LightCluster)
+
+struct LightClusterPush {
+    daxa_BufferPtr(LightBuffer) light_buffer;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_RWBufferPtr(LightCluster) clusters;
+    daxa_f32 z_near;
+    daxa_f32 z_far;
+};
 
 struct _Vertex {
     daxa_f32vec3 position;
@@ -101,8 +204,8 @@ struct TexturePush {
 struct DrawPush {
     daxa_BufferPtr(Vertex) vertex_buffer;
     daxa_BufferPtr(MaterialInfo) material_buffer;
-    daxa_i32 material_index;
-    daxa_BufferPtr(TransformInfo) transform_buffer;
+    daxa_BufferPtr(DrawData) draw_data_buffer;
+    daxa_BufferPtr(DrawInstance) instance_buffer;
     daxa_BufferPtr(LightBuffer) light_buffer;
     daxa_BufferPtr(CameraInfo) camera_info;
 };
@@ -110,7 +213,8 @@ struct DrawPush {
 struct DepthPrepassPush {
     daxa_BufferPtr(CameraInfo) camera_info;
     daxa_BufferPtr(Vertex) vertex_buffer;
-    daxa_BufferPtr(TransformInfo) transform_buffer;
+    daxa_BufferPtr(DrawData) draw_data_buffer;
+    daxa_BufferPtr(DrawInstance) instance_buffer;
 };
 
 struct BillboardPush {
@@ -126,17 +230,78 @@ struct CompositionPush {
     TextureId ssao;
     daxa_RWBufferPtr(LightBuffer) light_buffer;
     daxa_RWBufferPtr(CameraInfo) camera_info;
+    daxa_BufferPtr(LightCluster) clusters;
+    daxa_f32 z_near;
+    daxa_f32 z_far;
     daxa_f32 ambient;
+    // only read by the visibility buffer permutation, which resolves albedo and normal from it instead of the g-buffer
+    daxa_Image2Du32 visibility;
+    daxa_BufferPtr(DrawData) draw_data_buffer;
+    daxa_BufferPtr(MaterialInfo) material_buffer;
+    // the targets are viewport sized but only this fraction of them is rendered to under dynamic resolution
+    daxa_f32vec2 uv_scale;
 };
 
+#define SSAO_TILE_SIZE 8
+#define SSAO_KERNEL_SIZE 26
+
+// runs at half resolution, src_size is the full resolution of the g-buffer
 struct SSAOGenerationPush {
-    TextureId normal;
-    TextureId depth;
-    daxa_RWBufferPtr(CameraInfo) camera_info;
+    daxa_Image2Df32 normal;
+    daxa_Image2Df32 depth;
+    daxa_Image2Df32 blue_noise;
+    daxa_RWImage2Df32 ssao;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_u32vec2 src_size;
+    daxa_u32vec2 dst_size;
+    daxa_u32 sample_count;
+    daxa_f32 radius;
+    daxa_u32 frame_index;
+    daxa_Image2Du32 visibility;
+    daxa_BufferPtr(DrawData) draw_data_buffer;
+    daxa_BufferPtr(MaterialInfo) material_buffer;
 };
 
-struct SSAOBlurPush {
-    TextureId ssao;
+// accumulates the half resolution ao over frames, history keeps (ao, linear depth) for rejection
+struct SSAOTemporalPush {
+    daxa_Image2Df32 ssao;
+    daxa_Image2Df32 depth;
+    TextureId history;
+    daxa_RWImage2Df32 dst;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_f32mat4x4 previous_view_projection;
+    daxa_u32vec2 src_size;
+    daxa_u32vec2 dst_size;
+    daxa_f32 blend;
+    daxa_u32 history_valid;
+    // part of the history image last frame rendered to, the render resolution can change between frames
+    daxa_f32vec2 history_uv_scale;
+};
+
+struct SSAOUpsamplePush {
+    daxa_Image2Df32 ssao;
+    daxa_Image2Df32 depth;
+    daxa_RWImage2Df32 dst;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_u32vec2 src_size;
+    daxa_u32vec2 dst_size;
+};
+
+#define TEMPORAL_UPSCALE_JITTER_PHASES 8
+
+// reconstructs the viewport sized image from the jittered low resolution render, history is at output resolution
+struct TemporalUpscalePush {
+    daxa_Image2Df32 color;
+    daxa_Image2Df32 depth;
+    daxa_Image2Df32 velocity;
+    TextureId history;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_u32vec2 render_size;
+    daxa_u32vec2 output_size;
+    // sub pixel offset of this frame's projection, in render pixels
+    daxa_f32vec2 jitter;
+    daxa_f32 blend;
+    daxa_u32 history_valid;
 };
 
 struct SimpleVertex {
@@ -145,22 +310,61 @@ struct SimpleVertex {
 
 DAXA_ENABLE_BUFFER_PTR(SimpleVertex)
 
-struct SkyPush {
-    daxa_RWBufferPtr(Vertex) vertex_buffer;
-    daxa_f32mat4x4 model_matrix;
-    daxa_f32vec3 sun_position;
-    daxa_RWBufferPtr(CameraInfo) camera_info;
+// shared by the lut passes and the sky draw, dst is the lut being written
+struct AtmospherePush {
+    daxa_Image2Df32 transmittance_lut;
+    daxa_Image2Df32 multiple_scattering_lut;
+    daxa_Image2Df32 sky_view_lut;
+    daxa_RWImage2Df32 dst;
+    daxa_SamplerId lut_sampler;
+    daxa_BufferPtr(CameraInfo) camera_info;
+    daxa_f32vec3 sun_direction;
+    daxa_f32 camera_height;
+    daxa_u32vec2 dst_size;
 };
 
 struct ShadowPush {
     daxa_f32mat4x4 light_matrix;
     daxa_RWBufferPtr(Vertex) vertex_buffer;
-    daxa_RWBufferPtr(TransformInfo) transform_buffer;
+    daxa_RWBufferPtr(DrawData) draw_data_buffer;
+    daxa_BufferPtr(DrawInstance) instance_buffer;
+};
+
+#define VSM_BLUR_TILE_SIZE 16
+#define VSM_BLUR_RADIUS 3
+
+// blurs one atlas tile of raw moments into the same tile of the filtered atlas
+struct VSMBlurPush {
+    daxa_Image2Df32 src;
+    daxa_RWImage2Df32 dst;
+    daxa_u32vec2 tile_offset;
+    daxa_u32 tile_size;
+};
+
+// averages one tile of a moment mip into the next, offset and size are in the destination mip
+struct VSMDownsamplePush {
+    daxa_Image2Df32 src;
+    daxa_RWImage2Df32 dst;
+    daxa_u32vec2 tile_offset;
+    daxa_u32 tile_size;
+};
+
+struct CullPush {
+    daxa_BufferPtr(FrustumCullInfo) cull_info;
+    daxa_BufferPtr(DrawIndexedIndirectCommand) commands;
+    daxa_BufferPtr(DrawData) draw_data;
+    daxa_RWBufferPtr(DrawIndexedIndirectCommand) culled_commands;
+    daxa_RWBufferPtr(DrawInstance) culled_instances;
+    daxa_RWBufferPtr(DrawVisibility) visibility;
+    daxa_Image2Df32 hiz;
+    daxa_u32 phase;
 };
 
-struct GaussPush {
-    TextureId src_texture;
-    daxa_f32vec2 blur_scale;
+struct HiZPush {
+    daxa_Image2Df32 src;
+    daxa_RWImage2Df32 dst;
+    daxa_u32vec2 src_size;
+    daxa_u32vec2 dst_size;
 };
 
 struct LinesPush {
@@ -170,8 +374,33 @@ struct LinesPush {
 
 #define sample_texture(tex, uv) texture(tex.texture_id, tex.sampler_id, uv)
 
-#define MATERIAL deref(daxa_push_constant.material_buffer[daxa_push_constant.material_index])
+#if DAXA_SHADER
+// g-buffer normals are octahedral encoded into two snorm channels (Cigolle et al. 2014)
+daxa_f32vec2 octahedral_wrap(daxa_f32vec2 v) {
+    return (1.0 - abs(v.yx)) * mix(daxa_f32vec2(-1.0), daxa_f32vec2(1.0), greaterThanEqual(v, daxa_f32vec2(0.0)));
+}
+
+daxa_f32vec2 encode_normal(daxa_f32vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : octahedral_wrap(n.xy);
+}
+
+// screen space motion in uv units from this frame's and last frame's unjittered clip positions
+daxa_f32vec2 motion_vector(daxa_f32vec4 current_clip, daxa_f32vec4 previous_clip) {
+    return (current_clip.xy / current_clip.w - previous_clip.xy / previous_clip.w) * 0.5;
+}
+
+daxa_f32vec3 decode_normal(daxa_f32vec2 e) {
+    daxa_f32vec3 n = daxa_f32vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    daxa_f32 t = max(-n.z, 0.0);
+    n.xy += mix(daxa_f32vec2(t), daxa_f32vec2(-t), greaterThanEqual(n.xy, daxa_f32vec2(0.0)));
+    return normalize(n);
+}
+#endif
+
 #define LIGHT_BUFFER deref(daxa_push_constant.light_buffer)
 #define CAMERA deref(daxa_push_constant.camera_info)
-#define TRANSFORM deref(daxa_push_constant.transform_buffer)
+#define DRAW_INDEX deref(daxa_push_constant.instance_buffer[gl_InstanceIndex]).draw_index
+#define DRAW_DATA deref(daxa_push_constant.draw_data_buffer[DRAW_INDEX])
+#define TRANSFORM deref(DRAW_DATA.transform_buffer)
 #define VERTEX deref(daxa_push_constant.vertex_buffer[gl_VertexIndex])
\ No newline at end of file
@@ -4,18 +4,14 @@
 
 DAXA_USE_PUSH_CONSTANT(SSAOGenerationPush)
 
-#define sample_texture(tex, uv) texture(tex.texture_id, tex.sampler_id, uv)
-#define texture_size(tex, mip) textureSize(tex.texture_id, mip)
-
-#define MATERIAL deref(daxa_push_constant.material_buffer[daxa_push_constant.material_index])
-#define LIGHTS_BUFFER deref(daxa_push_constant.light_buffer)
 #define CAMERA deref(daxa_push_constant.camera_info)
-#define TRANSFORM deref(daxa_push_constant.transform_buffer)
-#define VERTEX deref(daxa_push_constant.vertex_buffer[gl_VertexIndex])
 
-#define KERNEL_SIZE 26
+#if defined(VISIBILITY_BUFFER)
+#include "visibility_resolve.glsl"
+#endif
 
-const f32vec3 kernelSamples[KERNEL_SIZE] = { // HIGH (26 samples)
+// frames walk through it sample_count entries at a time
+const f32vec3 kernel_samples[SSAO_KERNEL_SIZE] = {
         f32vec3(0.2196607,0.9032637,0.2254677),
         f32vec3(0.05916681,0.2201506,0.1430302),
         f32vec3(-0.4152246,0.1320857,0.7036734),
@@ -44,119 +40,99 @@ const f32vec3 kernelSamples[KERNEL_SIZE] = { // HIGH (26 samples)
         f32vec3(0.2448421,-0.1610962,0.1289366)
     };
 
-#define SSAO_RADIUS 0.3
-
-#if defined(DRAW_VERT)
+// samples that project back into the workgroup's tile plus this many texels read depth from shared memory
+#define SSAO_APRON 4
+#define SSAO_SHARED_SIZE (SSAO_TILE_SIZE + 2 * SSAO_APRON)
 
-layout(location = 0) out f32vec2 out_uv;
+shared f32 tile_depth[SSAO_SHARED_SIZE * SSAO_SHARED_SIZE];
 
-void main() {
-    out_uv = f32vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
-	gl_Position = f32vec4(out_uv * 2.0f - 1.0f, 0.0f, 1.0f);
+// distance along -z from the depth buffer, without going through the inverse projection
+f32 linear_depth(f32 depth) {
+    return CAMERA.projection_matrix[3][2] / (depth + CAMERA.projection_matrix[2][2]);
 }
 
-#elif defined(DRAW_FRAG)
-
-f32vec3 get_world_position_from_depth(f32vec2 uv, f32 depth) {
-    f32vec4 clipSpacePosition = f32vec4(uv * 2.0 - 1.0, depth, 1.0);
-    f32vec4 viewSpacePosition = CAMERA.inverse_projection_matrix * clipSpacePosition;
-
-    viewSpacePosition /= viewSpacePosition.w;
-    f32vec4 worldSpacePosition = CAMERA.inverse_view_matrix * viewSpacePosition;
-
-    return worldSpacePosition.xyz;
+i32vec2 full_res_texel(i32vec2 texel) {
+    return clamp(texel * 2, i32vec2(0), i32vec2(daxa_push_constant.src_size) - 1);
 }
 
-f32vec3 get_view_position_from_depth(f32vec2 uv, f32 depth) {
-    f32vec4 clipSpacePosition = f32vec4(uv * 2.0 - 1.0, depth, 1.0);
-    f32vec4 viewSpacePosition = CAMERA.inverse_projection_matrix * clipSpacePosition;
-
-    viewSpacePosition /= viewSpacePosition.w;
-
-    return viewSpacePosition.xyz;
+f32 fetch_linear_depth(i32vec2 texel) {
+    return linear_depth(texelFetch(daxa_push_constant.depth, full_res_texel(texel), 0).r);
 }
 
-f32 rand(f32vec2 c) {
-	return fract(sin(dot(c.xy, f32vec2(12.9898, 78.233))) * 43758.5453);
+f32vec3 view_position(f32vec2 uv, f32 distance) {
+    f32vec2 ndc = uv * 2.0 - 1.0;
+    return f32vec3(ndc.x * distance / CAMERA.projection_matrix[0][0], ndc.y * distance / CAMERA.projection_matrix[1][1], -distance);
 }
 
-f32 noise(f32vec2 p, f32 freq) {
-	f32 unit = 2560 / freq;
-	f32vec2 ij = floor(p / unit);
-	f32vec2 xy = mod(p, unit) / unit;
-	xy = .5 * (1. - cos(3.14159265359 * xy));
-	f32 a = rand((ij + f32vec2(0., 0.)));
-	f32 b = rand((ij + f32vec2(1., 0.)));
-	f32 c = rand((ij + f32vec2(0., 1.)));
-	f32 d = rand((ij + f32vec2(1., 1.)));
-	f32 x1 = mix(a, b, xy.x);
-	f32 x2 = mix(c, d, xy.x);
-	return mix(x1, x2, xy.y);
-}
-
-f32 pNoise(f32vec2 p, i32 res) {
-	f32 persistance = .5;
-	f32 n = 0.;
-	f32 normK = 0.;
-	f32 f = 4.;
-	f32 amp = 1.;
-	i32 iCount = 0;
-	for (i32 i = 0; i < 50; i++) {
-		n += amp * noise(p, f);
-		f *= 2.;
-		normK += amp;
-		amp *= persistance;
-		if (iCount == res) break;
-		iCount++;
-	}
-	f32 nf = n / normK;
-	return nf * nf * nf * nf;
-}
-
-layout(location = 0) in f32vec2 in_uv;
-
-layout (location = 0) out f32 out_ssao;
-
+layout(local_size_x = SSAO_TILE_SIZE, local_size_y = SSAO_TILE_SIZE) in;
 void main() {
-  
-    f32vec3 frag_position = get_view_position_from_depth(in_uv, sample_texture(daxa_push_constant.depth, in_uv).r);
-	f32vec3 normal = mat3x3(CAMERA.view_matrix) *  normalize(sample_texture(daxa_push_constant.normal, in_uv).rgb);
-
-	ivec2 tex_dim = texture_size(daxa_push_constant.normal, 0); 
-	ivec2 noise_dim = texture_size(daxa_push_constant.normal, 0);
-	const f32vec2 noise_uv = f32vec2(f32(tex_dim.x)/f32(noise_dim.x), f32(tex_dim.y)/(noise_dim.y)) * in_uv;  
-
-    f32vec3 random_vec = normalize(f32vec3(
-        noise(in_uv, noise_dim.x * 2),
-        noise(pow(in_uv, f32vec2(1.1)), pow(noise_dim.x * 4.2, 1.5 + in_uv.x / 10.0)),
-        0.0
-    ));
-
-	f32vec3 tangent = normalize(random_vec - normal * dot(random_vec, normal));
-	f32vec3 bitangent = cross(tangent, normal);
-	mat3 TBN = mat3(tangent, bitangent, normal);
-
-	f32 occlusion = 0.0f;
-	const f32 bias = 0.025f;
-	for(i32 i = 0; i < KERNEL_SIZE; i++) {		
-		f32vec3 sample_pos = TBN * kernelSamples[i].xyz; 
-		sample_pos = frag_position + sample_pos * SSAO_RADIUS; 
-		
-		// project
-		f32vec4 offset = f32vec4(sample_pos, 1.0f);
-		offset = CAMERA.projection_matrix * offset; 
-		offset.xy /= offset.w; 
-		offset.xy = offset.xy * 0.5f + 0.5f; 
-		
-		f32vec3 sample_depth_v = get_view_position_from_depth(offset.xy, sample_texture(daxa_push_constant.depth, offset.xy).r);
-        f32 sample_depth = sample_depth_v.z;
-
-		f32 range_check = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(frag_position.z - sample_depth));
-		occlusion += (sample_depth >= sample_pos.z + bias ? 1.0f : 0.0f) * range_check;           
-	}
-	occlusion = 1.0 - (occlusion / f32(KERNEL_SIZE));
-	
-	out_ssao = occlusion;
+    i32vec2 tile_origin = i32vec2(gl_WorkGroupID.xy) * SSAO_TILE_SIZE - SSAO_APRON;
+    for(u32 i = gl_LocalInvocationIndex; i < SSAO_SHARED_SIZE * SSAO_SHARED_SIZE; i += SSAO_TILE_SIZE * SSAO_TILE_SIZE) {
+        i32vec2 local = i32vec2(i % SSAO_SHARED_SIZE, i / SSAO_SHARED_SIZE);
+        tile_depth[i] = fetch_linear_depth(tile_origin + local);
+    }
+    barrier();
+
+    i32vec2 texel = i32vec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(texel, i32vec2(daxa_push_constant.dst_size)))) { return; }
+
+    f32vec2 src_size = f32vec2(daxa_push_constant.src_size);
+    i32vec2 local = texel - tile_origin;
+    f32 depth = texelFetch(daxa_push_constant.depth, full_res_texel(texel), 0).r;
+    if(depth >= 1.0) {
+        imageStore(daxa_push_constant.ssao, texel, f32vec4(1.0));
+        return;
+    }
+
+    f32vec2 uv = (f32vec2(full_res_texel(texel)) + 0.5) / src_size;
+    f32vec3 frag_position = view_position(uv, tile_depth[local.y * SSAO_SHARED_SIZE + local.x]);
+#if defined(VISIBILITY_BUFFER)
+    VisibilitySurface surface;
+    u32vec2 ids = texelFetch(daxa_push_constant.visibility, full_res_texel(texel), 0).xy;
+    if(!resolve_visibility(ids, uv * 2.0 - 1.0, src_size, CAMERA.projection_matrix * CAMERA.view_matrix, daxa_push_constant.draw_data_buffer, daxa_push_constant.material_buffer, surface)) {
+        imageStore(daxa_push_constant.ssao, texel, f32vec4(1.0));
+        return;
+    }
+    f32vec3 normal = normalize(mat3x3(CAMERA.view_matrix) * surface.normal);
+#else
+    f32vec3 normal = normalize(mat3x3(CAMERA.view_matrix) * decode_normal(texelFetch(daxa_push_constant.normal, full_res_texel(texel), 0).xy));
+#endif
+
+    // blue noise keeps the per pixel kernel rotation free of low frequency clumps, which blurs away far better than white noise,
+    // the golden ratio offset walks every pixel through all rotations over frames for the temporal pass to accumulate
+    i32vec2 noise_size = textureSize(daxa_push_constant.blue_noise, 0);
+    f32 noise = fract(texelFetch(daxa_push_constant.blue_noise, texel % noise_size, 0).r + f32(daxa_push_constant.frame_index) * 0.61803398875);
+    f32 angle = noise * 6.28318530718;
+    f32vec3 random_vec = f32vec3(cos(angle), sin(angle), 0.0);
+
+    f32vec3 tangent = normalize(random_vec - normal * dot(random_vec, normal));
+    f32vec3 bitangent = cross(tangent, normal);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+
+    f32 radius = daxa_push_constant.radius;
+    f32 occlusion = 0.0f;
+    const f32 bias = 0.025f;
+    // each frame takes the next slice of the kernel so the history sees all of it
+    u32 kernel_offset = daxa_push_constant.frame_index * daxa_push_constant.sample_count;
+    for(u32 i = 0; i < daxa_push_constant.sample_count; i++) {
+        f32vec3 sample_pos = frag_position + (TBN * kernel_samples[(kernel_offset + i) % SSAO_KERNEL_SIZE]) * radius;
+
+        f32vec2 sample_ndc = f32vec2(CAMERA.projection_matrix[0][0], CAMERA.projection_matrix[1][1]) * sample_pos.xy / -sample_pos.z;
+        i32vec2 sample_texel = i32vec2(floor((sample_ndc * 0.5 + 0.5) * src_size)) / 2;
+
+        i32vec2 sample_local = sample_texel - tile_origin;
+        f32 sample_distance;
+        if(all(greaterThanEqual(sample_local, i32vec2(0))) && all(lessThan(sample_local, i32vec2(SSAO_SHARED_SIZE)))) {
+            sample_distance = tile_depth[sample_local.y * SSAO_SHARED_SIZE + sample_local.x];
+        } else {
+            sample_distance = fetch_linear_depth(sample_texel);
+        }
+        f32 sample_depth = -sample_distance;
+
+        f32 range_check = smoothstep(0.0f, 1.0f, radius / abs(frag_position.z - sample_depth));
+        occlusion += (sample_depth >= sample_pos.z + bias ? 1.0f : 0.0f) * range_check;
+    }
+    occlusion = 1.0 - (occlusion / f32(daxa_push_constant.sample_count));
+
+    imageStore(daxa_push_constant.ssao, texel, f32vec4(occlusion));
 }
-
-#endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#include <shared.inl>
+
+DAXA_USE_PUSH_CONSTANT(SSAOTemporalPush)
+
+#define CAMERA deref(daxa_push_constant.camera_info)
+
+f32 linear_depth(f32 depth) {
+    return CAMERA.projection_matrix[3][2] / (depth + CAMERA.projection_matrix[2][2]);
+}
+
+layout(local_size_x = SSAO_TILE_SIZE, local_size_y = SSAO_TILE_SIZE) in;
+void main() {
+    i32vec2 texel = i32vec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(texel, i32vec2(daxa_push_constant.dst_size)))) { return; }
+
+    // the same full res texel the generation pass read for this half res texel
+    i32vec2 full_texel = min(texel * 2, i32vec2(daxa_push_constant.src_size) - 1);
+    f32 depth = texelFetch(daxa_push_constant.depth, full_texel, 0).r;
+    f32 distance = linear_depth(depth);
+    f32 ao = texelFetch(daxa_push_constant.ssao, texel, 0).r;
+
+    if(daxa_push_constant.history_valid != 0 && depth < 1.0) {
+        f32vec2 uv = (f32vec2(full_texel) + 0.5) / f32vec2(daxa_push_constant.src_size);
+        f32vec2 ndc = uv * 2.0 - 1.0;
+        f32vec4 view_position = f32vec4(ndc.x * distance / CAMERA.projection_matrix[0][0], ndc.y * distance / CAMERA.projection_matrix[1][1], -distance, 1.0);
+        f32vec4 world_position = CAMERA.inverse_view_matrix * view_position;
+
+        f32vec4 previous_clip = daxa_push_constant.previous_view_projection * world_position;
+        f32vec2 previous_uv = (previous_clip.xy / previous_clip.w) * 0.5 + 0.5;
+
+        if(previous_clip.w > 0.0 && all(greaterThanEqual(previous_uv, f32vec2(0.0))) && all(lessThanEqual(previous_uv, f32vec2(1.0)))) {
+            f32vec2 history = texture(daxa_push_constant.history.texture_id, daxa_push_constant.history.sampler_id, previous_uv * daxa_push_constant.history_uv_scale).rg;
+
+            // w of the previous clip position is this point's distance from last frame's camera, a history
+            // depth that disagrees means the texel saw another surface and the history is dropped
+            f32 depth_error = abs(history.g - previous_clip.w) / previous_clip.w;
+            if(depth_error < 0.05) {
+                ao = mix(history.r, ao, daxa_push_constant.blend);
+            }
+        }
+    }
+
+    imageStore(daxa_push_constant.dst, texel, f32vec4(ao, distance, 0.0, 0.0));
+}
@@ -0,0 +1,60 @@
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#include <shared.inl>
+
+DAXA_USE_PUSH_CONSTANT(SSAOUpsamplePush)
+
+#define CAMERA deref(daxa_push_constant.camera_info)
+
+#define UPSAMPLE_TILE_SIZE 16
+// half res texels a 16x16 full res tile reads with its 4x4 footprint
+#define UPSAMPLE_SHARED_SIZE (UPSAMPLE_TILE_SIZE / 2 + 4)
+
+shared f32 tile_ssao[UPSAMPLE_SHARED_SIZE * UPSAMPLE_SHARED_SIZE];
+shared f32 tile_depth[UPSAMPLE_SHARED_SIZE * UPSAMPLE_SHARED_SIZE];
+
+f32 linear_depth(f32 depth) {
+    return CAMERA.projection_matrix[3][2] / (depth + CAMERA.projection_matrix[2][2]);
+}
+
+layout(local_size_x = UPSAMPLE_TILE_SIZE, local_size_y = UPSAMPLE_TILE_SIZE) in;
+void main() {
+    i32vec2 src_max = i32vec2(daxa_push_constant.src_size) - 1;
+    i32vec2 full_max = i32vec2(daxa_push_constant.dst_size) - 1;
+
+    // the same full res depth texel the generation pass used for each half res texel
+    i32vec2 tile_origin = i32vec2(gl_WorkGroupID.xy) * (UPSAMPLE_TILE_SIZE / 2) - 2;
+    for(u32 i = gl_LocalInvocationIndex; i < UPSAMPLE_SHARED_SIZE * UPSAMPLE_SHARED_SIZE; i += UPSAMPLE_TILE_SIZE * UPSAMPLE_TILE_SIZE) {
+        i32vec2 src_texel = clamp(tile_origin + i32vec2(i % UPSAMPLE_SHARED_SIZE, i / UPSAMPLE_SHARED_SIZE), i32vec2(0), src_max);
+        tile_ssao[i] = texelFetch(daxa_push_constant.ssao, src_texel, 0).r;
+        tile_depth[i] = linear_depth(texelFetch(daxa_push_constant.depth, min(src_texel * 2, full_max), 0).r);
+    }
+    barrier();
+
+    i32vec2 texel = i32vec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(texel, i32vec2(daxa_push_constant.dst_size)))) { return; }
+
+    f32 depth = linear_depth(texelFetch(daxa_push_constant.depth, texel, 0).r);
+    f32vec2 src_position = (f32vec2(texel) + 0.5) * 0.5 - 0.5;
+    i32vec2 base = i32vec2(floor(src_position));
+
+    // 4x4 half res neighbourhood, a gaussian over distance times a weight that drops taps from other surfaces
+    f32 result = 0.0;
+    f32 weight_sum = 0.0;
+    for(i32 y = -1; y <= 2; y++) {
+        for(i32 x = -1; x <= 2; x++) {
+            i32vec2 local = base + i32vec2(x, y) - tile_origin;
+            u32 index = local.y * UPSAMPLE_SHARED_SIZE + local.x;
+
+            f32vec2 offset = f32vec2(base + i32vec2(x, y)) - src_position;
+            f32 spatial = exp(-dot(offset, offset) * 0.5);
+            f32 depth_weight = exp(-abs(tile_depth[index] - depth) / (0.02 * depth + 0.001));
+
+            f32 weight = spatial * depth_weight + 1e-5;
+            result += tile_ssao[index] * weight;
+            weight_sum += weight;
+        }
+    }
+
+    imageStore(daxa_push_constant.dst, texel, f32vec4(pow(result / weight_sum, 3.0)));
+}
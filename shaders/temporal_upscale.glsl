@@ -0,0 +1,157 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(TemporalUpscalePush)
+
+#define CAMERA deref(daxa_push_constant.camera_info)
+
+#if defined(DRAW_VERT)
+
+layout(location = 0) out f32vec2 out_uv;
+
+void main() {
+    out_uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(out_uv * 2.0f - 1.0f, 0.0f, 1.0f);
+}
+
+#elif defined(DRAW_FRAG)
+
+layout(location = 0) in f32vec2 in_uv;
+
+layout(location = 0) out f32vec4 out_history;
+layout(location = 1) out f32vec4 out_color;
+
+f32vec3 rgb_to_ycocg(f32vec3 c) {
+    return f32vec3(dot(c, f32vec3(0.25, 0.5, 0.25)), dot(c, f32vec3(0.5, 0.0, -0.5)), dot(c, f32vec3(-0.25, 0.5, -0.25)));
+}
+
+f32vec3 ycocg_to_rgb(f32vec3 c) {
+    return f32vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// bright samples count for less so a single firefly doesn't get smeared into the history
+f32 luma_weight(f32vec3 ycocg) {
+    return 1.0 / (1.0 + ycocg.x);
+}
+
+f32vec3 fetch_history(f32vec2 uv) {
+    return texture(daxa_push_constant.history.texture_id, daxa_push_constant.history.sampler_id, uv).rgb;
+}
+
+// catmull-rom filtered history folded into 5 bilinear taps, plain bilinear blurs the image a bit more every frame
+f32vec3 sample_history(f32vec2 uv) {
+    f32vec2 size = f32vec2(daxa_push_constant.output_size);
+    f32vec2 position = uv * size;
+    f32vec2 center = floor(position - 0.5) + 0.5;
+    f32vec2 f = position - center;
+
+    f32vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    f32vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    f32vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    f32vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    f32vec2 w12 = w1 + w2;
+    f32vec2 uv0 = (center - 1.0) / size;
+    f32vec2 uv3 = (center + 2.0) / size;
+    f32vec2 uv12 = (center + w2 / w12) / size;
+
+    f32vec3 result = fetch_history(f32vec2(uv12.x, uv0.y)) * (w12.x * w0.y)
+        + fetch_history(f32vec2(uv0.x, uv12.y)) * (w0.x * w12.y)
+        + fetch_history(uv12) * (w12.x * w12.y)
+        + fetch_history(f32vec2(uv3.x, uv12.y)) * (w3.x * w12.y)
+        + fetch_history(f32vec2(uv12.x, uv3.y)) * (w12.x * w3.y);
+    f32 weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+
+    return max(result / weight, f32vec3(0.0));
+}
+
+// pulls the history toward the box center until it's inside, clamping per channel shifts the hue
+f32vec3 clip_to_aabb(f32vec3 color, f32vec3 aabb_min, f32vec3 aabb_max) {
+    f32vec3 center = 0.5 * (aabb_max + aabb_min);
+    f32vec3 extent = 0.5 * (aabb_max - aabb_min) + 0.0001;
+    f32vec3 offset = color - center;
+    f32vec3 unit = abs(offset / extent);
+    f32 max_unit = max(unit.x, max(unit.y, unit.z));
+    return max_unit > 1.0 ? center + offset / max_unit : color;
+}
+
+void main() {
+    i32vec2 render_max = i32vec2(daxa_push_constant.render_size) - 1;
+    f32vec2 jitter = daxa_push_constant.jitter;
+
+    // this output pixel's center in render pixels. a render texel's sample sits at its center minus the jitter
+    f32vec2 render_position = in_uv * f32vec2(daxa_push_constant.render_size);
+    i32vec2 center_texel = clamp(i32vec2(floor(render_position + jitter)), i32vec2(0), render_max);
+
+    f32vec3 color_sum = f32vec3(0.0);
+    f32 weight_sum = 0.0;
+    f32 max_weight = 0.0;
+    f32vec3 moment_1 = f32vec3(0.0);
+    f32vec3 moment_2 = f32vec3(0.0);
+    f32 closest_depth = 1.0;
+    i32vec2 closest_texel = center_texel;
+
+    for(i32 y = -1; y <= 1; y++) {
+        for(i32 x = -1; x <= 1; x++) {
+            i32vec2 texel = clamp(center_texel + i32vec2(x, y), i32vec2(0), render_max);
+            f32vec3 color = rgb_to_ycocg(texelFetch(daxa_push_constant.color, texel, 0).rgb);
+
+            // gaussian fit of blackman-harris over the distance between the sample and this pixel
+            f32vec2 offset = f32vec2(texel) + 0.5 - jitter - render_position;
+            f32 weight = exp(-2.29 * dot(offset, offset));
+            max_weight = max(max_weight, weight);
+
+            weight *= luma_weight(color);
+            color_sum += color * weight;
+            weight_sum += weight;
+
+            moment_1 += color;
+            moment_2 += color * color;
+
+            f32 depth = texelFetch(daxa_push_constant.depth, texel, 0).r;
+            if(depth < closest_depth) {
+                closest_depth = depth;
+                closest_texel = texel;
+            }
+        }
+    }
+
+    f32vec3 current = color_sum / max(weight_sum, 0.0001);
+
+    f32vec3 mean = moment_1 / 9.0;
+    f32vec3 deviation = sqrt(max(moment_2 / 9.0 - mean * mean, f32vec3(0.0)));
+    f32vec3 aabb_min = mean - 1.25 * deviation;
+    f32vec3 aabb_max = mean + 1.25 * deviation;
+
+    // motion of the closest surface in the neighbourhood, so the edges of moving objects keep their history
+    f32vec2 velocity;
+    if(closest_depth >= 1.0) {
+        // nothing was drawn here, only the camera moved the sky
+        f32vec4 view_position = CAMERA.inverse_projection_matrix * f32vec4(in_uv * 2.0 - 1.0, 1.0, 1.0);
+        f32vec4 world_position = CAMERA.inverse_view_matrix * f32vec4(view_position.xyz / view_position.w, 1.0);
+        f32vec4 previous_clip = CAMERA.previous_view_projection * world_position;
+        velocity = in_uv - (previous_clip.xy / previous_clip.w * 0.5 + 0.5);
+    } else {
+        velocity = texelFetch(daxa_push_constant.velocity, closest_texel, 0).xy;
+    }
+
+    f32vec2 history_uv = in_uv - velocity;
+    f32vec3 result = current;
+    if(daxa_push_constant.history_valid != 0 && all(greaterThanEqual(history_uv, f32vec2(0.0))) && all(lessThanEqual(history_uv, f32vec2(1.0)))) {
+        f32vec3 history = clip_to_aabb(rgb_to_ycocg(sample_history(history_uv)), aabb_min, aabb_max);
+
+        // a pixel no sample landed near gets little new information this frame
+        f32 alpha = max(daxa_push_constant.blend * max_weight, 0.02);
+        f32 history_weight = (1.0 - alpha) * luma_weight(history);
+        f32 current_weight = alpha * luma_weight(current);
+        result = (history * history_weight + current * current_weight) / (history_weight + current_weight);
+    }
+
+    f32vec3 color = max(ycocg_to_rgb(result), f32vec3(0.0));
+    out_history = f32vec4(color, 1.0);
+    out_color = f32vec4(color, 1.0);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#include <shared.inl>
+
+DAXA_USE_PUSH_CONSTANT(DepthPrepassPush)
+
+#if defined(DRAW_VERT)
+
+layout(location = 0) flat out u32 out_draw_index;
+layout(location = 1) out f32vec4 out_current_clip;
+layout(location = 2) out f32vec4 out_previous_clip;
+
+void main() {
+    out_draw_index = DRAW_INDEX;
+    out_current_clip = CAMERA.unjittered_view_projection * TRANSFORM.model_matrix * f32vec4(VERTEX.position, 1.0);
+    out_previous_clip = CAMERA.previous_view_projection * TRANSFORM.previous_model_matrix * f32vec4(VERTEX.position, 1.0);
+    // same transform as the depth prepass so the equal depth test passes exactly
+    gl_Position = CAMERA.projection_matrix * CAMERA.view_matrix * TRANSFORM.model_matrix * f32vec4(VERTEX.position, 1.0);
+}
+
+#elif defined(DRAW_FRAG)
+
+layout(location = 0) flat in u32 in_draw_index;
+layout(location = 1) in f32vec4 in_current_clip;
+layout(location = 2) in f32vec4 in_previous_clip;
+layout(location = 0) out u32vec2 out_visibility;
+layout(location = 1) out f32vec2 out_velocity;
+
+void main() {
+    out_visibility = u32vec2(in_draw_index + 1, gl_PrimitiveID);
+    out_velocity = motion_vector(in_current_clip, in_previous_clip);
+}
+
+#endif
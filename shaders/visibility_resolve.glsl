@@ -0,0 +1,96 @@
+// shared by the passes that shade from the visibility buffer, every texel holds (draw index + 1, triangle index)
+// and zero where nothing was drawn. expects shared.inl and the image overloads to be included already
+
+struct VisibilitySurface {
+    f32vec3 normal;
+    f32vec3 tangent;
+    f32vec2 uv;
+    f32vec2 uv_ddx;
+    f32vec2 uv_ddy;
+    MaterialInfo material;
+};
+
+// perspective correct barycentrics of a pixel and their derivatives one pixel right and down,
+// from the clip space corners of its triangle (Schied and Dachsbacher 2015)
+void compute_barycentrics(f32vec4 c0, f32vec4 c1, f32vec4 c2, f32vec2 ndc, f32vec2 screen_size, out f32vec3 lambda, out f32vec3 lambda_ddx, out f32vec3 lambda_ddy) {
+    f32vec3 inv_w = 1.0 / f32vec3(c0.w, c1.w, c2.w);
+    f32vec2 p0 = c0.xy * inv_w.x;
+    f32vec2 p1 = c1.xy * inv_w.y;
+    f32vec2 p2 = c2.xy * inv_w.z;
+
+    f32 inv_det = 1.0 / determinant(f32mat2x2(p2 - p1, p0 - p1));
+    f32vec3 ddx = f32vec3(p1.y - p2.y, p2.y - p0.y, p0.y - p1.y) * inv_det * inv_w;
+    f32vec3 ddy = f32vec3(p2.x - p1.x, p0.x - p2.x, p1.x - p0.x) * inv_det * inv_w;
+    f32 ddx_sum = dot(ddx, f32vec3(1.0));
+    f32 ddy_sum = dot(ddy, f32vec3(1.0));
+
+    f32vec2 delta = ndc - p0;
+    f32 interp_inv_w = inv_w.x + delta.x * ddx_sum + delta.y * ddy_sum;
+    f32 interp_w = 1.0 / interp_inv_w;
+
+    lambda = interp_w * f32vec3(
+        inv_w.x + delta.x * ddx.x + delta.y * ddy.x,
+        delta.x * ddx.y + delta.y * ddy.y,
+        delta.x * ddx.z + delta.y * ddy.z
+    );
+
+    // a pixel is 2 / size wide in ndc
+    ddx *= 2.0 / screen_size.x;
+    ddy *= 2.0 / screen_size.y;
+    ddx_sum *= 2.0 / screen_size.x;
+    ddy_sum *= 2.0 / screen_size.y;
+
+    lambda_ddx = (lambda * interp_inv_w + ddx) / (interp_inv_w + ddx_sum) - lambda;
+    lambda_ddy = (lambda * interp_inv_w + ddy) / (interp_inv_w + ddy_sum) - lambda;
+}
+
+Vertex fetch_vertex(DrawData draw, u32 corner) {
+    u32 index = deref(draw.index_buffer[corner]).value;
+    return deref(draw.vertex_buffer[u32(i32(index) + draw.vertex_offset)]);
+}
+
+bool resolve_visibility(u32vec2 ids, f32vec2 ndc, f32vec2 screen_size, f32mat4x4 view_projection, daxa_BufferPtr(DrawData) draw_data_buffer, daxa_BufferPtr(MaterialInfo) material_buffer, out VisibilitySurface surface) {
+    if(ids.x == 0) { return false; }
+
+    DrawData draw = deref(draw_data_buffer[ids.x - 1]);
+    TransformInfo transform = deref(draw.transform_buffer);
+
+    u32 first_corner = draw.first_index + ids.y * 3;
+    Vertex v0 = fetch_vertex(draw, first_corner);
+    Vertex v1 = fetch_vertex(draw, first_corner + 1);
+    Vertex v2 = fetch_vertex(draw, first_corner + 2);
+
+    f32mat4x4 mvp = view_projection * transform.model_matrix;
+    f32vec3 lambda, lambda_ddx, lambda_ddy;
+    compute_barycentrics(mvp * f32vec4(v0.position, 1.0), mvp * f32vec4(v1.position, 1.0), mvp * f32vec4(v2.position, 1.0), ndc, screen_size, lambda, lambda_ddx, lambda_ddy);
+
+    f32vec3 normal = v0.normal * lambda.x + v1.normal * lambda.y + v2.normal * lambda.z;
+    f32vec3 tangent = v0.tangent * lambda.x + v1.tangent * lambda.y + v2.tangent * lambda.z;
+    surface.normal = normalize(f32mat3x3(transform.normal_matrix) * normal);
+    surface.tangent = f32mat3x3(transform.model_matrix) * tangent;
+
+    surface.uv = v0.uv * lambda.x + v1.uv * lambda.y + v2.uv * lambda.z;
+    surface.uv_ddx = v0.uv * lambda_ddx.x + v1.uv * lambda_ddx.y + v2.uv * lambda_ddx.z;
+    surface.uv_ddy = v0.uv * lambda_ddy.x + v1.uv * lambda_ddy.y + v2.uv * lambda_ddy.z;
+
+    surface.material = deref(material_buffer[draw.material_index]);
+    return true;
+}
+
+// same material evaluation as the g-buffer pass, with analytic gradients in place of the helper lanes' ones
+f32vec3 surface_albedo(VisibilitySurface surface) {
+    if(surface.material.has_albedo_texture == 1) {
+        return textureGrad(surface.material.albedo_texture, surface.material.sampler, surface.uv, surface.uv_ddx, surface.uv_ddy).rgb;
+    }
+    return f32vec3(1.0);
+}
+
+f32vec3 surface_normal(VisibilitySurface surface) {
+    if(surface.material.has_normal_map_texture == 1 && dot(surface.tangent, surface.tangent) > 0.0) {
+        f32vec3 tangent_normal = textureGrad(surface.material.normal_map_texture, surface.material.sampler, surface.uv, surface.uv_ddx, surface.uv_ddy).xyz * 2.0 - 1.0;
+        f32vec3 T = normalize(surface.tangent - surface.normal * dot(surface.normal, surface.tangent));
+        f32vec3 B = cross(surface.normal, T);
+        return normalize(f32mat3x3(T, B, surface.normal) * tangent_normal);
+    }
+    return surface.normal;
+}
@@ -0,0 +1,50 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(VSMBlurPush)
+
+#define APRON_SIZE (VSM_BLUR_TILE_SIZE + 2 * VSM_BLUR_RADIUS)
+
+// both passes of the separable blur in one dispatch, the horizontal one runs over the apron rows too
+shared f32vec2 raw_moments[APRON_SIZE * APRON_SIZE];
+shared f32vec2 horizontal_moments[APRON_SIZE * VSM_BLUR_TILE_SIZE];
+
+const f32 weights[2 * VSM_BLUR_RADIUS + 1] = { 1.0 / 64.0, 6.0 / 64.0, 15.0 / 64.0, 20.0 / 64.0, 15.0 / 64.0, 6.0 / 64.0, 1.0 / 64.0 };
+
+layout(local_size_x = VSM_BLUR_TILE_SIZE, local_size_y = VSM_BLUR_TILE_SIZE) in;
+void main() {
+    i32vec2 block_origin = i32vec2(gl_WorkGroupID.xy) * VSM_BLUR_TILE_SIZE;
+    i32vec2 tile_offset = i32vec2(daxa_push_constant.tile_offset);
+    i32 tile_max = i32(daxa_push_constant.tile_size) - 1;
+    u32 thread_count = VSM_BLUR_TILE_SIZE * VSM_BLUR_TILE_SIZE;
+
+    // taps are clamped to the light's own tile so neighbours in the atlas never bleed in
+    for(u32 i = gl_LocalInvocationIndex; i < APRON_SIZE * APRON_SIZE; i += thread_count) {
+        i32vec2 texel = clamp(block_origin - VSM_BLUR_RADIUS + i32vec2(i % APRON_SIZE, i / APRON_SIZE), i32vec2(0), i32vec2(tile_max));
+        raw_moments[i] = texelFetch(daxa_push_constant.src, tile_offset + texel, 0).rg;
+    }
+    barrier();
+
+    for(u32 i = gl_LocalInvocationIndex; i < APRON_SIZE * VSM_BLUR_TILE_SIZE; i += thread_count) {
+        u32 row = i / VSM_BLUR_TILE_SIZE;
+        u32 column = i % VSM_BLUR_TILE_SIZE;
+        f32vec2 sum = f32vec2(0.0);
+        for(u32 k = 0; k < 2 * VSM_BLUR_RADIUS + 1; k++) {
+            sum += raw_moments[row * APRON_SIZE + column + k] * weights[k];
+        }
+        horizontal_moments[i] = sum;
+    }
+    barrier();
+
+    u32vec2 local = gl_LocalInvocationID.xy;
+    f32vec2 moments = f32vec2(0.0);
+    for(u32 k = 0; k < 2 * VSM_BLUR_RADIUS + 1; k++) {
+        moments += horizontal_moments[(local.y + k) * VSM_BLUR_TILE_SIZE + local.x] * weights[k];
+    }
+
+    i32vec2 texel = block_origin + i32vec2(local);
+    if(any(greaterThan(texel, i32vec2(tile_max)))) { return; }
+    imageStore(daxa_push_constant.dst, tile_offset + texel, f32vec4(moments, 0.0, 0.0));
+}
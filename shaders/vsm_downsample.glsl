@@ -0,0 +1,21 @@
+#define DAXA_ENABLE_SHADER_NO_NAMESPACE 1
+#define DAXA_ENABLE_IMAGE_OVERLOADS_BASIC 1
+#include <daxa/daxa.inl>
+#include "shared.inl"
+
+DAXA_USE_PUSH_CONSTANT(VSMDownsamplePush)
+
+// moments average linearly, so a box filtered mip is still a valid moment map for filtered lookups
+layout(local_size_x = 8, local_size_y = 8) in;
+void main() {
+    u32vec2 texel = gl_GlobalInvocationID.xy;
+    if(any(greaterThanEqual(texel, u32vec2(daxa_push_constant.tile_size)))) { return; }
+
+    i32vec2 src_texel = i32vec2((daxa_push_constant.tile_offset + texel) * 2);
+    f32vec2 moments = texelFetch(daxa_push_constant.src, src_texel, 0).rg;
+    moments += texelFetch(daxa_push_constant.src, src_texel + i32vec2(1, 0), 0).rg;
+    moments += texelFetch(daxa_push_constant.src, src_texel + i32vec2(0, 1), 0).rg;
+    moments += texelFetch(daxa_push_constant.src, src_texel + i32vec2(1, 1), 0).rg;
+
+    imageStore(daxa_push_constant.dst, i32vec2(daxa_push_constant.tile_offset + texel), f32vec4(moments * 0.25, 0.0, 0.0));
+}